@@ -0,0 +1,75 @@
+#include "alloc_counter.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+// Реализации glibc, которым передаются вызовы после учёта
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+
+static std::atomic<uint64_t> alloc_calls(0);
+static std::atomic<uint64_t> alloc_bytes(0);
+
+static inline void count(size_t size) {
+    alloc_calls.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+AllocStats alloc_stats() {
+    AllocStats stats;
+    stats.calls = alloc_calls.load(std::memory_order_relaxed);
+    stats.bytes = alloc_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+    count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count_, size_t size) {
+    count(count_ * size);
+    return __libc_calloc(count_, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    count(size);
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+}
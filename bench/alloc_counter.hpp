@@ -0,0 +1,16 @@
+#ifndef VIDSTREAM_ALLOC_COUNTER_HPP
+#define VIDSTREAM_ALLOC_COUNTER_HPP
+
+#include <cstdint>
+
+// Счётчик выделений памяти в процессе. alloc_counter.cpp подменяет malloc,
+// calloc, realloc и выравнивающие варианты glibc, поэтому учитываются и
+// выделения OpenCV (fastMalloc), и GLib/GStreamer, а не только operator new.
+struct AllocStats {
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+};
+
+AllocStats alloc_stats();
+
+#endif // VIDSTREAM_ALLOC_COUNTER_HPP
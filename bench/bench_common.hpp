@@ -0,0 +1,55 @@
+#ifndef VIDSTREAM_BENCH_COMMON_HPP
+#define VIDSTREAM_BENCH_COMMON_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "instrumentation.hpp"
+
+// Общие части бенчмарков: часы, процентили и стандартные разрешения;
+// строки JSON пишет write_json_string из instrumentation.hpp
+
+inline uint64_t bench_now_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Процентиль по отсортированной выборке (ближайший ранг)
+inline double percentile_sorted(const std::vector<uint64_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return (double)sorted[std::min(rank, sorted.size() - 1)];
+}
+
+struct Resolution {
+    const char *name;
+    int width;
+    int height;
+};
+
+inline const std::vector<Resolution> &standard_resolutions() {
+    static const std::vector<Resolution> resolutions = {
+        { "480p", 640, 480 },
+        { "720p", 1280, 720 },
+        { "1080p", 1920, 1080 },
+        { "4K", 3840, 2160 },
+    };
+    return resolutions;
+}
+
+// Список имён через запятую; пустой список пропускает всё
+inline bool name_selected(const std::string &list, const std::string &name) {
+    if (list.empty()) {
+        return true;
+    }
+    std::string padded = "," + list + ",";
+    return padded.find("," + name + ",") != std::string::npos;
+}
+
+#endif // VIDSTREAM_BENCH_COMMON_HPP
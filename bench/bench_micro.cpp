@@ -0,0 +1,312 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <gst/gst.h>
+
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "alloc_counter.hpp"
+#include "bench_common.hpp"
+#include "edge_engine.hpp"
+#include "gst_convert.hpp"
+#include "processing.hpp"
+#include "stage_graph.hpp"
+
+using namespace cv;
+
+// Микробенчмарки преобразователей и шагов обработки на стандартных
+// разрешениях. Каждый шаг повторяется не меньше --min-time секунд;
+// результат - среднее, p50, p99 и выделения памяти на одну операцию.
+
+struct MicroResult {
+    std::string name;
+    Resolution resolution;
+    size_t iterations = 0;
+    double mean_us = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+    double allocs_per_op = 0;
+    double bytes_per_op = 0;
+};
+
+// Синтетический кадр с фигурами и шумом: контуров достаточно,
+// чтобы findContours и drawContours делали реальную работу
+static Mat make_test_frame(int width, int height) {
+    Mat frame(height, width, CV_8UC3, Scalar(90, 100, 110));
+    RNG rng(12345);
+
+    int shapes = std::max(8, width * height / 40000);
+    for (int i = 0; i < shapes; ++i) {
+        Point center(rng.uniform(0, width), rng.uniform(0, height));
+        Scalar color(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+        int size = rng.uniform(height / 40 + 2, height / 8 + 4);
+        if (i % 2) {
+            circle(frame, center, size, color, -1);
+        } else {
+            rectangle(frame, Rect(center.x, center.y, size * 2, size), color, -1);
+        }
+    }
+
+    Mat noise(height, width, CV_8UC3);
+    rng.fill(noise, RNG::NORMAL, Scalar::all(0), Scalar::all(4));
+    add(frame, noise, frame);
+    return frame;
+}
+
+static GstCaps *make_caps(const char *format, int width, int height) {
+    return gst_caps_new_simple("video/x-raw",
+                               "format", G_TYPE_STRING, format,
+                               "width", G_TYPE_INT, width,
+                               "height", G_TYPE_INT, height,
+                               "framerate", GST_TYPE_FRACTION, 30, 1,
+                               NULL);
+}
+
+static MicroResult run_case(const std::string &name, const Resolution &resolution, double min_time,
+                            const std::function<void()> &op) {
+    // Прогрев: пулы кадров и буферы потоков заполняются до замера
+    for (int i = 0; i < 3; ++i) {
+        op();
+    }
+
+    std::vector<uint64_t> samples;
+    uint64_t budget_ns = (uint64_t)(min_time * 1e9);
+    uint64_t begin = bench_now_ns();
+    AllocStats alloc_before = alloc_stats();
+
+    while (samples.size() < 10 || bench_now_ns() - begin < budget_ns) {
+        uint64_t start = bench_now_ns();
+        op();
+        samples.push_back(bench_now_ns() - start);
+    }
+
+    AllocStats alloc_after = alloc_stats();
+
+    MicroResult result;
+    result.name = name;
+    result.resolution = resolution;
+    result.iterations = samples.size();
+
+    uint64_t total = 0;
+    for (uint64_t sample : samples) {
+        total += sample;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    result.mean_us = total / 1e3 / samples.size();
+    result.p50_us = percentile_sorted(samples, 50) / 1e3;
+    result.p99_us = percentile_sorted(samples, 99) / 1e3;
+    result.allocs_per_op = (double)(alloc_after.calls - alloc_before.calls) / samples.size();
+    result.bytes_per_op = (double)(alloc_after.bytes - alloc_before.bytes) / samples.size();
+    return result;
+}
+
+static void run_resolution(const Resolution &resolution, double min_time, const std::string &cases,
+                           std::vector<MicroResult> &results) {
+    const int width = resolution.width;
+    const int height = resolution.height;
+
+    Mat frame = make_test_frame(width, height);
+
+    GstCaps *bgr_caps = make_caps("BGR", width, height);
+    GstCaps *rgb_caps = make_caps("RGB", width, height);
+    GstSample *bgr_sample = mat_to_gst_sample(frame, bgr_caps);
+    GstSample *rgb_sample = mat_to_gst_sample(frame, rgb_caps);
+
+    Mat blurred;
+    Mat edges;
+    detect_edges(frame, blurred, edges);
+
+    Mat scratch = frame.clone();
+
+    Mat i420;
+    cvtColor(frame, i420, COLOR_BGR2YUV_I420);
+    Mat i420_scratch = i420.clone();
+
+    std::vector<std::pair<std::string, std::function<void()>>> ops;
+
+    ops.push_back(std::make_pair(std::string("gst_sample_to_mat_bgr"), std::function<void()>([&]() {
+        Mat mat = gst_sample_to_mat(bgr_sample);
+    })));
+    ops.push_back(std::make_pair(std::string("gst_sample_to_mat_rgb"), std::function<void()>([&]() {
+        Mat mat = gst_sample_to_mat(rgb_sample);
+    })));
+    ops.push_back(std::make_pair(std::string("mat_to_gst_sample"), std::function<void()>([&]() {
+        GstSample *sample = mat_to_gst_sample(frame, bgr_caps);
+        gst_sample_unref(sample);
+    })));
+    ops.push_back(std::make_pair(std::string("detect_edges"), std::function<void()>([&]() {
+        detect_edges(frame, blurred, edges);
+    })));
+    ops.push_back(std::make_pair(std::string("findContours"), std::function<void()>([&]() {
+        std::vector<std::vector<Point>> contours;
+        findContours(edges, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+    })));
+    FlatContours flat_contours;
+    Mat contour_labels;
+    ops.push_back(std::make_pair(std::string("find_external_contours"), std::function<void()>([&]() {
+        find_external_contours(edges, contour_labels, flat_contours);
+    })));
+    ops.push_back(std::make_pair(std::string("process_frame"), std::function<void()>([&]() {
+        Mat processed = process_frame(frame);
+    })));
+    ContourOverlay overlay;
+    process_frame(frame, &overlay);
+    ops.push_back(std::make_pair(std::string("redraw_frame"), std::function<void()>([&]() {
+        Mat processed = redraw_frame(frame, overlay);
+    })));
+    ops.push_back(std::make_pair(std::string("process_frame_in_place"), std::function<void()>([&]() {
+        frame.copyTo(scratch);
+        process_frame_in_place(scratch);
+    })));
+    Mat downsampled;
+    ops.push_back(std::make_pair(std::string("downsample_luma"), std::function<void()>([&]() {
+        downsample_luma(frame, downsampled, 1);
+    })));
+    ops.push_back(std::make_pair(std::string("process_frame_in_place_level1"), std::function<void()>([&]() {
+        frame.copyTo(scratch);
+        process_frame_in_place(scratch, nullptr, 1);
+    })));
+    ops.push_back(std::make_pair(std::string("process_frame_in_place_level2"), std::function<void()>([&]() {
+        frame.copyTo(scratch);
+        process_frame_in_place(scratch, nullptr, 2);
+    })));
+    // Неподвижная сцена и сцена с движущимся квадратом в 1/16 кадра
+    IncrementalState static_state;
+    IncrementalState moving_state;
+    Mat moved = frame.clone();
+    rectangle(moved, Rect(width / 4, height / 4, width / 4, height / 4), Scalar(255, 255, 255), FILLED);
+    uint64_t moving_index = 0;
+    ops.push_back(std::make_pair(std::string("process_frame_incremental_static"), std::function<void()>([&]() {
+        frame.copyTo(scratch);
+        process_frame_incremental(scratch, static_state);
+    })));
+    ops.push_back(std::make_pair(std::string("process_frame_incremental_partial"), std::function<void()>([&]() {
+        (moving_index++ % 2 ? moved : frame).copyTo(scratch);
+        process_frame_incremental(scratch, moving_state);
+    })));
+    ops.push_back(std::make_pair(std::string("process_yuv_frame_in_place"), std::function<void()>([&]() {
+        i420.copyTo(i420_scratch);
+        YuvFrame yuv;
+        yuv.y = i420_scratch.rowRange(0, height);
+        Mat chroma = i420_scratch.rowRange(height, height + height / 2);
+        yuv.u = Mat(height / 2, width / 2, CV_8UC1, chroma.data);
+        yuv.v = Mat(height / 2, width / 2, CV_8UC1, chroma.data + (size_t)(height / 2) * (width / 2));
+        process_yuv_frame_in_place(yuv);
+    })));
+    // Слитые ядра графа стадий и графы без размытия
+    Mat binary;
+    ops.push_back(std::make_pair(std::string("detect_edges_sharp"), std::function<void()>([&]() {
+        detect_edges_sharp(frame, edges);
+    })));
+    ops.push_back(std::make_pair(std::string("threshold_luma"), std::function<void()>([&]() {
+        threshold_luma(frame, binary, 128);
+    })));
+    StageGraph sharp_graph;
+    StageGraph threshold_graph;
+    std::string graph_error;
+    sharp_graph.compile("edges,contours,draw,stamp", graph_error);
+    threshold_graph.compile("threshold:128,contours,draw", graph_error);
+    ops.push_back(std::make_pair(std::string("stage_graph_sharp"), std::function<void()>([&]() {
+        frame.copyTo(scratch);
+        sharp_graph.run(scratch, nullptr);
+    })));
+    ops.push_back(std::make_pair(std::string("stage_graph_threshold"), std::function<void()>([&]() {
+        frame.copyTo(scratch);
+        threshold_graph.run(scratch, nullptr);
+    })));
+
+    for (size_t i = 0; i < ops.size(); ++i) {
+        if (!name_selected(cases, ops[i].first)) {
+            continue;
+        }
+
+        MicroResult result = run_case(ops[i].first, resolution, min_time, ops[i].second);
+        results.push_back(result);
+
+        std::cout << std::left << std::setw(28) << result.name << std::setw(7) << resolution.name
+                  << std::right << std::fixed << std::setprecision(1)
+                  << " mean " << std::setw(9) << result.mean_us << " us"
+                  << "  p50 " << std::setw(9) << result.p50_us << " us"
+                  << "  p99 " << std::setw(9) << result.p99_us << " us"
+                  << "  alloc/op " << std::setw(6) << result.allocs_per_op
+                  << " (" << result.bytes_per_op << " B)" << std::endl;
+    }
+
+    gst_sample_unref(bgr_sample);
+    gst_sample_unref(rgb_sample);
+    gst_caps_unref(bgr_caps);
+    gst_caps_unref(rgb_caps);
+}
+
+static void write_json(const std::string &path, const std::vector<MicroResult> &results) {
+    std::ofstream out(path.c_str(), std::ios::trunc);
+    out << std::fixed << std::setprecision(3);
+    out << "{\"benchmark\":\"micro\",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const MicroResult &r = results[i];
+        out << (i ? "," : "") << "\n{\"name\":";
+        write_json_string(out, r.name);
+        out << ",\"resolution\":";
+        write_json_string(out, r.resolution.name);
+        out << ",\"width\":" << r.resolution.width
+            << ",\"height\":" << r.resolution.height
+            << ",\"iterations\":" << r.iterations
+            << ",\"mean_us\":" << r.mean_us
+            << ",\"p50_us\":" << r.p50_us
+            << ",\"p99_us\":" << r.p99_us
+            << ",\"allocs_per_op\":" << r.allocs_per_op
+            << ",\"bytes_per_op\":" << r.bytes_per_op << "}";
+    }
+    out << "\n]}\n";
+}
+
+int main(int argc, char *argv[]) {
+    gchar *json_path = NULL;
+    gchar *resolutions_arg = NULL;
+    gchar *cases_arg = NULL;
+    gdouble min_time = 0.5;
+
+    GOptionEntry entries[] = {
+        { "json", 'j', 0, G_OPTION_ARG_FILENAME, &json_path, "Записать результаты в JSON", "FILE" },
+        { "resolutions", 'r', 0, G_OPTION_ARG_STRING, &resolutions_arg, "Разрешения через запятую: 480p,720p,1080p,4K", "LIST" },
+        { "cases", 'c', 0, G_OPTION_ARG_STRING, &cases_arg, "Шаги через запятую (по умолчанию все)", "LIST" },
+        { "min-time", 't', 0, G_OPTION_ARG_DOUBLE, &min_time, "Минимальное время замера одного шага, с", "SEC" },
+        { NULL }
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- микробенчмарки преобразователей и обработки");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        std::cerr << "Ошибка разбора аргументов: " << error->message << std::endl;
+        g_error_free(error);
+        g_option_context_free(context);
+        return -1;
+    }
+    g_option_context_free(context);
+
+    std::string resolutions = resolutions_arg ? resolutions_arg : "";
+    std::string cases = cases_arg ? cases_arg : "";
+    g_free(resolutions_arg);
+    g_free(cases_arg);
+
+    std::vector<MicroResult> results;
+    for (const Resolution &resolution : standard_resolutions()) {
+        if (name_selected(resolutions, resolution.name)) {
+            run_resolution(resolution, min_time, cases, results);
+        }
+    }
+
+    if (json_path) {
+        write_json(json_path, results);
+        std::cout << "Результаты записаны в " << json_path << std::endl;
+        g_free(json_path);
+    }
+
+    return 0;
+}
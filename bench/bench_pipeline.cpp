@@ -0,0 +1,365 @@
+#include <opencv2/core.hpp>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "alloc_counter.hpp"
+#include "bench_common.hpp"
+#include "cv_filter.hpp"
+#include "frame_executor.hpp"
+#include "pipeline_util.hpp"
+
+// Макробенчмарк полного конвейера: videotestsrc или файл -> обработка ->
+// x264enc -> rtph264pay -> fakesink или UDP на локальный приёмник.
+// Источник не живой, поэтому конвейер работает с максимальной скоростью;
+// задержка кадра - от выхода источника до первого RTP-пакета кадра на
+// приёмнике и включает ожидание в очередях.
+
+// Задержка кадра по пад-пробам: кадр опознаётся по PTS + base time
+// конвейера, что совпадает для обоих режимов (в --bridge PTS пересчитывается)
+class FrameLatency {
+public:
+    void attach(GstElement *element, const char *pad_name, bool is_end) {
+        GstPad *pad = gst_element_get_static_pad(element, pad_name);
+        gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                          is_end ? on_end : on_begin, this, NULL);
+        gst_object_unref(pad);
+    }
+
+    std::vector<uint64_t> samples() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return samples_;
+    }
+
+private:
+    static GstBuffer *probe_buffer(GstPadProbeInfo *info) {
+        if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+            return GST_PAD_PROBE_INFO_BUFFER(info);
+        }
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        return gst_buffer_list_length(list) > 0 ? gst_buffer_list_get(list, 0) : NULL;
+    }
+
+    static GstClockTime frame_key(GstPad *pad, GstBuffer *buffer) {
+        GstElement *element = GST_ELEMENT(GST_PAD_PARENT(pad));
+        if (!buffer || !element || !GST_BUFFER_PTS_IS_VALID(buffer)) {
+            return GST_CLOCK_TIME_NONE;
+        }
+        return GST_BUFFER_PTS(buffer) + gst_element_get_base_time(element);
+    }
+
+    static GstPadProbeReturn on_begin(GstPad *pad, GstPadProbeInfo *info, gpointer data) {
+        FrameLatency *self = static_cast<FrameLatency *>(data);
+        GstClockTime key = frame_key(pad, probe_buffer(info));
+        if (GST_CLOCK_TIME_IS_VALID(key)) {
+            std::lock_guard<std::mutex> lock(self->mutex_);
+            self->pending_[key] = bench_now_ns();
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    static GstPadProbeReturn on_end(GstPad *pad, GstPadProbeInfo *info, gpointer data) {
+        FrameLatency *self = static_cast<FrameLatency *>(data);
+        GstClockTime key = frame_key(pad, probe_buffer(info));
+        if (GST_CLOCK_TIME_IS_VALID(key)) {
+            std::lock_guard<std::mutex> lock(self->mutex_);
+            std::map<GstClockTime, uint64_t>::iterator it = self->pending_.find(key);
+            if (it != self->pending_.end()) {
+                self->samples_.push_back(bench_now_ns() - it->second);
+                self->pending_.erase(it);
+            }
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    std::mutex mutex_;
+    std::map<GstClockTime, uint64_t> pending_;
+    std::vector<uint64_t> samples_;
+};
+
+struct PipelineOptions {
+    std::string mode = "filter";
+    std::string input;
+    std::string format = "BGR";
+    std::string sink = "fake";
+    int width = 1280;
+    int height = 720;
+    int frames = 600;
+    int port = 5600;
+    int workers = 0;
+};
+
+static std::string source_description(const PipelineOptions &options) {
+    std::ostringstream out;
+    if (options.input.empty()) {
+        out << "videotestsrc num-buffers=" << options.frames << " pattern=ball";
+    } else {
+        gchar *location = g_strescape(options.input.c_str(), NULL);
+        out << "filesrc location=\"" << location << "\" ! decodebin ! videoconvert ! videoscale";
+        g_free(location);
+    }
+    out << " ! video/x-raw,format=" << options.format << ",width=" << options.width << ",height=" << options.height;
+    return out.str();
+}
+
+static std::string encoder_description(const PipelineOptions &options) {
+    std::ostringstream out;
+    if (options.format == "BGR") {
+        out << "videoconvert ! ";
+    }
+    out << "x264enc tune=zerolatency speed-preset=ultrafast bitrate=2000 ! rtph264pay ! ";
+    if (options.sink == "udp") {
+        out << "udpsink name=sink host=127.0.0.1 port=" << options.port << " sync=false async=false";
+    } else {
+        out << "fakesink name=sink sync=false async=false";
+    }
+    return out.str();
+}
+
+static GstElement *launch(const std::string &description) {
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description.c_str(), &error);
+    if (error) {
+        std::cerr << "Ошибка конвейера: " << error->message << std::endl;
+        g_error_free(error);
+        if (pipeline) {
+            gst_object_unref(pipeline);
+        }
+        return NULL;
+    }
+    return pipeline;
+}
+
+static GstElement *child(GstElement *pipeline, const char *name) {
+    GstElement *element = gst_bin_get_by_name(GST_BIN(pipeline), name);
+    // Конвейер держит свою ссылку, возвращаем заимствованную
+    gst_object_unref(element);
+    return element;
+}
+
+// Единый конвейер с элементом cvfilter
+static bool run_filter(const PipelineOptions &options, FrameLatency &latency) {
+    std::string description = source_description(options) +
+                              " ! identity name=ingress ! queue ! cvfilter ! queue ! " + encoder_description(options);
+    GstElement *pipeline = launch(description);
+    if (!pipeline) {
+        return false;
+    }
+
+    latency.attach(child(pipeline, "ingress"), "src", false);
+    latency.attach(child(pipeline, "sink"), "sink", true);
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    bool ok = wait_for_eos(pipeline, "bench_pipeline");
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return ok;
+}
+
+// Два конвейера через appsink/appsrc и FrameExecutor
+static bool run_bridge(const PipelineOptions &options, FrameLatency &latency) {
+    GstElement *src_pipeline = launch(source_description(options) +
+                                      " ! appsink name=appsink max-buffers=2 drop=false sync=false");
+    GstElement *dst_pipeline = launch("appsrc name=appsrc format=time block=true caps=\"video/x-raw,format=BGR,width=" +
+                                      std::to_string(options.width) + ",height=" + std::to_string(options.height) +
+                                      ",framerate=30/1\" ! " + encoder_description(options));
+    if (!src_pipeline || !dst_pipeline) {
+        return false;
+    }
+
+    GstElement *appsink = child(src_pipeline, "appsink");
+    GstElement *appsrc = child(dst_pipeline, "appsrc");
+
+    // Общие часы: executor пересчитывает PTS между конвейерами
+    GstClock *clock = gst_system_clock_obtain();
+    gst_pipeline_use_clock(GST_PIPELINE(src_pipeline), clock);
+    gst_pipeline_use_clock(GST_PIPELINE(dst_pipeline), clock);
+    gst_object_unref(clock);
+
+    latency.attach(appsink, "sink", false);
+    latency.attach(child(dst_pipeline, "sink"), "sink", true);
+
+    ExecutorConfig config;
+    config.workers = options.workers;
+    config.drop_policy = DropPolicy::Block;
+
+    gst_element_set_state(dst_pipeline, GST_STATE_PLAYING);
+    gst_element_set_state(src_pipeline, GST_STATE_PLAYING);
+
+    bool ok;
+    {
+        FrameExecutor executor(appsink, appsrc, config);
+        executor.start();
+
+        ok = wait_for_eos(src_pipeline, "bench_pipeline");
+
+        // Ждём, пока все захваченные кадры пройдут до appsrc
+        for (;;) {
+            ExecutorStats stats = executor.stats();
+            if (gst_app_sink_is_eos(GST_APP_SINK(appsink)) &&
+                stats.pushed + stats.dropped_oldest + stats.dropped_newest + stats.failed >= stats.captured) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        executor.stop();
+    }
+
+    gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
+    ok = wait_for_eos(dst_pipeline, "bench_pipeline") && ok;
+
+    gst_element_set_state(src_pipeline, GST_STATE_NULL);
+    gst_element_set_state(dst_pipeline, GST_STATE_NULL);
+    gst_object_unref(src_pipeline);
+    gst_object_unref(dst_pipeline);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    PipelineOptions options;
+    gchar *mode_arg = NULL;
+    gchar *input_arg = NULL;
+    gchar *format_arg = NULL;
+    gchar *sink_arg = NULL;
+    gchar *resolution_arg = NULL;
+    gchar *json_path = NULL;
+
+    GOptionEntry entries[] = {
+        { "mode", 'm', 0, G_OPTION_ARG_STRING, &mode_arg, "filter - единый конвейер с cvfilter, bridge - appsink/appsrc", "MODE" },
+        { "input", 'i', 0, G_OPTION_ARG_FILENAME, &input_arg, "Видеофайл вместо videotestsrc", "FILE" },
+        { "format", 'f', 0, G_OPTION_ARG_STRING, &format_arg, "Формат обработки: BGR, I420, NV12", "FORMAT" },
+        { "resolution", 'r', 0, G_OPTION_ARG_STRING, &resolution_arg, "480p, 720p, 1080p или 4K", "NAME" },
+        { "frames", 'n', 0, G_OPTION_ARG_INT, &options.frames, "Число кадров videotestsrc", "N" },
+        { "sink", 's', 0, G_OPTION_ARG_STRING, &sink_arg, "fake - fakesink, udp - отправка на локальный приёмник", "SINK" },
+        { "port", 'p', 0, G_OPTION_ARG_INT, &options.port, "UDP-порт локального приёмника", "PORT" },
+        { "workers", 'w', 0, G_OPTION_ARG_INT, &options.workers, "Потоки обработки в режиме bridge", "N" },
+        { "json", 'j', 0, G_OPTION_ARG_FILENAME, &json_path, "Записать результат в JSON", "FILE" },
+        { NULL }
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- макробенчмарк полного конвейера");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        std::cerr << "Ошибка разбора аргументов: " << error->message << std::endl;
+        g_error_free(error);
+        g_option_context_free(context);
+        return -1;
+    }
+    g_option_context_free(context);
+
+    if (mode_arg) options.mode = mode_arg;
+    if (input_arg) options.input = input_arg;
+    if (format_arg) options.format = format_arg;
+    if (sink_arg) options.sink = sink_arg;
+    if (resolution_arg) {
+        bool found = false;
+        for (const Resolution &resolution : standard_resolutions()) {
+            if (resolution.name == std::string(resolution_arg)) {
+                options.width = resolution.width;
+                options.height = resolution.height;
+                found = true;
+            }
+        }
+        if (!found) {
+            std::cerr << "Неизвестное разрешение: " << resolution_arg << std::endl;
+            return -1;
+        }
+    }
+    g_free(mode_arg);
+    g_free(input_arg);
+    g_free(format_arg);
+    g_free(sink_arg);
+    g_free(resolution_arg);
+
+    if (options.mode != "filter" && options.mode != "bridge") {
+        std::cerr << "Неизвестный режим: " << options.mode << std::endl;
+        return -1;
+    }
+    if (options.mode == "bridge" && options.format != "BGR") {
+        std::cerr << "Режим bridge поддерживает только формат BGR" << std::endl;
+        return -1;
+    }
+    if (!cv_filter_register()) {
+        std::cerr << "Не удалось зарегистрировать элемент cvfilter!" << std::endl;
+        return -1;
+    }
+
+    // Локальный приёмник, чтобы udpsink отправлял в открытый порт
+    GstElement *receiver = NULL;
+    if (options.sink == "udp") {
+        receiver = launch("udpsrc port=" + std::to_string(options.port) + " ! fakesink sync=false");
+        if (!receiver) {
+            return -1;
+        }
+        gst_element_set_state(receiver, GST_STATE_PLAYING);
+    }
+
+    FrameLatency latency;
+    AllocStats alloc_before = alloc_stats();
+    uint64_t begin = bench_now_ns();
+
+    bool ok = options.mode == "bridge" ? run_bridge(options, latency) : run_filter(options, latency);
+
+    uint64_t elapsed = bench_now_ns() - begin;
+    AllocStats alloc_after = alloc_stats();
+
+    if (receiver) {
+        gst_element_set_state(receiver, GST_STATE_NULL);
+        gst_object_unref(receiver);
+    }
+
+    std::vector<uint64_t> samples = latency.samples();
+    std::sort(samples.begin(), samples.end());
+
+    size_t frames = samples.size();
+    double seconds = elapsed / 1e9;
+    double fps = seconds > 0 ? frames / seconds : 0;
+    double divisor = frames > 0 ? (double)frames : 1.0;
+    double allocs_per_frame = (alloc_after.calls - alloc_before.calls) / divisor;
+    double bytes_per_frame = (alloc_after.bytes - alloc_before.bytes) / divisor;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << options.mode << " " << options.format << " " << options.width << "x" << options.height
+              << ": кадров " << frames << " за " << seconds << " с, " << fps << " fps" << std::endl
+              << "  задержка p50 " << percentile_sorted(samples, 50) / 1e3
+              << " us, p90 " << percentile_sorted(samples, 90) / 1e3
+              << " us, p99 " << percentile_sorted(samples, 99) / 1e3
+              << " us, max " << (samples.empty() ? 0 : samples.back()) / 1e3 << " us" << std::endl
+              << "  выделений на кадр " << allocs_per_frame << " (" << bytes_per_frame << " байт)" << std::endl;
+
+    if (json_path) {
+        std::ofstream out(json_path, std::ios::trunc);
+        out << std::fixed << std::setprecision(3);
+        out << "{\"benchmark\":\"pipeline\",\"mode\":";
+        write_json_string(out, options.mode);
+        out << ",\"format\":";
+        write_json_string(out, options.format);
+        out << ",\"sink\":";
+        write_json_string(out, options.sink);
+        out << ",\"width\":" << options.width
+            << ",\"height\":" << options.height
+            << ",\"frames\":" << frames
+            << ",\"seconds\":" << seconds
+            << ",\"fps\":" << fps
+            << ",\"latency_us\":{\"p50\":" << percentile_sorted(samples, 50) / 1e3
+            << ",\"p90\":" << percentile_sorted(samples, 90) / 1e3
+            << ",\"p99\":" << percentile_sorted(samples, 99) / 1e3
+            << ",\"max\":" << (samples.empty() ? 0 : samples.back()) / 1e3 << "}"
+            << ",\"allocs_per_frame\":" << allocs_per_frame
+            << ",\"bytes_per_frame\":" << bytes_per_frame
+            << ",\"ok\":" << (ok ? "true" : "false") << "}\n";
+        g_free(json_path);
+    }
+
+    return ok ? 0 : 1;
+}
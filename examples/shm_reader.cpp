@@ -0,0 +1,123 @@
+// Пример читателя кольца кадров, которое публикует stream --shm.
+//
+//   shm_reader [ПОТОК] [--all] [--show]
+//
+// Подключается к /vidstream.<ПОТОК> (по умолчанию camera0), раз в секунду
+// печатает число кадров, потерянных кадров и среднюю яркость последнего
+// кадра. Яркость считается прямо по памяти кольца, без копии кадра; после
+// расчёта читатель проверяет, что слот не перезаписали. По умолчанию берётся
+// самый новый кадр, с --all - каждый по порядку, как нужно записи.
+// После перезапуска stream читатель подключается заново.
+
+#include <opencv2/core.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "shm_ring.hpp"
+
+// Заголовок Mat поверх плана кадра в разделяемой памяти, без копирования
+static cv::Mat plane(const ShmFrame &frame, int index, int rows, int cols, int type) {
+    return cv::Mat(rows, cols, type, const_cast<uint8_t *>(frame.data + frame.info.offsets[index]),
+                   frame.info.strides[index]);
+}
+
+// План яркости или BGR-кадр для расчёта; пустой Mat - формат не поддерживается
+static cv::Mat luma_or_bgr(const ShmFrame &frame) {
+    const ShmFrameInfo &info = frame.info;
+    const int rows = (int)info.height, cols = (int)info.width;
+    if (!std::strcmp(info.format, "BGR")) {
+        return plane(frame, 0, rows, cols, CV_8UC3);
+    }
+    if (!std::strcmp(info.format, "BGRx") || !std::strcmp(info.format, "BGRA")) {
+        return plane(frame, 0, rows, cols, CV_8UC4);
+    }
+    if (!std::strcmp(info.format, "GRAY8") || !std::strcmp(info.format, "I420") ||
+        !std::strcmp(info.format, "NV12")) {
+        return plane(frame, 0, rows, cols, CV_8UC1);
+    }
+    return cv::Mat();
+}
+
+// Копия кадра в BGR для окна; для I420/NV12 показывается план яркости
+static void show(const cv::Mat &image) {
+    cv::Mat bgr;
+    if (image.channels() == 4) {
+        cv::cvtColor(image, bgr, cv::COLOR_BGRA2BGR);
+    } else {
+        image.copyTo(bgr);
+    }
+    cv::imshow("shm_reader", bgr);
+    cv::waitKey(1);
+}
+
+int main(int argc, char *argv[]) {
+    std::string stream = "camera0";
+    bool all = false;
+    bool show_window = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--all") {
+            all = true;
+        } else if (arg == "--show") {
+            show_window = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            stream = arg;
+        } else {
+            std::cerr << "Использование: shm_reader [ПОТОК] [--all] [--show]" << std::endl;
+            return 1;
+        }
+    }
+
+    const std::string name = shm_ring_name(stream);
+    ShmRingReader reader;
+    uint64_t frames = 0, torn = 0;
+    double brightness = 0;
+    std::chrono::steady_clock::time_point report = std::chrono::steady_clock::now();
+
+    for (;;) {
+        if (reader.writer_closed()) {
+            std::string error;
+            if (!reader.open(name, error)) {
+                std::cerr << error << ", ждём..." << std::endl;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
+            std::cout << "Подключено к " << name << std::endl;
+        }
+
+        ShmFrame frame;
+        if (!(all ? reader.next(frame) : reader.latest(frame))) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        } else {
+            cv::Mat image = luma_or_bgr(frame);
+            if (image.empty()) {
+                std::cerr << "Формат " << frame.info.format << " не поддерживается" << std::endl;
+                return 1;
+            }
+            cv::Scalar mean = cv::mean(image);
+            if (show_window) {
+                show(image);
+            }
+            // Слот перезаписан во время расчёта - результат не годится
+            if (reader.valid(frame)) {
+                brightness = image.channels() == 1 ? mean[0] : (mean[0] + mean[1] + mean[2]) / 3;
+                ++frames;
+            } else {
+                ++torn;
+            }
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - report >= std::chrono::seconds(1)) {
+            std::cout << name << ": кадров " << frames << ", потеряно " << reader.lost()
+                      << ", перезаписано при чтении " << torn << ", яркость " << brightness << std::endl;
+            report = now;
+        }
+    }
+}
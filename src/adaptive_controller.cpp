@@ -0,0 +1,227 @@
+#include "adaptive_controller.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+struct LevelActions {
+    double bitrate_scale;
+    int process_every;  // обрабатывается каждый N-й кадр
+    int encode_every;   // кодируется каждый N-й кадр; 1 или кратно process_every
+};
+
+const LevelActions kLevels[] = {
+    { 1.0, 1, 1 },
+    { 0.7, 1, 1 },
+    { 0.5, 2, 1 },
+    { 0.5, 2, 2 },
+    { 0.3, 3, 3 },
+};
+
+const int kMaxLevel = (int)(sizeof(kLevels) / sizeof(kLevels[0])) - 1;
+
+} // namespace
+
+AdaptiveController::AdaptiveController(const std::string &name, const AdaptiveConfig &config)
+    : name_(name),
+      config_(config),
+      encoder_(nullptr),
+      level_(0),
+      bitrate_(config.bitrate),
+      calm_intervals_(0),
+      settling_(false),
+      frames_seen_(0),
+      process_ns_(0),
+      encoder_in_(0),
+      encoder_out_(0),
+      frame_counter_(0),
+      transitions_(0),
+      skipped_(0),
+      dropped_(0),
+      running_(false) {}
+
+AdaptiveController::~AdaptiveController() {
+    stop();
+    if (encoder_) {
+        gst_object_unref(encoder_);
+    }
+}
+
+void AdaptiveController::set_fill_reader(FillReader reader) {
+    fill_reader_ = reader;
+}
+
+void AdaptiveController::attach_encoder(GstElement *encoder) {
+    encoder_ = (GstElement *)gst_object_ref(encoder);
+
+    GstPad *sink = gst_element_get_static_pad(encoder, "sink");
+    GstPad *src = gst_element_get_static_pad(encoder, "src");
+    if (sink) {
+        gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_BUFFER, count_probe, &encoder_in_, NULL);
+        gst_object_unref(sink);
+    }
+    if (src) {
+        gst_pad_add_probe(src, GST_PAD_PROBE_TYPE_BUFFER, count_probe, &encoder_out_, NULL);
+        gst_object_unref(src);
+    }
+}
+
+void AdaptiveController::attach_drop_point(GstElement *element, const char *pad_name) {
+    GstPad *pad = gst_element_get_static_pad(element, pad_name);
+    if (!pad) {
+        std::cerr << "AdaptiveController: у элемента нет пада " << pad_name << std::endl;
+        return;
+    }
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, drop_probe, this, NULL);
+    gst_object_unref(pad);
+}
+
+GstPadProbeReturn AdaptiveController::count_probe(GstPad *, GstPadProbeInfo *, gpointer user_data) {
+    static_cast<std::atomic<uint64_t> *>(user_data)->fetch_add(1, std::memory_order_relaxed);
+    return GST_PAD_PROBE_OK;
+}
+
+// Решение принято при обработке кадра; здесь только его исполнение
+GstPadProbeReturn AdaptiveController::drop_probe(GstPad *, GstPadProbeInfo *info, gpointer user_data) {
+    AdaptiveController *self = static_cast<AdaptiveController *>(user_data);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (buffer && GST_BUFFER_FLAG_IS_SET(buffer, kAdaptiveSkipEncode)) {
+        self->dropped_.fetch_add(1, std::memory_order_relaxed);
+        return GST_PAD_PROBE_DROP;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+FrameDecision AdaptiveController::next_frame() {
+    frames_seen_.fetch_add(1, std::memory_order_relaxed);
+
+    // Действия уровня читаются одной загрузкой, чтобы решение не смешивало
+    // два уровня при переходе
+    const LevelActions &actions = kLevels[level_.load(std::memory_order_relaxed)];
+    uint64_t index = frame_counter_.fetch_add(1, std::memory_order_relaxed);
+
+    // Кодируемые кадры выбираются из обрабатываемых: encode_every кратно
+    // process_every, поэтому кадр, прошедший второе условие, прошёл и первое
+    FrameDecision decision;
+    decision.process = index % actions.process_every == 0;
+    decision.encode = index % actions.encode_every == 0;
+    if (!decision.process) {
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return decision;
+}
+
+void AdaptiveController::record_processing(uint64_t ns) {
+    process_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+void AdaptiveController::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    apply(0);
+    thread_ = std::thread(&AdaptiveController::control_loop, this);
+}
+
+void AdaptiveController::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+void AdaptiveController::control_loop() {
+    auto period = std::chrono::duration<double>(config_.interval);
+    auto last = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        wake_.wait_for(lock, period);
+        if (!running_) {
+            break;
+        }
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        lock.unlock();
+        update(seconds);
+        lock.lock();
+    }
+}
+
+void AdaptiveController::update(double seconds) {
+    uint64_t frames = frames_seen_.exchange(0, std::memory_order_relaxed);
+    uint64_t process_ns = process_ns_.exchange(0, std::memory_order_relaxed);
+    uint64_t encoder_in = encoder_in_.exchange(0, std::memory_order_relaxed);
+    uint64_t encoder_out = encoder_out_.exchange(0, std::memory_order_relaxed);
+
+    double fill = fill_reader_ ? fill_reader_() : 0;
+    // Время обработки делится на все входные кадры, включая пропущенные:
+    // так видно, помогает ли прореживание
+    double process_ms = frames > 0 ? process_ns / 1e6 / frames : 0;
+    double in_fps = encoder_in / seconds;
+    double out_fps = encoder_out / seconds;
+    bool encoder_behind = encoder_in > 0 && encoder_out < encoder_in * 0.9;
+
+    bool overloaded = fill > config_.high_fill || process_ms > config_.frame_budget_ms || encoder_behind;
+    bool calm = fill < config_.low_fill && process_ms < config_.frame_budget_ms * 0.6 &&
+                encoder_out >= encoder_in * 0.98;
+
+    if (settling_) {
+        settling_ = false;
+        return;
+    }
+
+    int level = level_.load(std::memory_order_relaxed);
+    int next = level;
+    if (overloaded) {
+        calm_intervals_ = 0;
+        next = std::min(level + 1, kMaxLevel);
+    } else if (calm) {
+        if (++calm_intervals_ >= config_.recover_intervals) {
+            calm_intervals_ = 0;
+            next = std::max(level - 1, 0);
+        }
+    } else {
+        calm_intervals_ = 0;
+    }
+
+    if (next == level) {
+        return;
+    }
+
+    apply(next);
+    settling_ = true;
+    transitions_.fetch_add(1, std::memory_order_relaxed);
+
+    char reason[160];
+    std::snprintf(reason, sizeof(reason), "очередь %.0f%%, обработка %.1f мс/кадр, кодер %.1f/%.1f fps",
+                  fill * 100, process_ms, out_fps, in_fps);
+    std::cerr << name_ << ": уровень нагрузки " << level << " -> " << next
+              << " (битрейт " << bitrate() << " кбит/с; " << reason << ")" << std::endl;
+}
+
+void AdaptiveController::apply(int level) {
+    const LevelActions &actions = kLevels[level];
+    int bitrate = std::max(config_.min_bitrate, (int)(config_.bitrate * actions.bitrate_scale));
+
+    level_.store(level, std::memory_order_relaxed);
+
+    if (bitrate != bitrate_.exchange(bitrate, std::memory_order_relaxed)) {
+        // bitrate x264enc меняется на ходу, кодер перенастраивается со следующего кадра
+        if (encoder_) {
+            g_object_set(G_OBJECT(encoder_), "bitrate", (guint)bitrate, NULL);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef VIDSTREAM_ADAPTIVE_CONTROLLER_HPP
+#define VIDSTREAM_ADAPTIVE_CONTROLLER_HPP
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct AdaptiveConfig {
+    int bitrate = 500;             // кбит/с без нагрузки
+    int min_bitrate = 150;         // нижняя граница при снижении
+    double interval = 0.5;         // период регулятора, с
+    double frame_budget_ms = 30;   // допустимое время обработки на входной кадр
+    double high_fill = 0.5;        // заполненность очереди перед кодером: выше - перегрузка
+    double low_fill = 0.125;       // ниже - запас есть
+    int recover_intervals = 4;     // спокойных периодов подряд до шага обратно
+};
+
+// Замкнутый регулятор нагрузки потока. Раз в interval он смотрит на
+// заполненность очереди перед кодером, среднее время обработки на входной
+// кадр и пропускную способность кодера (буферы на его входе и выходе).
+// При перегрузке уровень повышается на шаг, после recover_intervals
+// спокойных периодов подряд - понижается. Период сразу после перехода
+// пропускается, чтобы очереди успели отреагировать:
+//
+//   0 - норма
+//   1 - битрейт 70%
+//   2 - битрейт 50%, обрабатывается каждый второй кадр
+//   3 - то же, и кадры без обработки выбрасываются перед кодером
+//   4 - битрейт 30%, обрабатывается и кодируется каждый третий кадр
+//
+// Кадр без обработки получает размытие и контуры прошлого обработанного
+// кадра, так что наложение не мигает. Обработка и кодирование решаются
+// одним решением по кадру (next_frame): кодируются только обработанные
+// кадры, а кадр, который не кодируется, помечается флагом
+// kAdaptiveSkipEncode и выбрасывается на паде attach_drop_point. Каждый
+// переход пишется в журнал и виден в счётчиках, поэтому задержка остаётся
+// ограниченной при нехватке процессора, а не растёт вместе с очередями.
+
+// Флаг буфера кадра, который регулятор решил не кодировать. Копируется
+// вместе с метками времени через videoconvert и очереди до точки выбрасывания
+static const GstBufferFlags kAdaptiveSkipEncode = GST_BUFFER_FLAG_LAST;
+
+// Решение по очередному кадру
+struct FrameDecision {
+    bool process = true;  // искать края и контуры заново
+    bool encode = true;   // отдавать кодеру; false - пометить kAdaptiveSkipEncode
+};
+
+class AdaptiveController {
+public:
+    // Заполненность очереди перед кодером, 0..1
+    typedef std::function<double()> FillReader;
+
+    AdaptiveController(const std::string &name, const AdaptiveConfig &config);
+    ~AdaptiveController();
+
+    AdaptiveController(const AdaptiveController &) = delete;
+    AdaptiveController &operator=(const AdaptiveController &) = delete;
+
+    void set_fill_reader(FillReader reader);
+    // Кодер, которому меняется битрейт; на его падах считаются буферы
+    void attach_encoder(GstElement *encoder);
+    // Пад, на котором кадры с флагом kAdaptiveSkipEncode выбрасываются перед кодером
+    void attach_drop_point(GstElement *element, const char *pad_name);
+
+    // Из потока обработки: что делать с очередным кадром
+    FrameDecision next_frame();
+    // Длительность обработки кадра, для которого next_frame вернул process
+    void record_processing(uint64_t ns);
+
+    // Один шаг регулятора по счётчикам прошедшего периода длиной seconds.
+    // Вызывается потоком регулятора; без start() - напрямую, например в тестах
+    void update(double seconds);
+
+    void start();
+    void stop();
+
+    int level() const { return level_.load(std::memory_order_relaxed); }
+    int bitrate() const { return bitrate_.load(std::memory_order_relaxed); }
+    uint64_t transitions() const { return transitions_.load(std::memory_order_relaxed); }
+    uint64_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static GstPadProbeReturn count_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    static GstPadProbeReturn drop_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+
+    void control_loop();
+    void apply(int level);
+
+    std::string name_;
+    AdaptiveConfig config_;
+    FillReader fill_reader_;
+    GstElement *encoder_;
+
+    std::atomic<int> level_;
+    std::atomic<int> bitrate_;
+    int calm_intervals_;
+    bool settling_;  // период после перехода: его действие ещё не видно
+
+    // Счётчики за текущий период
+    std::atomic<uint64_t> frames_seen_;
+    std::atomic<uint64_t> process_ns_;
+    std::atomic<uint64_t> encoder_in_;
+    std::atomic<uint64_t> encoder_out_;
+    std::atomic<uint64_t> frame_counter_;  // общий для обработки и кодирования
+
+    std::atomic<uint64_t> transitions_;
+    std::atomic<uint64_t> skipped_;
+    std::atomic<uint64_t> dropped_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool running_;
+    std::thread thread_;
+};
+
+#endif // VIDSTREAM_ADAPTIVE_CONTROLLER_HPP
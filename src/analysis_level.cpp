@@ -0,0 +1,36 @@
+#include "analysis_level.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+// Вес нового кадра в скользящем среднем
+static const double kAverageWeight = 0.1;
+
+AnalysisLevelChooser::AnalysisLevelChooser(const std::string &name, const AnalysisLevelParams &params)
+    : name_(name), params_(params), level_(0), average_ns_(0), frames_(0), transitions_(0) {}
+
+int AnalysisLevelChooser::record(uint64_t ns) {
+    average_ns_ = frames_ == 0 ? (double)ns : average_ns_ + kAverageWeight * ((double)ns - average_ns_);
+    if (++frames_ < params_.hold_frames) {
+        return level_;
+    }
+
+    const double budget = (double)params_.budget_ns;
+    int next = level_;
+    if (average_ns_ > budget && level_ < params_.max_level) {
+        next = level_ + 1;
+    } else if (level_ > 0 && average_ns_ * 4 < budget * params_.lower_fraction) {
+        next = level_ - 1;
+    }
+
+    if (next != level_) {
+        char reason[128];
+        std::snprintf(reason, sizeof(reason), "обработка %.1f мс/кадр, бюджет %.1f мс",
+                      average_ns_ / 1e6, budget / 1e6);
+        std::cerr << name_ << ": уровень анализа " << level_ << " -> " << next << " (" << reason << ")" << std::endl;
+        level_ = next;
+        frames_ = 0;
+        ++transitions_;
+    }
+    return level_;
+}
@@ -0,0 +1,43 @@
+#ifndef VIDSTREAM_ANALYSIS_LEVEL_HPP
+#define VIDSTREAM_ANALYSIS_LEVEL_HPP
+
+#include <cstdint>
+#include <string>
+
+struct AnalysisLevelParams {
+    uint64_t budget_ns = 33333333;  // допустимое время обработки кадра
+    int max_level = 3;              // не больше kMaxDownsampleLevel
+    double lower_fraction = 0.6;    // доля бюджета, в которую должен уложиться уровень ниже
+    int hold_frames = 30;           // кадров на уровне до следующего решения
+};
+
+// Автовыбор уровня анализа (края и контуры ищутся в кадре, уменьшенном в
+// 2^level раз) по бюджету кадра. По скользящему среднему времени обработки
+// уровень повышается, если кадры не укладываются в бюджет, и понижается,
+// если на уровень ниже, где пикселей вчетверо больше, обработка уложится
+// в lower_fraction бюджета. После перехода решение ждёт hold_frames кадров,
+// чтобы среднее успело набраться на новом уровне.
+class AnalysisLevelChooser {
+public:
+    // name - имя потока для журнала переходов
+    AnalysisLevelChooser(const std::string &name, const AnalysisLevelParams &params);
+
+    void set_budget(uint64_t budget_ns) { params_.budget_ns = budget_ns; }
+    uint64_t budget() const { return params_.budget_ns; }
+
+    int level() const { return level_; }
+    uint64_t transitions() const { return transitions_; }
+
+    // Время обработки кадра на уровне level(); возвращает уровень для следующего
+    int record(uint64_t ns);
+
+private:
+    std::string name_;
+    AnalysisLevelParams params_;
+    int level_;
+    double average_ns_;
+    int frames_;  // кадров на текущем уровне
+    uint64_t transitions_;
+};
+
+#endif // VIDSTREAM_ANALYSIS_LEVEL_HPP
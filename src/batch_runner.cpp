@@ -0,0 +1,291 @@
+#include "batch_runner.hpp"
+#include "frame_executor.hpp"
+#include "pipeline_util.hpp"
+#include "stage_graph.hpp"
+
+#include <opencv2/core.hpp>
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+// Результат одного файла для итоговой сводки
+struct BatchResult {
+    uint64_t frames = 0;
+    double seconds = 0;
+    bool ok = false;
+};
+
+// Файл контуров: кадр кодируется ContourPacketWriter в датаграммы
+// наибольшего размера, каждая пишется записью с длиной
+class ContourFile {
+public:
+    ContourFile() : writer_(make_params()), sequence_(0) {}
+
+    bool open(const std::string &path) {
+        out_.open(path.c_str(), std::ios::binary | std::ios::trunc);
+        return out_.is_open();
+    }
+
+    // Из стадии вывода исполнителя, в порядке кадров
+    void write(const FlatContours &contours, GstClockTime pts, cv::Size frame_size) {
+        writer_.encode(contours, sequence_++, GST_CLOCK_TIME_IS_VALID(pts) ? pts : kContourPacketNoPts, frame_size);
+        for (size_t i = 0; i < writer_.datagrams(); ++i) {
+            uint32_t size = (uint32_t)writer_.datagram_size(i);
+            unsigned char length[4] = { (unsigned char)size, (unsigned char)(size >> 8),
+                                        (unsigned char)(size >> 16), (unsigned char)(size >> 24) };
+            out_.write((const char *)length, sizeof(length));
+            out_.write((const char *)writer_.datagram(i), size);
+        }
+    }
+
+    bool close() {
+        out_.close();
+        return !out_.fail();
+    }
+
+private:
+    static ContourPacketParams make_params() {
+        ContourPacketParams params;
+        params.max_datagram = kMaxContourDatagram;
+        return params;
+    }
+
+    std::ofstream out_;
+    ContourPacketWriter writer_;
+    uint64_t sequence_;
+};
+
+// Путь результата: имя входного файла без расширения и suffix в каталоге вывода
+static std::string output_path(const BatchConfig &config, const std::string &input, const char *suffix) {
+    gchar *base = g_path_get_basename(input.c_str());
+    std::string stem = base;
+    g_free(base);
+    size_t dot = stem.rfind('.');
+    if (dot != std::string::npos && dot > 0) {
+        stem.resize(dot);
+    }
+
+    gchar *path = g_build_filename(config.output_dir.c_str(), (stem + suffix).c_str(), NULL);
+    std::string result = path;
+    g_free(path);
+    return result;
+}
+
+static std::string quoted(const std::string &text) {
+    gchar *escaped = g_strescape(text.c_str(), NULL);
+    std::string result = std::string("\"") + escaped + "\"";
+    g_free(escaped);
+    return result;
+}
+
+static GstElement *launch(const std::string &description) {
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description.c_str(), &error);
+    if (error) {
+        std::cerr << "Ошибка конвейера: " << error->message << std::endl;
+        g_error_free(error);
+        if (pipeline) {
+            gst_object_unref(pipeline);
+        }
+        return NULL;
+    }
+    return pipeline;
+}
+
+// Ошибка на шине конвейера; false - за timeout ошибок не было
+static bool pop_error(GstElement *pipeline, GstClockTime timeout, const std::string &input) {
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *message = gst_bus_timed_pop_filtered(bus, timeout, GST_MESSAGE_ERROR);
+    gst_object_unref(bus);
+    if (!message) {
+        return false;
+    }
+
+    GError *err;
+    gchar *debug;
+    gst_message_parse_error(message, &err, &debug);
+    std::cerr << input << ": " << err->message << std::endl;
+    g_error_free(err);
+    g_free(debug);
+    gst_message_unref(message);
+    return true;
+}
+
+static void release_pipeline(GstElement *pipeline) {
+    if (pipeline) {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(pipeline);
+    }
+}
+
+static bool run_file(const BatchConfig &config, WorkerScheduler &scheduler, const std::string &input,
+                     BatchResult &result) {
+    // Источник не живой, appsink без синхронизации: decodebin выдаёт кадры,
+    // пока есть место в appsink, а дальше ждёт исполнитель
+    std::ostringstream src_description;
+    src_description << "filesrc location=" << quoted(input) << " ! decodebin ! videoconvert"
+                    << " ! video/x-raw,format=BGR"
+                    << " ! appsink name=sink sync=false max-buffers=2 drop=false emit-signals=false";
+    GstElement *src = launch(src_description.str());
+    if (!src) {
+        return false;
+    }
+
+    GstElement *dst = NULL;
+    if (config.write_video) {
+        std::ostringstream dst_description;
+        dst_description << "appsrc name=source format=time is-live=false block=true"
+                        << " ! videoconvert ! x264enc speed-preset=ultrafast bitrate=" << config.bitrate
+                        << " ! h264parse ! mp4mux ! filesink location=" << quoted(output_path(config, input, ".mp4"));
+        dst = launch(dst_description.str());
+        if (!dst) {
+            release_pipeline(src);
+            return false;
+        }
+    }
+
+    ContourFile contours;
+    std::string contours_path = output_path(config, input, ".contours");
+    if (config.write_contours && !contours.open(contours_path)) {
+        std::cerr << "Не удалось создать " << contours_path << std::endl;
+        release_pipeline(src);
+        release_pipeline(dst);
+        return false;
+    }
+
+    GstElement *appsink = gst_bin_get_by_name(GST_BIN(src), "sink");
+    GstElement *appsrc = dst ? gst_bin_get_by_name(GST_BIN(dst), "source") : NULL;
+
+    // Кадры не выбрасываются: при заполненной очереди захват ждёт обработку
+    ExecutorConfig executor_config;
+    executor_config.name = input;
+    executor_config.queue_capacity = config.queue_capacity;
+    executor_config.drop_policy = DropPolicy::Block;
+    executor_config.live = false;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok = (!dst || gst_element_set_state(dst, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE) &&
+              gst_element_set_state(src, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE;
+    if (!ok) {
+        std::cerr << input << ": не удалось запустить конвейер" << std::endl;
+    }
+
+    ExecutorStats stats;
+    if (ok) {
+        FrameExecutor executor(appsink, appsrc, executor_config, &scheduler);
+        if (config.write_contours) {
+            executor.set_contours_callback([&contours](const FlatContours &frame_contours, GstClockTime pts,
+                                                       cv::Size size) {
+                contours.write(frame_contours, pts, size);
+            });
+        }
+        if (!config.stages.empty()) {
+            std::shared_ptr<StageGraph> graph = std::make_shared<StageGraph>();
+            std::string error;
+            if (graph->compile(config.stages, error)) {
+                executor.set_stage_graph(graph);
+            }
+        }
+        ok = executor.start();
+
+        // До конца файла или первой ошибки декодирования
+        while (ok && !executor.capture_eos()) {
+            if (pop_error(src, 100 * GST_MSECOND, input) || (dst && pop_error(dst, 0, input))) {
+                // Остановка сбрасывает appsrc, иначе вывод ждал бы места в его очереди вечно
+                gst_element_set_state(src, GST_STATE_NULL);
+                if (dst) {
+                    gst_element_set_state(dst, GST_STATE_NULL);
+                }
+                ok = false;
+                break;
+            }
+        }
+
+        // Исполнитель дообрабатывает очередь и отдаёт последние кадры
+        executor.stop();
+        stats = executor.stats();
+    }
+
+    if (ok && appsrc) {
+        gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
+        ok = wait_for_eos(dst, input);
+    }
+    if (config.write_contours && !contours.close()) {
+        std::cerr << "Ошибка записи " << contours_path << std::endl;
+        ok = false;
+    }
+
+    result.frames = stats.processed;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.ok = ok && stats.failed == 0;
+
+    gst_object_unref(appsink);
+    if (appsrc) {
+        gst_object_unref(appsrc);
+    }
+    release_pipeline(src);
+    release_pipeline(dst);
+    return result.ok;
+}
+
+static void print_result(const std::string &name, const BatchResult &result) {
+    char line[160];
+    std::snprintf(line, sizeof(line), ": %llu кадров за %.2f с, %.1f кадров/с",
+                  (unsigned long long)result.frames, result.seconds,
+                  result.seconds > 0 ? result.frames / result.seconds : 0.0);
+    std::cout << name << line << (result.ok ? "" : " (ошибка)") << std::endl;
+}
+
+int run_batch(const BatchConfig &config, WorkerScheduler &scheduler) {
+    const size_t files = config.inputs.size();
+    size_t jobs = config.jobs > 0 ? config.jobs : scheduler.workers();
+    jobs = std::max<size_t>(1, std::min(jobs, files));
+
+    // Параллелизм - по кадрам на пуле; полосы detect_edges в пуле OpenCV
+    // заняли бы ещё столько же потоков
+    int cv_threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+
+    std::cout << "Пакетная обработка: файлов " << files << ", одновременно " << jobs
+              << ", рабочих потоков " << scheduler.workers() << std::endl;
+
+    std::vector<BatchResult> results(files);
+    std::atomic<size_t> next(0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t j = 0; j < jobs; ++j) {
+        threads.emplace_back([&config, &scheduler, &results, &next, files]() {
+            for (size_t i = next++; i < files; i = next++) {
+                run_file(config, scheduler, config.inputs[i], results[i]);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    cv::setNumThreads(cv_threads);
+
+    BatchResult total;
+    total.ok = true;
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < files; ++i) {
+        print_result(config.inputs[i], results[i]);
+        total.frames += results[i].frames;
+        total.ok = total.ok && results[i].ok;
+    }
+    print_result("Итого", total);
+
+    return total.ok ? 0 : -1;
+}
@@ -0,0 +1,38 @@
+#ifndef VIDSTREAM_BATCH_RUNNER_HPP
+#define VIDSTREAM_BATCH_RUNNER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "contour_packet.hpp"
+#include "worker_scheduler.hpp"
+
+struct BatchConfig {
+    std::vector<std::string> inputs;
+    std::string output_dir = ".";
+    bool write_video = true;      // <имя>.mp4: кадры с наложением в H.264
+    bool write_contours = false;  // <имя>.contours: контуры каждого кадра
+    int bitrate = 2000;           // кбит/с
+    size_t jobs = 0;              // файлов одновременно; 0 - по числу рабочих пула
+    size_t queue_capacity = 8;
+    std::string stages;           // стадии обработки (StageGraph); пусто - стандартная цепочка
+};
+
+// Пакетная обработка записанных файлов: "filesrc ! decodebin ! videoconvert
+// ! appsink" без живого источника и синхронизации с часами, поэтому файл
+// читается так быстро, как успевает обработка. Кадры обрабатывает
+// FrameExecutor на общем пуле scheduler - кадры одного файла идут на
+// несколько рабочих сразу и собираются по порядку, - так что число потоков
+// обработки ограничено пулом при любом числе файлов. Внутрикадровый
+// параллелизм OpenCV на это время выключается, чтобы не превышать бюджет.
+//
+// Файл контуров - записи "длина (4 байта, little-endian) + датаграмма" в
+// формате contour_packet.hpp, кадр обычно занимает одну запись; разбирается
+// decode_contour_packet.
+//
+// Возвращает 0, если все файлы обработаны; в конце печатает число кадров и
+// скорость по каждому файлу и общую.
+int run_batch(const BatchConfig &config, WorkerScheduler &scheduler);
+
+#endif // VIDSTREAM_BATCH_RUNNER_HPP
@@ -0,0 +1,112 @@
+#include "change_detector.hpp"
+#include "instrumentation.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace cv;
+
+ChangeDetector::ChangeDetector(const ChangeParams &params) : params_(params), frames_since_full_(0) {
+    params_.cell = std::max(1, params_.cell);
+    params_.tile = std::max(params_.cell, params_.tile / params_.cell * params_.cell);
+}
+
+void ChangeDetector::reset() {
+    reference_.release();
+    frame_size_ = Size();
+    frames_since_full_ = 0;
+}
+
+ChangeResult ChangeDetector::update(const Mat &image) {
+    TRACE_SPAN("change_detect");
+
+    ChangeResult result;
+    const int cell = params_.cell;
+    Size grid_size((image.cols + cell - 1) / cell, (image.rows + cell - 1) / cell);
+
+    // Средние по ячейкам; для цветного кадра яркость считается уже по сетке
+    if (image.channels() == 1) {
+        resize(image, grid_, grid_size, 0, 0, INTER_AREA);
+    } else {
+        resize(image, small_, grid_size, 0, 0, INTER_AREA);
+        cvtColor(small_, grid_, image.channels() == 4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+    }
+
+    if (image.size() != frame_size_ || reference_.empty() ||
+        ++frames_since_full_ >= (uint64_t)params_.refresh_interval) {
+        frame_size_ = image.size();
+        grid_.copyTo(reference_);
+        frames_since_full_ = 0;
+        return result;
+    }
+
+    const int cells_per_tile = params_.tile / cell;
+    const int tiles_x = (grid_size.width + cells_per_tile - 1) / cells_per_tile;
+    const int tiles_y = (grid_size.height + cells_per_tile - 1) / cells_per_tile;
+    std::vector<char> tile_dirty((size_t)tiles_x * tiles_y, 0);
+
+    for (int y = 0; y < grid_size.height; ++y) {
+        const uchar *current = grid_.ptr<uchar>(y);
+        const uchar *reference = reference_.ptr<uchar>(y);
+        char *row = &tile_dirty[(size_t)(y / cells_per_tile) * tiles_x];
+        for (int x = 0; x < grid_size.width; ++x) {
+            if (std::abs(current[x] - reference[x]) > params_.threshold) {
+                row[x / cells_per_tile] = 1;
+            }
+        }
+    }
+
+    int dirty_count = (int)std::count(tile_dirty.begin(), tile_dirty.end(), 1);
+    result.fraction = (double)dirty_count / tile_dirty.size();
+    if (result.fraction > params_.full_fraction) {
+        grid_.copyTo(reference_);
+        frames_since_full_ = 0;
+        return result;
+    }
+
+    result.full = false;
+
+    // Опорная сетка обновляется только там, где кадр будет обработан заново
+    Rect grid_bounds(0, 0, grid_size.width, grid_size.height);
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            if (tile_dirty[(size_t)ty * tiles_x + tx]) {
+                Rect cells = Rect(tx * cells_per_tile, ty * cells_per_tile, cells_per_tile, cells_per_tile) & grid_bounds;
+                grid_(cells).copyTo(reference_(cells));
+            }
+        }
+    }
+
+    // Строки плиток с изменениями; соседние строки сливаются в один прямоугольник
+    Rect frame_bounds(0, 0, image.cols, image.rows);
+    Rect current;
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        int first = -1, last = -1;
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            if (tile_dirty[(size_t)ty * tiles_x + tx]) {
+                if (first < 0) {
+                    first = tx;
+                }
+                last = tx;
+            }
+        }
+
+        if (first < 0) {
+            if (current.area() > 0) {
+                result.dirty.push_back(current & frame_bounds);
+                current = Rect();
+            }
+            continue;
+        }
+
+        Rect band(first * params_.tile, ty * params_.tile, (last - first + 1) * params_.tile, params_.tile);
+        current = current.area() > 0 ? (current | band) : band;
+    }
+    if (current.area() > 0) {
+        result.dirty.push_back(current & frame_bounds);
+    }
+
+    return result;
+}
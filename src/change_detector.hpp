@@ -0,0 +1,49 @@
+#ifndef VIDSTREAM_CHANGE_DETECTOR_HPP
+#define VIDSTREAM_CHANGE_DETECTOR_HPP
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct ChangeParams {
+    int cell = 8;                // сторона ячейки сетки яркости, пикселей
+    int tile = 32;               // сторона плитки; кратна cell
+    int threshold = 6;           // изменение средней яркости ячейки, считающееся движением
+    double full_fraction = 0.4;  // доля изменённых плиток, выше которой кадр обрабатывается целиком
+    int refresh_interval = 300;  // полная обработка не реже чем раз в столько кадров
+};
+
+struct ChangeResult {
+    bool full = true;              // обработать кадр целиком
+    double fraction = 1;           // доля изменённых плиток
+    std::vector<cv::Rect> dirty;   // изменённые области, по границам плиток
+};
+
+// Детектор изменений между кадрами потока по сетке средних яркостей ячеек
+// cell x cell (уменьшение INTER_AREA, 1/64 пикселей кадра). Плитка считается
+// изменённой, если хоть одна её ячейка отличается от опорной сетки больше
+// порога. Опорные значения обновляются только у изменённых плиток, поэтому
+// медленный дрейф освещения накапливается и в итоге тоже вызывает обработку.
+// Соседние по вертикали строки плиток с изменениями объединяются в
+// прямоугольники.
+class ChangeDetector {
+public:
+    explicit ChangeDetector(const ChangeParams &params = ChangeParams());
+
+    // image - CV_8UC1 (яркость) или BGR/BGRA
+    ChangeResult update(const cv::Mat &image);
+    void reset();
+
+    const ChangeParams &params() const { return params_; }
+
+private:
+    ChangeParams params_;
+    cv::Mat reference_;  // опорная сетка, CV_8UC1
+    cv::Mat grid_;
+    cv::Mat small_;
+    cv::Size frame_size_;
+    uint64_t frames_since_full_;
+};
+
+#endif // VIDSTREAM_CHANGE_DETECTOR_HPP
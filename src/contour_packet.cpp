@@ -0,0 +1,186 @@
+#include "contour_packet.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+// Заголовок датаграммы не длиннее: 4 байта и пять varint по 10 байт
+static const size_t kMaxHeader = 4 + 5 * 10;
+
+// Флаги датаграммы
+static const uint8_t kLastDatagram = 1;
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+// zigzag: малые по модулю отрицательные числа тоже занимают один байт
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+ContourPacketWriter::ContourPacketWriter(const ContourPacketParams &params)
+    : params_(params), datagram_start_(0) {
+    // Датаграмма должна вмещать заголовок и хотя бы короткий контур
+    params_.max_datagram = std::min(std::max<size_t>(params_.max_datagram, kMaxHeader + 64), kMaxContourDatagram);
+}
+
+void ContourPacketWriter::begin_datagram(uint64_t sequence, uint64_t pts, cv::Size frame_size, uint64_t index) {
+    datagram_start_ = data_.size();
+    data_.push_back('V');
+    data_.push_back('C');
+    data_.push_back(kContourPacketVersion);
+    data_.push_back(0);
+    put_varint(data_, sequence);
+    put_varint(data_, pts + 1);  // kContourPacketNoPts переходит в 0
+    put_varint(data_, (uint64_t)frame_size.width);
+    put_varint(data_, (uint64_t)frame_size.height);
+    put_varint(data_, index);
+}
+
+void ContourPacketWriter::finish_datagram(bool last) {
+    data_[datagram_start_ + 3] = last ? kLastDatagram : 0;
+    ends_.push_back(data_.size());
+}
+
+void ContourPacketWriter::encode(const FlatContours &contours, uint64_t sequence, uint64_t pts, cv::Size frame_size) {
+    data_.clear();
+    ends_.clear();
+
+    uint64_t index = 0;
+    begin_datagram(sequence, pts, frame_size, index);
+    bool datagram_empty = true;
+    cv::Point base;
+
+    for (size_t i = 0; i < contours.size(); ++i) {
+        const cv::Point *points = contours.contour(i);
+        int count = contours.length(i);
+
+        if (params_.epsilon > 0 && count > 2) {
+            cv::Mat curve(count, 1, CV_32SC2, const_cast<cv::Point *>(points));
+            cv::approxPolyDP(curve, simplified_, params_.epsilon, true);
+            points = simplified_.data();
+            count = (int)simplified_.size();
+        }
+
+        // Разности точек после первой; контур длиннее предельной датаграммы обрезается
+        tail_.clear();
+        int encoded = 1;
+        const size_t tail_budget = kMaxContourDatagram - kMaxHeader - 3 * 10;
+        for (; encoded < count && tail_.size() < tail_budget; ++encoded) {
+            put_varint(tail_, zigzag((int64_t)points[encoded].x - points[encoded - 1].x));
+            put_varint(tail_, zigzag((int64_t)points[encoded].y - points[encoded - 1].y));
+        }
+
+        // Первая точка кодируется относительно датаграммы, в которую попадёт контур
+        size_t size = varint_size((uint64_t)encoded) +
+                      varint_size(zigzag((int64_t)points[0].x - base.x)) +
+                      varint_size(zigzag((int64_t)points[0].y - base.y)) + tail_.size();
+        if (!datagram_empty && data_.size() - datagram_start_ + size > params_.max_datagram) {
+            finish_datagram(false);
+            begin_datagram(sequence, pts, frame_size, ++index);
+            datagram_empty = true;
+            base = cv::Point();
+        }
+
+        put_varint(data_, (uint64_t)encoded);
+        put_varint(data_, zigzag((int64_t)points[0].x - base.x));
+        put_varint(data_, zigzag((int64_t)points[0].y - base.y));
+        data_.insert(data_.end(), tail_.begin(), tail_.end());
+        base = points[0];
+        datagram_empty = false;
+    }
+
+    finish_datagram(true);
+}
+
+// Чтение varint с проверкой границы датаграммы
+static bool get_varint(const uint8_t *&pos, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos == end) {
+            return false;
+        }
+        uint8_t byte = *pos++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool get_coordinate(const uint8_t *&pos, const uint8_t *end, int base, int &value) {
+    uint64_t raw = 0;
+    if (!get_varint(pos, end, raw)) {
+        return false;
+    }
+    int64_t delta = unzigzag(raw);
+    if (delta < -(int64_t)UINT32_MAX || delta > (int64_t)UINT32_MAX) {
+        return false;
+    }
+    int64_t result = base + delta;
+    if (result < INT32_MIN || result > INT32_MAX) {
+        return false;
+    }
+    value = (int)result;
+    return true;
+}
+
+bool decode_contour_packet(const uint8_t *data, size_t size, ContourPacket &packet) {
+    packet.contours.clear();
+    if (size < 4 || data[0] != 'V' || data[1] != 'C' || data[2] != kContourPacketVersion) {
+        return false;
+    }
+    packet.last = (data[3] & kLastDatagram) != 0;
+
+    const uint8_t *pos = data + 4;
+    const uint8_t *end = data + size;
+    uint64_t pts = 0, width = 0, height = 0;
+    if (!get_varint(pos, end, packet.sequence) || !get_varint(pos, end, pts) ||
+        !get_varint(pos, end, width) || !get_varint(pos, end, height) ||
+        !get_varint(pos, end, packet.index) || width > INT32_MAX || height > INT32_MAX) {
+        return false;
+    }
+    packet.pts = pts - 1;
+    packet.frame_size = cv::Size((int)width, (int)height);
+
+    cv::Point base;
+    while (pos != end) {
+        uint64_t count = 0;
+        cv::Point point;
+        // Каждая точка занимает не меньше двух байт
+        if (!get_varint(pos, end, count) || count == 0 || count > (uint64_t)(end - pos) / 2 ||
+            !get_coordinate(pos, end, base.x, point.x) || !get_coordinate(pos, end, base.y, point.y)) {
+            return false;
+        }
+        base = point;
+        packet.contours.add_point(point);
+        for (uint64_t k = 1; k < count; ++k) {
+            if (!get_coordinate(pos, end, point.x, point.x) || !get_coordinate(pos, end, point.y, point.y)) {
+                return false;
+            }
+            packet.contours.add_point(point);
+        }
+        packet.contours.end_contour();
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef VIDSTREAM_CONTOUR_PACKET_HPP
+#define VIDSTREAM_CONTOUR_PACKET_HPP
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "flat_contours.hpp"
+
+// Контуры кадра в компактном двоичном виде для отправки по UDP вместо видео.
+// Кадр занимает одну или несколько датаграмм, каждая разбирается отдельно:
+// потеря датаграммы теряет только её контуры.
+//
+// Датаграмма (целые - varint LEB128, знаковые - zigzag + varint):
+//   'V' 'C'              сигнатура
+//   версия               1 байт, kContourPacketVersion
+//   флаги                1 байт: бит 0 - последняя датаграмма кадра
+//   номер кадра
+//   PTS + 1, нс          0 - у кадра нет метки времени
+//   ширина, высота кадра
+//   номер датаграммы в кадре
+//   контуры до конца датаграммы: число точек; первая точка - разность с
+//   первой точкой предыдущего контура датаграммы (для первого - с (0, 0));
+//   остальные - разности с предыдущей точкой (знаковые)
+//
+// Кадр без контуров - одна датаграмма из заголовка.
+//
+// Контур не делится между датаграммами. Контур, не помещающийся в
+// max_datagram, уходит отдельной датаграммой до kMaxContourDatagram байт
+// (с IP-фрагментацией), точки сверх этого отбрасываются.
+
+static const uint8_t kContourPacketVersion = 1;
+static const uint64_t kContourPacketNoPts = UINT64_MAX;
+static const size_t kMaxContourDatagram = 65000;
+
+struct ContourPacketParams {
+    double epsilon = 0;          // упрощение approxPolyDP, пикселей; 0 - точки как есть
+    size_t max_datagram = 1400;  // размер датаграммы без IP-фрагментации
+};
+
+// Кодирует кадры; буферы переиспользуются от кадра к кадру
+class ContourPacketWriter {
+public:
+    explicit ContourPacketWriter(const ContourPacketParams &params = ContourPacketParams());
+
+    // pts - kContourPacketNoPts, если у кадра нет метки времени
+    void encode(const FlatContours &contours, uint64_t sequence, uint64_t pts, cv::Size frame_size);
+
+    size_t datagrams() const { return ends_.size(); }
+    const uint8_t *datagram(size_t i) const { return data_.data() + (i ? ends_[i - 1] : 0); }
+    size_t datagram_size(size_t i) const { return ends_[i] - (i ? ends_[i - 1] : 0); }
+
+private:
+    void begin_datagram(uint64_t sequence, uint64_t pts, cv::Size frame_size, uint64_t index);
+    void finish_datagram(bool last);
+
+    ContourPacketParams params_;
+    std::vector<uint8_t> data_;          // датаграммы кадра подряд
+    std::vector<size_t> ends_;           // конец каждой датаграммы в data_
+    size_t datagram_start_;
+    std::vector<uint8_t> tail_;          // разности точек текущего контура после первой
+    std::vector<cv::Point> simplified_;
+};
+
+// Разобранная датаграмма
+struct ContourPacket {
+    uint64_t sequence = 0;
+    uint64_t pts = kContourPacketNoPts;
+    cv::Size frame_size;
+    uint64_t index = 0;
+    bool last = false;
+    FlatContours contours;
+};
+
+// false - датаграмма повреждена или другой версии
+bool decode_contour_packet(const uint8_t *data, size_t size, ContourPacket &packet);
+
+#endif // VIDSTREAM_CONTOUR_PACKET_HPP
@@ -0,0 +1,155 @@
+#include "control_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <sstream>
+
+ControlServer::ControlServer(int port) : port_(port), listen_fd_(-1), running_(false) {}
+
+ControlServer::~ControlServer() {
+    stop();
+}
+
+void ControlServer::add_command(const std::string &name, const std::string &usage, Handler handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Command command;
+    command.usage = usage;
+    command.handler = handler;
+    commands_[name] = command;
+}
+
+void ControlServer::clear_commands() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    commands_.clear();
+}
+
+bool ControlServer::start() {
+    if (running_) {
+        return true;
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr = sockaddr_in();
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port_);
+
+    if (listen_fd_ < 0 || bind(listen_fd_, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd_, 4) < 0) {
+        std::cerr << "Не удалось открыть порт управления " << port_ << std::endl;
+        if (listen_fd_ >= 0) {
+            close(listen_fd_);
+        }
+        listen_fd_ = -1;
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&ControlServer::serve_loop, this);
+    return true;
+}
+
+void ControlServer::stop() {
+    if (!running_) {
+        return;
+    }
+    running_ = false;
+
+    thread_.join();
+    close(listen_fd_);
+    listen_fd_ = -1;
+}
+
+std::string ControlServer::help() const {
+    std::string text;
+    for (const auto &command : commands_) {
+        text += command.first + " " + command.second.usage + "\n";
+    }
+    return text;
+}
+
+std::string ControlServer::execute(const std::string &line) {
+    std::istringstream in(line);
+    std::string name;
+    in >> name;
+    std::vector<std::string> args;
+    std::string arg;
+    while (in >> arg) {
+        args.push_back(arg);
+    }
+
+    if (name.empty()) {
+        return "";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (name == "help") {
+        return help();
+    }
+    auto it = commands_.find(name);
+    if (it == commands_.end()) {
+        return "error: неизвестная команда " + name + "\n";
+    }
+    return it->second.handler(args);
+}
+
+void ControlServer::serve_loop() {
+    while (running_) {
+        pollfd pfd = pollfd();
+        pfd.fd = listen_fd_;
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        int client = accept(listen_fd_, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+
+        // Команды читаются до закрытия записи клиентом или паузы: короткой
+        // после законченной строки, секундной - посреди строки
+        std::string request;
+        char buffer[1024];
+        pollfd cfd = pollfd();
+        cfd.fd = client;
+        cfd.events = POLLIN;
+        while (running_ && request.size() < 64 * 1024 &&
+               poll(&cfd, 1, !request.empty() && request.back() == '\n' ? 50 : 1000) > 0) {
+            ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                break;
+            }
+            request.append(buffer, (size_t)n);
+        }
+
+        std::string response;
+        std::istringstream lines(request);
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            response += execute(line);
+        }
+
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += (size_t)n;
+        }
+        close(client);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef VIDSTREAM_CONTROL_SERVER_HPP
+#define VIDSTREAM_CONTROL_SERVER_HPP
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Текстовый канал управления на 127.0.0.1:PORT. Соединение передаёт одну
+// или несколько команд по строке, сервер отвечает на каждую и закрывает
+// соединение:
+//
+//   echo "add camera0 10.0.0.5:5000" | nc 127.0.0.1 PORT
+//
+// Команды выполняются в потоке сервера по одной, поэтому обработчикам
+// достаточно потокобезопасности относительно конвейера.
+class ControlServer {
+public:
+    // Аргументы без имени команды; результат - текст ответа
+    typedef std::function<std::string(const std::vector<std::string> &args)> Handler;
+
+    explicit ControlServer(int port);
+    ~ControlServer();
+
+    ControlServer(const ControlServer &) = delete;
+    ControlServer &operator=(const ControlServer &) = delete;
+
+    void add_command(const std::string &name, const std::string &usage, Handler handler);
+    // Вызывается до разрушения объектов, на которые ссылаются обработчики
+    void clear_commands();
+
+    bool start();
+    void stop();
+
+    // Выполняет строку команды так же, как для клиента
+    std::string execute(const std::string &line);
+
+private:
+    struct Command {
+        std::string usage;
+        Handler handler;
+    };
+
+    void serve_loop();
+    std::string help() const;
+
+    int port_;
+    int listen_fd_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Command> commands_;
+};
+
+#endif // VIDSTREAM_CONTROL_SERVER_HPP
@@ -0,0 +1,553 @@
+#include "cv_filter.hpp"
+#include "adaptive_controller.hpp"
+#include "analysis_level.hpp"
+#include "edge_engine.hpp"
+#include "instrumentation.hpp"
+#include "processing.hpp"
+#include "stage_graph.hpp"
+
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include <memory>
+
+using namespace cv;
+
+// Форматы, которые обрабатываются без преобразования: упакованные - как Mat
+// OpenCV, YUV 4:2:0 - по планам
+#define CV_FILTER_CAPS GST_VIDEO_CAPS_MAKE("{ BGR, BGRx, BGRA, GRAY8, I420, NV12 }")
+
+#define CV_FILTER(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), CV_TYPE_FILTER, CvFilter))
+
+typedef struct _CvFilter {
+    GstVideoFilter parent;
+
+    // Память экземпляра GObject не проходит через конструкторы C++,
+    // поэтому std::function хранится по указателю
+    CvFilterCallback *callback;
+    CvFilterContoursCallback *contours_callback;
+    CvFilterDispatcher *dispatcher;
+    AdaptiveController *controller;
+    IncrementalState *state;  // края и контуры прошлых кадров
+    AnalysisLevelChooser *chooser;  // при analysis-level = -1
+    gboolean incremental;
+    gint analysis_level;
+    guint64 analysis_budget;
+    gboolean output_blur;
+    gint low_threshold;
+    gint high_threshold;
+    std::shared_ptr<const StageGraph> *graph;  // заменяется целиком при смене stages
+    gint current_level;
+    guint64 frames_processed;
+    guint64 frames_unchanged;
+    guint64 frames_partial;
+} CvFilter;
+
+typedef struct _CvFilterClass {
+    GstVideoFilterClass parent_class;
+} CvFilterClass;
+
+enum {
+    PROP_0,
+    PROP_FRAMES_PROCESSED,
+    PROP_FRAMES_UNCHANGED,
+    PROP_FRAMES_PARTIAL,
+    PROP_INCREMENTAL,
+    PROP_ANALYSIS_LEVEL,
+    PROP_ANALYSIS_BUDGET,
+    PROP_CURRENT_ANALYSIS_LEVEL,
+    PROP_OUTPUT_BLUR,
+    PROP_LOW_THRESHOLD,
+    PROP_HIGH_THRESHOLD,
+    PROP_STAGES
+};
+
+G_DEFINE_TYPE(CvFilter, cv_filter, GST_TYPE_VIDEO_FILTER);
+
+static void cv_filter_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+    CvFilter *filter = CV_FILTER(object);
+
+    switch (prop_id) {
+        case PROP_FRAMES_PROCESSED:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_uint64(value, filter->frames_processed);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_FRAMES_UNCHANGED:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_uint64(value, filter->frames_unchanged);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_FRAMES_PARTIAL:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_uint64(value, filter->frames_partial);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_INCREMENTAL:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_boolean(value, filter->incremental);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_ANALYSIS_LEVEL:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_int(value, filter->analysis_level);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_ANALYSIS_BUDGET:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_uint64(value, filter->analysis_budget);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_CURRENT_ANALYSIS_LEVEL:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_int(value, filter->current_level);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_OUTPUT_BLUR:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_boolean(value, filter->output_blur);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_LOW_THRESHOLD:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_int(value, filter->low_threshold);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_HIGH_THRESHOLD:
+            GST_OBJECT_LOCK(filter);
+            g_value_set_int(value, filter->high_threshold);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_STAGES: {
+            GST_OBJECT_LOCK(filter);
+            std::shared_ptr<const StageGraph> graph = *filter->graph;
+            GST_OBJECT_UNLOCK(filter);
+            g_value_set_string(value, stages_to_string(graph->stages()).c_str());
+            break;
+        }
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+// Нестандартный граф обрабатывает каждый кадр целиком на уровне 0:
+// включённые incremental и analysis-level к нему не применяются
+static void warn_unused_modes(CvFilter *filter) {
+    GST_OBJECT_LOCK(filter);
+    std::shared_ptr<const StageGraph> graph = *filter->graph;
+    gboolean incremental = filter->incremental;
+    gint level = filter->analysis_level;
+    GST_OBJECT_UNLOCK(filter);
+
+    if (!graph->standard() && (incremental || level != 0)) {
+        g_warning("cvfilter: stages \"%s\" are processed in full at level 0, %s%s%s not applied",
+                  stages_to_string(graph->stages()).c_str(), incremental ? "incremental" : "",
+                  incremental && level != 0 ? " and " : "", level != 0 ? "analysis-level" : "");
+    }
+}
+
+static void cv_filter_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
+    CvFilter *filter = CV_FILTER(object);
+
+    switch (prop_id) {
+        case PROP_INCREMENTAL:
+            GST_OBJECT_LOCK(filter);
+            filter->incremental = g_value_get_boolean(value);
+            GST_OBJECT_UNLOCK(filter);
+            warn_unused_modes(filter);
+            break;
+        case PROP_ANALYSIS_LEVEL:
+            GST_OBJECT_LOCK(filter);
+            filter->analysis_level = g_value_get_int(value);
+            GST_OBJECT_UNLOCK(filter);
+            warn_unused_modes(filter);
+            break;
+        case PROP_ANALYSIS_BUDGET:
+            GST_OBJECT_LOCK(filter);
+            filter->analysis_budget = g_value_get_uint64(value);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_OUTPUT_BLUR:
+            GST_OBJECT_LOCK(filter);
+            filter->output_blur = g_value_get_boolean(value);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_LOW_THRESHOLD:
+            GST_OBJECT_LOCK(filter);
+            filter->low_threshold = g_value_get_int(value);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_HIGH_THRESHOLD:
+            GST_OBJECT_LOCK(filter);
+            filter->high_threshold = g_value_get_int(value);
+            GST_OBJECT_UNLOCK(filter);
+            break;
+        case PROP_STAGES: {
+            // Граф собирается вне блокировки; при ошибке остаётся прежний
+            const gchar *text = g_value_get_string(value);
+            std::shared_ptr<StageGraph> graph = std::make_shared<StageGraph>();
+            std::string error;
+            if (!graph->compile(text ? text : standard_stages(), error)) {
+                g_warning("cvfilter: stages \"%s\": %s", text ? text : "", error.c_str());
+                break;
+            }
+            GST_OBJECT_LOCK(filter);
+            *filter->graph = graph;
+            GST_OBJECT_UNLOCK(filter);
+            warn_unused_modes(filter);
+            break;
+        }
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static void cv_filter_finalize(GObject *object) {
+    CvFilter *filter = CV_FILTER(object);
+
+    delete filter->callback;
+    filter->callback = nullptr;
+    delete filter->contours_callback;
+    filter->contours_callback = nullptr;
+    delete filter->dispatcher;
+    filter->dispatcher = nullptr;
+    delete filter->state;
+    filter->state = nullptr;
+    delete filter->chooser;
+    filter->chooser = nullptr;
+    delete filter->graph;
+    filter->graph = nullptr;
+
+    G_OBJECT_CLASS(cv_filter_parent_class)->finalize(object);
+}
+
+// Mat поверх плана отображённого на запись буфера: без копирования
+static Mat plane_mat(GstVideoFrame *frame, int plane, int component, int type) {
+    return Mat(GST_VIDEO_FRAME_COMP_HEIGHT(frame, component), GST_VIDEO_FRAME_COMP_WIDTH(frame, component), type,
+               GST_VIDEO_FRAME_PLANE_DATA(frame, plane), GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane));
+}
+
+// Как обрабатывать кадр: пропущенный регулятором нагрузки кадр получает
+// контуры прошлого обработанного кадра
+struct FrameMode {
+    bool process;
+    bool incremental;
+    int level;  // уровень анализа
+    bool blur;  // размывать кадр и на уровнях выше 0
+    EdgeParams edges;
+    const StageGraph *graph;  // нестандартный граф стадий или nullptr
+};
+
+// Нестандартный граф обрабатывает кадр целиком на уровне 0
+static void process_image(Mat &image, IncrementalState &state, FrameMode mode) {
+    if (mode.graph) {
+        if (mode.process) {
+            mode.graph->run(image, &state.overlay, mode.edges);
+        } else {
+            mode.graph->redraw(image, state.overlay);
+        }
+    } else if (!mode.process) {
+        redraw_frame_in_place(image, state.overlay, mode.blur);
+    } else if (mode.incremental) {
+        process_frame_incremental(image, state, mode.level, mode.edges, mode.blur);
+    } else {
+        process_frame_in_place(image, &state.overlay, mode.level, mode.edges, mode.blur);
+    }
+}
+
+static void process_yuv(YuvFrame &yuv, IncrementalState &state, FrameMode mode) {
+    if (mode.graph) {
+        if (mode.process) {
+            mode.graph->run(yuv, &state.overlay, mode.edges);
+        } else {
+            mode.graph->redraw(yuv, state.overlay);
+        }
+    } else if (!mode.process) {
+        redraw_yuv_frame_in_place(yuv, state.overlay, mode.blur);
+    } else if (mode.incremental) {
+        process_yuv_frame_incremental(yuv, state, mode.level, mode.edges, mode.blur);
+    } else {
+        process_yuv_frame_in_place(yuv, &state.overlay, mode.level, mode.edges, mode.blur);
+    }
+}
+
+// Бюджет автовыбора уровня анализа: заданный свойством или интервал кадров
+static uint64_t analysis_budget(GstVideoFilter *base, guint64 budget) {
+    if (budget > 0) {
+        return budget;
+    }
+    const GstVideoInfo &info = base->in_info;
+    if (info.fps_n > 0 && info.fps_d > 0) {
+        return gst_util_uint64_scale_int(GST_SECOND, info.fps_d, info.fps_n);
+    }
+    return AnalysisLevelParams().budget_ns;
+}
+
+// Выбранный уровень анализа кадра; chooser создаётся при первом кадре в
+// режиме автовыбора и получает имя конвейера потока
+static int frame_analysis_level(CvFilter *filter, gint level, guint64 budget) {
+    if (level >= 0) {
+        return level;
+    }
+    if (!filter->chooser) {
+        GstObject *parent = gst_object_get_parent(GST_OBJECT(filter));
+        gchar *name = gst_object_get_name(parent ? parent : GST_OBJECT(filter));
+        filter->chooser = new AnalysisLevelChooser(name, AnalysisLevelParams());
+        g_free(name);
+        if (parent) {
+            gst_object_unref(parent);
+        }
+    }
+    filter->chooser->set_budget(analysis_budget(GST_VIDEO_FILTER(filter), budget));
+    return filter->chooser->level();
+}
+
+// Обработка кадра по его формату; возвращает Mat для обратного вызова
+static Mat process_video_frame(GstVideoFrame *frame, IncrementalState &state, FrameMode mode) {
+    Mat image;
+
+    switch (GST_VIDEO_FRAME_FORMAT(frame)) {
+        case GST_VIDEO_FORMAT_I420: {
+            YuvFrame yuv;
+            yuv.y = plane_mat(frame, 0, 0, CV_8UC1);
+            yuv.u = plane_mat(frame, 1, 1, CV_8UC1);
+            yuv.v = plane_mat(frame, 2, 2, CV_8UC1);
+            process_yuv(yuv, state, mode);
+            image = yuv.y;
+            break;
+        }
+        case GST_VIDEO_FORMAT_NV12: {
+            YuvFrame yuv;
+            yuv.y = plane_mat(frame, 0, 0, CV_8UC1);
+            yuv.u = plane_mat(frame, 1, 1, CV_8UC2);
+            process_yuv(yuv, state, mode);
+            image = yuv.y;
+            break;
+        }
+        case GST_VIDEO_FORMAT_BGRx:
+        case GST_VIDEO_FORMAT_BGRA:
+            image = plane_mat(frame, 0, 0, CV_8UC4);
+            process_image(image, state, mode);
+            break;
+        case GST_VIDEO_FORMAT_GRAY8:
+            image = plane_mat(frame, 0, 0, CV_8UC1);
+            process_image(image, state, mode);
+            break;
+        default:
+            image = plane_mat(frame, 0, 0, CV_8UC3);
+            process_image(image, state, mode);
+            break;
+    }
+
+    return image;
+}
+
+static GstFlowReturn cv_filter_transform_frame_ip(GstVideoFilter *base, GstVideoFrame *frame) {
+    CvFilter *filter = CV_FILTER(base);
+    AdaptiveController *controller = filter->controller;
+    IncrementalState &state = *filter->state;
+    FrameMode mode;
+    FrameDecision decision = controller ? controller->next_frame() : FrameDecision();
+    mode.process = decision.process;
+    // Буфер обрабатывается на месте и доступен на запись
+    if (!decision.encode) {
+        GST_BUFFER_FLAG_SET(frame->buffer, kAdaptiveSkipEncode);
+    }
+    GST_OBJECT_LOCK(filter);
+    mode.incremental = filter->incremental;
+    gint level = filter->analysis_level;
+    guint64 budget = filter->analysis_budget;
+    mode.blur = filter->output_blur;
+    // Пороги читаются на каждый кадр: их можно менять на ходу
+    mode.edges.low_threshold = filter->low_threshold;
+    mode.edges.high_threshold = filter->high_threshold;
+    // Граф держится до конца кадра, даже если stages меняют на ходу
+    std::shared_ptr<const StageGraph> graph = *filter->graph;
+    GST_OBJECT_UNLOCK(filter);
+    mode.graph = graph->standard() ? nullptr : graph.get();
+    mode.level = mode.graph ? 0 : frame_analysis_level(filter, level, budget);
+    AnalysisLevelChooser *chooser = level < 0 && !mode.graph ? filter->chooser : nullptr;
+
+    // Карта краёв устаревает, пока инкрементальная обработка выключена;
+    // нестандартный граф её не ведёт
+    if (!mode.incremental || mode.graph) {
+        state.detector.reset();
+    }
+
+    uint64_t start = controller || chooser ? trace_now_ns() : 0;
+    Mat image;
+
+    if (filter->dispatcher) {
+        (*filter->dispatcher)([&image, &state, frame, mode]() {
+            image = process_video_frame(frame, state, mode);
+        });
+    } else {
+        image = process_video_frame(frame, state, mode);
+    }
+
+    // Ожидание общего пула тоже входит во время: это и есть нехватка процессора
+    if ((controller || chooser) && mode.process) {
+        uint64_t elapsed = trace_now_ns() - start;
+        if (controller) {
+            controller->record_processing(elapsed);
+        }
+        if (chooser) {
+            chooser->record(elapsed);
+        }
+    }
+
+    GST_OBJECT_LOCK(filter);
+    ++filter->frames_processed;
+    filter->current_level = state.overlay.level;
+    filter->frames_unchanged = state.frames_unchanged;
+    filter->frames_partial = state.frames_partial;
+    GST_OBJECT_UNLOCK(filter);
+
+    if (filter->callback) {
+        (*filter->callback)(image);
+    }
+    if (filter->contours_callback) {
+        (*filter->contours_callback)(state.overlay.contours, GST_BUFFER_PTS(frame->buffer),
+                                     Size(GST_VIDEO_FRAME_WIDTH(frame), GST_VIDEO_FRAME_HEIGHT(frame)));
+    }
+
+    return GST_FLOW_OK;
+}
+
+static void cv_filter_class_init(CvFilterClass *klass) {
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstVideoFilterClass *filter_class = GST_VIDEO_FILTER_CLASS(klass);
+
+    gobject_class->get_property = cv_filter_get_property;
+    gobject_class->set_property = cv_filter_set_property;
+    gobject_class->finalize = cv_filter_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_FRAMES_PROCESSED,
+        g_param_spec_uint64("frames-processed", "Frames processed", "Number of frames processed so far",
+                            0, G_MAXUINT64, 0, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_FRAMES_UNCHANGED,
+        g_param_spec_uint64("frames-unchanged", "Frames unchanged",
+                            "Frames whose edges and contours were reused without changes",
+                            0, G_MAXUINT64, 0, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_FRAMES_PARTIAL,
+        g_param_spec_uint64("frames-partial", "Frames partial",
+                            "Frames where only changed regions were reprocessed",
+                            0, G_MAXUINT64, 0, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_INCREMENTAL,
+        g_param_spec_boolean("incremental", "Incremental",
+                             "Reprocess only regions that changed since the previous frame",
+                             FALSE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_ANALYSIS_LEVEL,
+        g_param_spec_int("analysis-level", "Analysis level",
+                         "Find edges in the frame downscaled by 2^level (-1 - choose from the frame budget)",
+                         -1, kMaxDownsampleLevel, 0, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_ANALYSIS_BUDGET,
+        g_param_spec_uint64("analysis-budget", "Analysis budget",
+                            "Processing time per frame for analysis-level -1, ns (0 - frame interval)",
+                            0, G_MAXUINT64, 0, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_CURRENT_ANALYSIS_LEVEL,
+        g_param_spec_int("current-analysis-level", "Current analysis level",
+                         "Analysis level of the contours drawn on the last frame",
+                         0, kMaxDownsampleLevel, 0, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_OUTPUT_BLUR,
+        g_param_spec_boolean("output-blur", "Output blur",
+                             "Blur the full frame at analysis levels above 0 as well (one more pass over all pixels)",
+                             FALSE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_LOW_THRESHOLD,
+        g_param_spec_int("low-threshold", "Low threshold", "Lower hysteresis threshold of edge detection",
+                         0, kMaxEdgeThreshold, EdgeParams().low_threshold,
+                         (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_HIGH_THRESHOLD,
+        g_param_spec_int("high-threshold", "High threshold", "Upper hysteresis threshold of edge detection",
+                         0, kMaxEdgeThreshold, EdgeParams().high_threshold,
+                         (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_STAGES,
+        g_param_spec_string("stages", "Stages",
+                            "Comma-separated processing stages: blur, edges, threshold[:N], contours, draw, stamp",
+                            standard_stages(), (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    gst_element_class_set_static_metadata(element_class, "OpenCV contour overlay", "Filter/Effect/Video",
+                                          "Detects edges and draws contours over video frames in place",
+                                          "Vid-Stream-CV");
+
+    GstCaps *caps = gst_caps_from_string(CV_FILTER_CAPS);
+    gst_element_class_add_pad_template(element_class, gst_pad_template_new("sink", GST_PAD_SINK, GST_PAD_ALWAYS, caps));
+    gst_element_class_add_pad_template(element_class, gst_pad_template_new("src", GST_PAD_SRC, GST_PAD_ALWAYS, caps));
+    gst_caps_unref(caps);
+
+    filter_class->transform_frame_ip = cv_filter_transform_frame_ip;
+}
+
+static void cv_filter_init(CvFilter *filter) {
+    filter->callback = nullptr;
+    filter->contours_callback = nullptr;
+    filter->dispatcher = nullptr;
+    filter->controller = nullptr;
+    filter->state = new IncrementalState();
+    filter->chooser = nullptr;
+    filter->incremental = FALSE;
+    filter->analysis_level = 0;
+    filter->analysis_budget = 0;
+    filter->output_blur = FALSE;
+    filter->low_threshold = EdgeParams().low_threshold;
+    filter->high_threshold = EdgeParams().high_threshold;
+    filter->graph = new std::shared_ptr<const StageGraph>(std::make_shared<StageGraph>());
+    filter->current_level = 0;
+    filter->frames_processed = 0;
+    filter->frames_unchanged = 0;
+    filter->frames_partial = 0;
+
+    // Кадр рисуется поверх входного буфера; если буфер не доступен
+    // на запись, GstBaseTransform сам сделает его копию
+    gst_base_transform_set_in_place(GST_BASE_TRANSFORM(filter), TRUE);
+}
+
+bool cv_filter_register() {
+    return gst_element_register(NULL, "cvfilter", GST_RANK_NONE, CV_TYPE_FILTER);
+}
+
+void cv_filter_set_frame_callback(GstElement *element, CvFilterCallback callback) {
+    CvFilter *filter = CV_FILTER(element);
+
+    delete filter->callback;
+    filter->callback = callback ? new CvFilterCallback(callback) : nullptr;
+}
+
+void cv_filter_set_contours_callback(GstElement *element, CvFilterContoursCallback callback) {
+    CvFilter *filter = CV_FILTER(element);
+
+    delete filter->contours_callback;
+    filter->contours_callback = callback ? new CvFilterContoursCallback(callback) : nullptr;
+}
+
+void cv_filter_set_dispatcher(GstElement *element, CvFilterDispatcher dispatcher) {
+    CvFilter *filter = CV_FILTER(element);
+
+    delete filter->dispatcher;
+    filter->dispatcher = dispatcher ? new CvFilterDispatcher(dispatcher) : nullptr;
+}
+
+void cv_filter_set_adaptive_controller(GstElement *element, AdaptiveController *controller) {
+    CV_FILTER(element)->controller = controller;
+}
+
+void cv_filter_set_edge_thresholds(GstElement *element, int low, int high) {
+    CvFilter *filter = CV_FILTER(element);
+
+    GST_OBJECT_LOCK(filter);
+    filter->low_threshold = low;
+    filter->high_threshold = high;
+    GST_OBJECT_UNLOCK(filter);
+}
+
+void cv_filter_get_edge_thresholds(GstElement *element, int &low, int &high) {
+    CvFilter *filter = CV_FILTER(element);
+
+    GST_OBJECT_LOCK(filter);
+    low = filter->low_threshold;
+    high = filter->high_threshold;
+    GST_OBJECT_UNLOCK(filter);
+}
@@ -0,0 +1,75 @@
+#ifndef VIDSTREAM_CV_FILTER_HPP
+#define VIDSTREAM_CV_FILTER_HPP
+
+#include <opencv2/core.hpp>
+#include <gst/gst.h>
+
+#include <functional>
+
+class AdaptiveController;
+class FlatContours;
+
+// Элемент GStreamer "cvfilter": подкласс GstVideoFilter, который выполняет
+// process_frame_in_place прямо над буфером в потоке конвейера. Кадры не
+// покидают GStreamer, поэтому захват, обработка и кодирование работают в
+// одном конвейере с общими часами, запросами задержки и пулами буферов.
+// Кроме BGR/BGRx/BGRA/GRAY8 принимает I420 и NV12: края ищутся по плану Y,
+// наложение рисуется прямо в планы Y/U/V.
+//
+// Свойства:
+//   frames-processed (guint64, только чтение) - число обработанных кадров
+//   incremental (gboolean) - пересчитывать только изменившиеся области кадра
+//   frames-unchanged (guint64, только чтение) - кадры без изменений, края и контуры взяты готовыми
+//   frames-partial (guint64, только чтение) - кадры, где пересчитаны только изменённые области
+//   analysis-level (gint) - края ищутся в кадре, уменьшенном в 2^level раз, контуры
+//     рисуются на полном кадре; -1 - уровень выбирается по бюджету кадра
+//   analysis-budget (guint64) - бюджет обработки кадра для analysis-level -1, нс; 0 - интервал кадров
+//   current-analysis-level (gint, только чтение) - уровень, на котором найдены контуры последнего кадра
+//   output-blur (gboolean) - размывать полный кадр и на уровнях выше 0, как на уровне 0; это
+//     отдельный проход по всем пикселям, его время входит в бюджет автовыбора уровня
+//   low-threshold, high-threshold (gint) - пороги гистерезиса поиска краёв; меняются на ходу
+//     (оба сразу - cv_filter_set_edge_thresholds), инкрементальная обработка тогда
+//     пересчитывает кадр целиком
+//   stages (gchararray) - стадии обработки через запятую (StageGraph), по умолчанию
+//     "blur,edges,contours,draw,stamp"; меняется на ходу. Другой список обрабатывает
+//     каждый кадр целиком на уровне 0: incremental и analysis-level к нему не применяются,
+//     и если они включены, элемент предупреждает об этом (g_warning)
+
+#define CV_TYPE_FILTER (cv_filter_get_type())
+
+GType cv_filter_get_type(void);
+
+// Регистрирует элемент в процессе; вызывается один раз после gst_init
+bool cv_filter_register();
+
+// Вызывается в потоке конвейера после обработки каждого кадра. Mat ссылается
+// на память буфера и действителен только во время вызова; для I420/NV12
+// передаётся план яркости. Устанавливается
+// до запуска конвейера.
+typedef std::function<void(const cv::Mat &)> CvFilterCallback;
+void cv_filter_set_frame_callback(GstElement *element, CvFilterCallback callback);
+
+// Вызывается в потоке конвейера после каждого кадра с контурами, которые
+// нарисованы на кадре (у пропущенного регулятором кадра - контуры прошлого),
+// PTS буфера и размером кадра. Контуры действительны только во время вызова.
+// Устанавливается до запуска конвейера.
+typedef std::function<void(const FlatContours &, GstClockTime, cv::Size)> CvFilterContoursCallback;
+void cv_filter_set_contours_callback(GstElement *element, CvFilterContoursCallback callback);
+
+// Исполнитель обработки: получает задание обработки кадра и должен выполнить
+// его до возврата (например, WorkerScheduler::run на общем пуле). Без него
+// кадр обрабатывается в потоке конвейера. Устанавливается до запуска конвейера.
+typedef std::function<void(const std::function<void()> &)> CvFilterDispatcher;
+void cv_filter_set_dispatcher(GstElement *element, CvFilterDispatcher dispatcher);
+
+// Регулятор нагрузки решает, какие кадры обрабатывать, и получает время
+// обработки; должен пережить элемент. Устанавливается до запуска конвейера.
+void cv_filter_set_adaptive_controller(GstElement *element, AdaptiveController *controller);
+
+// Оба порога краёв под одной блокировкой объекта: кадр не получает новый
+// нижний порог со старым верхним, как при установке двух свойств по очереди.
+// Из любого потока.
+void cv_filter_set_edge_thresholds(GstElement *element, int low, int high);
+void cv_filter_get_edge_thresholds(GstElement *element, int &low, int &high);
+
+#endif // VIDSTREAM_CV_FILTER_HPP
@@ -0,0 +1,452 @@
+#include "edge_engine.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace cv;
+
+// Ядро Гаусса 5x5, sigma 1.5, в фиксированной точке (сумма 256)
+static const int kGauss0 = 74;
+static const int kGauss1 = 60;
+static const int kGauss2 = 31;
+
+// tg(22.5°) в формате Q15, как в cv::Canny
+static const int kCannyShift = 15;
+static const int kTan22 = 13573;
+
+// Метки карты краёв во время гистерезиса
+static const uchar kNoEdge = 0;
+static const uchar kWeakEdge = 1;
+static const uchar kStrongEdge = 2;
+
+// Промежуточные буферы полосы; живут в потоке и переиспользуются между кадрами
+struct StripScratch {
+    std::vector<ushort> vsum;
+    std::vector<uchar> halo_row;
+    std::vector<uchar> gray;
+    std::vector<short> dx;
+    std::vector<short> dy;
+    std::vector<short> mag;
+    std::vector<short> zero_mag;
+    std::vector<Point> stack;
+    std::vector<unsigned> block_sums;
+};
+
+static StripScratch &strip_scratch() {
+    static thread_local StripScratch scratch;
+    return scratch;
+}
+
+// parallel_for_ с телом по ссылке. Лямбда с захватом по ссылке нескольких
+// переменных не помещается во внутренний буфер std::function, и перегрузка
+// parallel_for_ для std::function выделяла бы память на каждый вызов.
+template <typename Fn>
+class LoopBody : public ParallelLoopBody {
+public:
+    explicit LoopBody(const Fn &fn) : fn_(fn) {}
+    void operator()(const Range &range) const override { fn_(range); }
+
+private:
+    const Fn &fn_;
+};
+
+template <typename Fn>
+static void parallel_for_ref(const Range &range, const Fn &fn) {
+    parallel_for_(range, LoopBody<Fn>(fn));
+}
+
+static inline int reflect101(int i, int n) {
+    if (n == 1) {
+        return 0;
+    }
+    while (i < 0 || i >= n) {
+        if (i < 0) {
+            i = -i;
+        }
+        if (i >= n) {
+            i = 2 * n - 2 - i;
+        }
+    }
+    return i;
+}
+
+// Одна строка размытого кадра: вертикальный проход в 16-битные суммы,
+// затем горизонтальный с отражением на краях (как BORDER_REFLECT_101)
+static void blur_row(const Mat &src, int y, uchar *out, std::vector<ushort> &vsum) {
+    const int rows = src.rows;
+    const int cols = src.cols;
+    const int cn = src.channels();
+    const int width = cols * cn;
+
+    const uchar *r0 = src.ptr<uchar>(reflect101(y - 2, rows));
+    const uchar *r1 = src.ptr<uchar>(reflect101(y - 1, rows));
+    const uchar *r2 = src.ptr<uchar>(y);
+    const uchar *r3 = src.ptr<uchar>(reflect101(y + 1, rows));
+    const uchar *r4 = src.ptr<uchar>(reflect101(y + 2, rows));
+
+    vsum.resize(width);
+    ushort *v = vsum.data();
+    for (int i = 0; i < width; ++i) {
+        v[i] = (ushort)(kGauss2 * (r0[i] + r4[i]) + kGauss1 * (r1[i] + r3[i]) + kGauss0 * r2[i]);
+    }
+
+    for (int x = 0; x < cols; ++x) {
+        int xm2, xm1, xp1, xp2;
+        if (x >= 2 && x + 2 < cols) {
+            xm2 = x - 2;
+            xm1 = x - 1;
+            xp1 = x + 1;
+            xp2 = x + 2;
+        } else {
+            xm2 = reflect101(x - 2, cols);
+            xm1 = reflect101(x - 1, cols);
+            xp1 = reflect101(x + 1, cols);
+            xp2 = reflect101(x + 2, cols);
+        }
+
+        for (int c = 0; c < cn; ++c) {
+            unsigned sum = kGauss2 * (unsigned)(v[xm2 * cn + c] + v[xp2 * cn + c]) +
+                           kGauss1 * (unsigned)(v[xm1 * cn + c] + v[xp1 * cn + c]) +
+                           kGauss0 * (unsigned)v[x * cn + c];
+            out[x * cn + c] = (uchar)((sum + (1u << 15)) >> 16);
+        }
+    }
+}
+
+// Яркость BGR по коэффициентам BT.601 в формате Q14, как в cvtColor
+static void gray_row(const uchar *bgr, int cols, int cn, uchar *gray) {
+    if (cn == 1) {
+        std::copy(bgr, bgr + cols, gray);
+        return;
+    }
+    for (int x = 0; x < cols; ++x) {
+        const uchar *p = bgr + x * cn;
+        gray[x] = (uchar)((p[0] * 1868 + p[1] * 9617 + p[2] * 4899 + (1 << 13)) >> 14);
+    }
+}
+
+// Размытие, яркость, Собель и подавление немаксимумов для строк [y0, y1),
+// затем гистерезис в пределах полосы. Без Blur яркость берётся прямо из
+// src, а blurred не используется: ветвь отсекается при компиляции
+template <bool Blur>
+static void process_strip(const Mat &src, Mat &blurred, Mat &labels, int y0, int y1,
+                          const EdgeParams &params) {
+    StripScratch &s = strip_scratch();
+
+    const int rows = src.rows;
+    const int cols = src.cols;
+    const int cn = src.channels();
+
+    // Строки размытия и яркости с запасом 2 строки, градиента - 1 строка
+    const int b0 = std::max(0, y0 - 2);
+    const int b1 = std::min(rows, y1 + 2);
+    const int g0 = std::max(0, y0 - 1);
+    const int g1 = std::min(rows, y1 + 1);
+
+    s.gray.resize((size_t)(b1 - b0) * cols);
+
+    if (Blur) {
+        s.halo_row.resize(cols * cn);
+        for (int y = b0; y < b1; ++y) {
+            uchar *out = (y >= y0 && y < y1) ? blurred.ptr<uchar>(y) : s.halo_row.data();
+            blur_row(src, y, out, s.vsum);
+            gray_row(out, cols, cn, &s.gray[(size_t)(y - b0) * cols]);
+        }
+    } else {
+        for (int y = b0; y < b1; ++y) {
+            gray_row(src.ptr<uchar>(y), cols, cn, &s.gray[(size_t)(y - b0) * cols]);
+        }
+    }
+
+    // Модуль градиента хранится с нулевой колонкой слева и справа
+    const int mstride = cols + 2;
+    s.dx.resize((size_t)(g1 - g0) * cols);
+    s.dy.resize((size_t)(g1 - g0) * cols);
+    s.mag.assign((size_t)(g1 - g0) * mstride, 0);
+    s.zero_mag.assign(mstride, 0);
+
+    for (int y = g0; y < g1; ++y) {
+        const uchar *t = &s.gray[(size_t)(std::max(y - 1, 0) - b0) * cols];
+        const uchar *m = &s.gray[(size_t)(y - b0) * cols];
+        const uchar *b = &s.gray[(size_t)(std::min(y + 1, rows - 1) - b0) * cols];
+        short *dx = &s.dx[(size_t)(y - g0) * cols];
+        short *dy = &s.dy[(size_t)(y - g0) * cols];
+        short *mag = &s.mag[(size_t)(y - g0) * mstride + 1];
+
+        for (int x = 0; x < cols; ++x) {
+            int xl = x > 0 ? x - 1 : 0;
+            int xr = x < cols - 1 ? x + 1 : cols - 1;
+            int gx = (t[xr] - t[xl]) + 2 * (m[xr] - m[xl]) + (b[xr] - b[xl]);
+            int gy = (b[xl] + 2 * b[x] + b[xr]) - (t[xl] + 2 * t[x] + t[xr]);
+            dx[x] = (short)gx;
+            dy[x] = (short)gy;
+            mag[x] = (short)(std::abs(gx) + std::abs(gy));
+        }
+    }
+
+    const int low = params.low_threshold;
+    const int high = params.high_threshold;
+
+    for (int y = y0; y < y1; ++y) {
+        const short *mag = &s.mag[(size_t)(y - g0) * mstride + 1];
+        const short *mag_p = y > 0 ? &s.mag[(size_t)(y - 1 - g0) * mstride + 1] : &s.zero_mag[1];
+        const short *mag_n = y + 1 < rows ? &s.mag[(size_t)(y + 1 - g0) * mstride + 1] : &s.zero_mag[1];
+        const short *dx = &s.dx[(size_t)(y - g0) * cols];
+        const short *dy = &s.dy[(size_t)(y - g0) * cols];
+        uchar *label = labels.ptr<uchar>(y);
+
+        for (int x = 0; x < cols; ++x) {
+            int m = mag[x];
+            bool is_max = false;
+
+            if (m > low) {
+                int xs = std::abs(dx[x]);
+                int ys = std::abs(dy[x]) << kCannyShift;
+                int tg22x = xs * kTan22;
+
+                if (ys < tg22x) {
+                    is_max = m > mag[x - 1] && m >= mag[x + 1];
+                } else {
+                    int tg67x = tg22x + (xs << (kCannyShift + 1));
+                    if (ys > tg67x) {
+                        is_max = m > mag_p[x] && m >= mag_n[x];
+                    } else {
+                        int sign = (dx[x] ^ dy[x]) < 0 ? -1 : 1;
+                        is_max = m > mag_p[x - sign] && m > mag_n[x + sign];
+                    }
+                }
+            }
+
+            label[x] = !is_max ? kNoEdge : (m > high ? kStrongEdge : kWeakEdge);
+        }
+    }
+
+    // Гистерезис внутри полосы: слабые края, связанные с сильными, становятся сильными
+    s.stack.clear();
+    for (int y = y0; y < y1; ++y) {
+        const uchar *label = labels.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x) {
+            if (label[x] == kStrongEdge) {
+                s.stack.push_back(Point(x, y));
+            }
+        }
+    }
+
+    while (!s.stack.empty()) {
+        Point p = s.stack.back();
+        s.stack.pop_back();
+
+        for (int ny = std::max(p.y - 1, y0); ny <= std::min(p.y + 1, y1 - 1); ++ny) {
+            uchar *label = labels.ptr<uchar>(ny);
+            for (int nx = std::max(p.x - 1, 0); nx <= std::min(p.x + 1, cols - 1); ++nx) {
+                if (label[nx] == kWeakEdge) {
+                    label[nx] = kStrongEdge;
+                    s.stack.push_back(Point(nx, ny));
+                }
+            }
+        }
+    }
+}
+
+// Продолжение гистерезиса через границы полос: слабые пиксели, касающиеся
+// сильных из соседней полосы, становятся затравками общего заполнения
+static void stitch_strips(Mat &labels, int strip_rows) {
+    std::vector<Point> &stack = strip_scratch().stack;
+    const int rows = labels.rows;
+    const int cols = labels.cols;
+
+    stack.clear();
+    for (int yb = strip_rows; yb < rows; yb += strip_rows) {
+        uchar *up = labels.ptr<uchar>(yb - 1);
+        uchar *down = labels.ptr<uchar>(yb);
+
+        for (int x = 0; x < cols; ++x) {
+            for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, cols - 1); ++nx) {
+                if (up[x] == kStrongEdge && down[nx] == kWeakEdge) {
+                    down[nx] = kStrongEdge;
+                    stack.push_back(Point(nx, yb));
+                }
+                if (down[x] == kStrongEdge && up[nx] == kWeakEdge) {
+                    up[nx] = kStrongEdge;
+                    stack.push_back(Point(nx, yb - 1));
+                }
+            }
+        }
+    }
+
+    while (!stack.empty()) {
+        Point p = stack.back();
+        stack.pop_back();
+
+        for (int ny = std::max(p.y - 1, 0); ny <= std::min(p.y + 1, rows - 1); ++ny) {
+            uchar *label = labels.ptr<uchar>(ny);
+            for (int nx = std::max(p.x - 1, 0); nx <= std::min(p.x + 1, cols - 1); ++nx) {
+                if (label[nx] == kWeakEdge) {
+                    label[nx] = kStrongEdge;
+                    stack.push_back(Point(nx, ny));
+                }
+            }
+        }
+    }
+}
+
+// Поиск краёв по полосам; с Blur размытие кадра пишется в blurred
+template <bool Blur>
+static void detect_edges_strips(const Mat &src, Mat &blurred, Mat &edges, const EdgeParams &params) {
+    CV_Assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3 || src.channels() == 4));
+
+    const int rows = src.rows;
+    const int cols = src.cols;
+    const int cn = src.channels();
+
+    // При обработке на месте полосы читают строки соседей, поэтому размытие
+    // пишется во временный кадр потока и копируется в конце
+    bool in_place = Blur && !blurred.empty() && blurred.data == src.data;
+    static thread_local Mat in_place_scratch;
+    Mat target;
+    if (!Blur) {
+        // Размытия нет, полосы не пишут в кадр
+    } else if (in_place) {
+        in_place_scratch.create(rows, cols, src.type());
+        target = in_place_scratch;
+    } else {
+        blurred.create(rows, cols, src.type());
+        target = blurred;
+    }
+
+    edges.create(rows, cols, CV_8UC1);
+
+    // Высота полосы подбирается так, чтобы её рабочий набор помещался в L2:
+    // вход и размытие, яркость, dx/dy/модуль и метки на каждую строку
+    size_t row_bytes = (size_t)cols * ((Blur ? 2 : 1) * cn + 1 + 3 * sizeof(short) + 1);
+    int strip_rows = (int)std::max<size_t>(16, params.strip_bytes / std::max<size_t>(row_bytes, 1));
+    strip_rows = std::min(strip_rows, rows);
+    int strips = (rows + strip_rows - 1) / strip_rows;
+
+    {
+        // Размытие, Собель, подавление немаксимумов и гистерезис внутри полос
+        TRACE_SPAN(Blur ? "edges.strips" : "edges.strips_sharp");
+        parallel_for_ref(Range(0, strips), [&](const Range &range) {
+            for (int i = range.start; i < range.end; ++i) {
+                int y0 = i * strip_rows;
+                int y1 = std::min(rows, y0 + strip_rows);
+                process_strip<Blur>(src, target, edges, y0, y1, params);
+            }
+        });
+    }
+
+    if (strips > 1) {
+        TRACE_SPAN("edges.stitch");
+        stitch_strips(edges, strip_rows);
+    }
+
+    parallel_for_ref(Range(0, strips), [&](const Range &range) {
+        for (int y = range.start * strip_rows; y < std::min(rows, range.end * strip_rows); ++y) {
+            uchar *label = edges.ptr<uchar>(y);
+            for (int x = 0; x < cols; ++x) {
+                label[x] = label[x] == kStrongEdge ? 255 : 0;
+            }
+        }
+    });
+
+    if (in_place) {
+        target.copyTo(blurred);
+    }
+}
+
+void detect_edges(const Mat &src, Mat &blurred, Mat &edges, const EdgeParams &params) {
+    TRACE_SPAN("detect_edges");
+    detect_edges_strips<true>(src, blurred, edges, params);
+}
+
+void detect_edges_sharp(const Mat &src, Mat &edges, const EdgeParams &params) {
+    TRACE_SPAN("detect_edges.sharp");
+    Mat unused;
+    detect_edges_strips<false>(src, unused, edges, params);
+}
+
+// Порог яркости строк [y0, y1) для Cn каналов: число каналов известно при
+// компиляции, внутренний цикл без ветвлений по формату
+template <int Cn>
+static void threshold_rows(const Mat &src, Mat &binary, int threshold, int y0, int y1) {
+    for (int y = y0; y < y1; ++y) {
+        const uchar *p = src.ptr<uchar>(y);
+        uchar *out = binary.ptr<uchar>(y);
+        for (int x = 0; x < src.cols; ++x, p += Cn) {
+            int gray = Cn == 1 ? p[0] : (p[0] * 1868 + p[1] * 9617 + p[2] * 4899 + (1 << 13)) >> 14;
+            out[x] = gray > threshold ? 255 : 0;
+        }
+    }
+}
+
+void threshold_luma(const Mat &src, Mat &binary, int threshold) {
+    TRACE_SPAN("threshold_luma");
+
+    CV_Assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3 || src.channels() == 4));
+
+    binary.create(src.rows, src.cols, CV_8UC1);
+    const int cn = src.channels();
+    parallel_for_ref(Range(0, src.rows), [&](const Range &range) {
+        if (cn == 1) {
+            threshold_rows<1>(src, binary, threshold, range.start, range.end);
+        } else if (cn == 3) {
+            threshold_rows<3>(src, binary, threshold, range.start, range.end);
+        } else {
+            threshold_rows<4>(src, binary, threshold, range.start, range.end);
+        }
+    });
+}
+
+void downsample_luma(const Mat &src, Mat &dst, int level) {
+    TRACE_SPAN("downsample");
+
+    CV_Assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3 || src.channels() == 4));
+    CV_Assert(level >= 1 && level <= kMaxDownsampleLevel);
+
+    const int block = 1 << level;
+    const int rows = src.rows >> level;
+    const int cols = src.cols >> level;
+    const int cn = src.channels();
+    // Сумма блока делится на его площадь сдвигом; для цвета деление
+    // совмещено с коэффициентами яркости Q14 (сумма не превышает 2^32)
+    const int area_shift = 2 * level;
+
+    dst.create(rows, cols, CV_8UC1);
+
+    parallel_for_ref(Range(0, rows), [&](const Range &range) {
+        std::vector<unsigned> &sums = strip_scratch().block_sums;
+        sums.resize((size_t)cols * cn);
+
+        for (int y = range.start; y < range.end; ++y) {
+            std::fill(sums.begin(), sums.end(), 0u);
+            for (int k = 0; k < block; ++k) {
+                const uchar *row = src.ptr<uchar>(y * block + k);
+                for (int x = 0; x < cols; ++x) {
+                    const uchar *p = row + (size_t)x * block * cn;
+                    unsigned *sum = &sums[(size_t)x * cn];
+                    for (int j = 0; j < block; ++j, p += cn) {
+                        for (int c = 0; c < cn; ++c) {
+                            sum[c] += p[c];
+                        }
+                    }
+                }
+            }
+
+            uchar *out = dst.ptr<uchar>(y);
+            if (cn == 1) {
+                const unsigned round = (1u << area_shift) >> 1;
+                for (int x = 0; x < cols; ++x) {
+                    out[x] = (uchar)((sums[x] + round) >> area_shift);
+                }
+            } else {
+                const int shift = 14 + area_shift;
+                for (int x = 0; x < cols; ++x) {
+                    const unsigned *sum = &sums[(size_t)x * cn];
+                    out[x] = (uchar)((sum[0] * 1868 + sum[1] * 9617 + sum[2] * 4899 + (1u << (shift - 1))) >> shift);
+                }
+            }
+        }
+    });
+}
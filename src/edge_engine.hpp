@@ -0,0 +1,59 @@
+#ifndef VIDSTREAM_EDGE_ENGINE_HPP
+#define VIDSTREAM_EDGE_ENGINE_HPP
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+
+struct EdgeParams {
+    int low_threshold = 100;
+    int high_threshold = 200;
+    // Бюджет рабочего набора одной полосы; по нему выбирается высота полосы
+    size_t strip_bytes = 256 * 1024;
+};
+
+// Слитый детектор краёв: размытие Гаусса 5x5 (sigma 1.5), перевод в яркость,
+// градиенты Собеля (L1) и подавление немаксимумов выполняются за один проход
+// по горизонтальным полосам с перекрытием, полосы обрабатываются параллельно.
+// Гистерезис выполняется внутри полос и затем сшивается на их границах.
+//
+// src     - CV_8UC1, CV_8UC3 (BGR) или CV_8UC4 (BGRA)
+// blurred - размытый кадр того же типа; может совпадать с src
+// edges   - CV_8UC1, края 255, фон 0
+//
+// Точность: размытие совпадает с GaussianBlur(5x5, 1.5) с точностью до 1 уровня
+// из-за округления коэффициентов. Для одноканального входа карта краёв совпадает
+// с Canny(blurred, 100, 200) с точностью до пикселей на пороге. Для цветного
+// входа края ищутся по яркости размытого кадра, а cv::Canny берёт канал с
+// наибольшим градиентом, поэтому края, видимые только в цветности, могут
+// отсутствовать; на краях с перепадом яркости не менее 80 уровней не менее 90%
+// пикселей краёв Canny имеют край не дальше 1 пикселя.
+void detect_edges(const cv::Mat &src, cv::Mat &blurred, cv::Mat &edges,
+                  const EdgeParams &params = EdgeParams());
+
+// То же без размытия: Собель по яркости src как есть, кадр не меняется.
+// Совпадает с Canny(src, low, high) с той же оговоркой про цветной вход
+void detect_edges_sharp(const cv::Mat &src, cv::Mat &edges, const EdgeParams &params = EdgeParams());
+
+// Яркость BT.601 и порог за один параллельный проход, без отдельного кадра
+// яркости: binary - CV_8UC1, 255 где яркость выше threshold, иначе 0
+void threshold_luma(const cv::Mat &src, cv::Mat &binary, int threshold);
+
+// Порог выше наибольшей L1-нормы градиента Собеля 3x3 по 8-битной яркости
+// (2 * 4 * 255) уже не находит краёв
+static const int kMaxEdgeThreshold = 2040;
+
+// Наибольший уровень уменьшения downsample_luma: 1/8 стороны кадра
+static const int kMaxDownsampleLevel = 3;
+
+// Уменьшение кадра в 2^level раз по каждой стороне усреднением блоков
+// (как resize INTER_AREA при целом коэффициенте) сразу в яркость BT.601:
+// один проход по входу, строки выхода считаются параллельно. Неполные
+// блоки у правого и нижнего края отбрасываются.
+//
+// src   - CV_8UC1, CV_8UC3 (BGR) или CV_8UC4 (BGRA)
+// dst   - CV_8UC1, (src.cols >> level) x (src.rows >> level)
+// level - 1..kMaxDownsampleLevel
+void downsample_luma(const cv::Mat &src, cv::Mat &dst, int level);
+
+#endif // VIDSTREAM_EDGE_ENGINE_HPP
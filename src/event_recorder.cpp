@@ -0,0 +1,389 @@
+#include "event_recorder.hpp"
+#include "pipeline_util.hpp"
+
+#include <gst/app/gstappsrc.h>
+
+#include <ctime>
+#include <iostream>
+
+EventRecorder::Recording::~Recording() {
+    for (GstBuffer *buffer : buffers) {
+        gst_buffer_unref(buffer);
+    }
+    if (caps) {
+        gst_caps_unref(caps);
+    }
+}
+
+EventRecorder::EventRecorder(const std::string &name, const RecorderConfig &config)
+    : name_(name),
+      config_(config),
+      ring_bytes_(0),
+      caps_(nullptr),
+      last_pts_(GST_CLOCK_TIME_NONE),
+      path_count_(0),
+      running_(false),
+      buffered_bytes_(0),
+      recordings_(0),
+      failed_(0) {}
+
+EventRecorder::~EventRecorder() {
+    stop();
+    release_ring();
+    if (caps_) {
+        gst_caps_unref(caps_);
+    }
+}
+
+bool EventRecorder::attach(GstElement *encoder, const char *pad_name) {
+    GstPad *pad = gst_element_get_static_pad(encoder, pad_name);
+    if (!pad) {
+        std::cerr << "EventRecorder: у элемента нет пада " << pad_name << std::endl;
+        return false;
+    }
+    gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                      on_pad_probe, this, NULL);
+    gst_object_unref(pad);
+    return true;
+}
+
+GstPadProbeReturn EventRecorder::on_pad_probe(GstPad *, GstPadProbeInfo *info, gpointer data) {
+    EventRecorder *recorder = static_cast<EventRecorder *>(data);
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        recorder->push(GST_PAD_PROBE_INFO_BUFFER(info));
+    } else if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            GstCaps *caps = NULL;
+            gst_event_parse_caps(event, &caps);
+            recorder->set_caps(caps);
+        }
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+void EventRecorder::set_caps(GstCaps *caps) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (caps_ && gst_caps_is_equal(caps_, caps)) {
+        return;
+    }
+
+    // Кадры в другом формате не склеиваются с прежними в одном файле
+    if (active_) {
+        finish_active();
+    }
+    release_ring();
+    if (caps_) {
+        gst_caps_unref(caps_);
+    }
+    caps_ = gst_caps_ref(caps);
+}
+
+void EventRecorder::push(GstBuffer *buffer) {
+    const bool keyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    const GstClockTime pts = GST_BUFFER_PTS(buffer);
+    const size_t size = gst_buffer_get_size(buffer);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (GST_CLOCK_TIME_IS_VALID(pts)) {
+        last_pts_ = pts;
+    }
+
+    // Запись сверх предела продолжается в новом файле с этого ключевого кадра
+    if (active_ && keyframe && !active_->buffers.empty() && over_limit(pts)) {
+        split_active();
+    }
+
+    // Запись без предзаписи начинается со следующего ключевого кадра
+    if (active_ && (keyframe || !active_->buffers.empty())) {
+        active_->buffers.push_back(gst_buffer_ref(buffer));
+        active_->bytes += size;
+        if (!GST_CLOCK_TIME_IS_VALID(active_->start)) {
+            active_->start = pts;
+        }
+        if (!GST_CLOCK_TIME_IS_VALID(active_->end) && GST_CLOCK_TIME_IS_VALID(pts)) {
+            active_->end = pts + (GstClockTime)(config_.postroll * GST_SECOND);
+        }
+        if (GST_CLOCK_TIME_IS_VALID(pts) && GST_CLOCK_TIME_IS_VALID(active_->end) && pts >= active_->end) {
+            finish_active();
+        }
+    }
+
+    if (keyframe) {
+        ring_.emplace_back();
+        ring_.back().start = pts;
+    }
+    // До первого ключевого кадра кольцо пустое
+    if (!ring_.empty()) {
+        Gop &gop = ring_.back();
+        gop.buffers.push_back(gst_buffer_ref(buffer));
+        gop.bytes += size;
+        ring_bytes_ += size;
+        trim();
+    }
+    buffered_bytes_.store(ring_bytes_, std::memory_order_relaxed);
+}
+
+// Вытесняет первую группу, пока остальные покрывают preroll или кольцо
+// не помещается в бюджет
+void EventRecorder::trim() {
+    const GstClockTime preroll = (GstClockTime)(config_.preroll * GST_SECOND);
+    while (!ring_.empty()) {
+        bool over_budget = ring_bytes_ > config_.budget_bytes;
+        bool covered = ring_.size() > 1 && GST_CLOCK_TIME_IS_VALID(ring_[1].start) &&
+                       GST_CLOCK_TIME_IS_VALID(last_pts_) && last_pts_ >= ring_[1].start &&
+                       last_pts_ - ring_[1].start >= preroll;
+        if (!over_budget && !covered) {
+            break;
+        }
+
+        Gop &front = ring_.front();
+        for (GstBuffer *buffer : front.buffers) {
+            gst_buffer_unref(buffer);
+        }
+        ring_bytes_ -= front.bytes;
+        ring_.pop_front();
+    }
+}
+
+void EventRecorder::release_ring() {
+    for (Gop &gop : ring_) {
+        for (GstBuffer *buffer : gop.buffers) {
+            gst_buffer_unref(buffer);
+        }
+    }
+    ring_.clear();
+    ring_bytes_ = 0;
+    buffered_bytes_.store(0, std::memory_order_relaxed);
+}
+
+void EventRecorder::finish_active() {
+    pending_.push_back(std::move(active_));
+    wake_.notify_one();
+}
+
+bool EventRecorder::over_limit(GstClockTime pts) const {
+    const GstClockTime max_duration = (GstClockTime)(config_.max_duration * GST_SECOND);
+    return active_->bytes >= config_.max_bytes ||
+           (GST_CLOCK_TIME_IS_VALID(active_->start) && GST_CLOCK_TIME_IS_VALID(pts) && pts >= active_->start &&
+            pts - active_->start >= max_duration);
+}
+
+// Завершает запись и начинает новую с тем же концом послезаписи; если
+// очередь на диск заполнена, запись на этом заканчивается
+void EventRecorder::split_active() {
+    std::unique_ptr<Recording> next(new Recording());
+    next->caps = active_->caps ? gst_caps_ref(active_->caps) : nullptr;
+    next->end = active_->end;
+    next->reasons = active_->reasons;
+    finish_active();
+
+    if (pending_.size() >= config_.max_pending) {
+        std::cerr << name_ << ": запись (" << next->reasons << ") прервана, очередь записи заполнена" << std::endl;
+        return;
+    }
+    next->path = next_path();
+    active_ = std::move(next);
+    std::cout << name_ << ": запись продолжается в " << active_->path << std::endl;
+}
+
+bool EventRecorder::trigger(const std::string &reason) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        return false;
+    }
+
+    const GstClockTime postroll = (GstClockTime)(config_.postroll * GST_SECOND);
+    if (active_) {
+        if (GST_CLOCK_TIME_IS_VALID(last_pts_)) {
+            active_->end = last_pts_ + postroll;
+        }
+        active_->reasons += ", " + reason;
+        return true;
+    }
+    if (pending_.size() >= config_.max_pending) {
+        std::cerr << name_ << ": событие (" << reason << ") пропущено, очередь записи заполнена" << std::endl;
+        return false;
+    }
+
+    // Предзапись - ссылки на буферы кольца; кольцо продолжает вытесняться независимо
+    active_.reset(new Recording());
+    active_->caps = caps_ ? gst_caps_ref(caps_) : nullptr;
+    for (const Gop &gop : ring_) {
+        for (GstBuffer *buffer : gop.buffers) {
+            active_->buffers.push_back(gst_buffer_ref(buffer));
+        }
+        active_->bytes += gop.bytes;
+    }
+    if (!ring_.empty()) {
+        active_->start = ring_.front().start;
+    }
+    active_->end = GST_CLOCK_TIME_IS_VALID(last_pts_) ? last_pts_ + postroll : GST_CLOCK_TIME_NONE;
+    active_->path = next_path();
+    active_->reasons = reason;
+
+    std::cout << name_ << ": событие (" << reason << "), запись в " << active_->path << std::endl;
+    return true;
+}
+
+void EventRecorder::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&EventRecorder::write_loop, this);
+}
+
+void EventRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        if (active_) {
+            finish_active();
+        }
+        running_ = false;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+void EventRecorder::write_loop() {
+    for (;;) {
+        std::unique_ptr<Recording> recording;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return !running_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return;
+            }
+            recording = std::move(pending_.front());
+            pending_.pop_front();
+        }
+
+        if (write(*recording)) {
+            recordings_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool EventRecorder::write(Recording &recording) {
+    if (recording.buffers.empty() || !recording.caps) {
+        std::cerr << name_ << ": нет кадров для записи " << recording.path << std::endl;
+        return false;
+    }
+
+    // h264parse приводит поток к виду, который принимает контейнер
+    std::string description = "appsrc name=source format=time is-live=false block=true ! h264parse ! ";
+    description += config_.container == "mkv" ? "matroskamux" : "mp4mux";
+    description += " ! filesink name=file";
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description.c_str(), &error);
+    if (error) {
+        std::cerr << name_ << ": ошибка конвейера записи: " << error->message << std::endl;
+        g_error_free(error);
+        if (pipeline) {
+            gst_object_unref(pipeline);
+        }
+        return false;
+    }
+
+    GstElement *appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "source");
+    GstElement *filesink = gst_bin_get_by_name(GST_BIN(pipeline), "file");
+    g_object_set(G_OBJECT(appsrc), "caps", recording.caps, NULL);
+    g_object_set(G_OBJECT(filesink), "location", recording.path.c_str(), NULL);
+    gst_object_unref(filesink);
+
+    bool ok = gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE;
+
+    // Файл начинается с нулевого времени; DTS первого кадра не больше его PTS
+    GstBuffer *first = recording.buffers.front();
+    GstClockTime offset = GST_BUFFER_DTS_IS_VALID(first) ? GST_BUFFER_DTS(first)
+                        : GST_BUFFER_PTS_IS_VALID(first) ? GST_BUFFER_PTS(first) : 0;
+    for (size_t i = 0; ok && i < recording.buffers.size(); ++i) {
+        // Копия только метаданных: память кадра общая с буфером кодера
+        GstBuffer *buffer = gst_buffer_copy(recording.buffers[i]);
+        if (GST_BUFFER_PTS_IS_VALID(buffer)) {
+            GST_BUFFER_PTS(buffer) = GST_BUFFER_PTS(buffer) > offset ? GST_BUFFER_PTS(buffer) - offset : 0;
+        }
+        if (GST_BUFFER_DTS_IS_VALID(buffer)) {
+            GST_BUFFER_DTS(buffer) = GST_BUFFER_DTS(buffer) > offset ? GST_BUFFER_DTS(buffer) - offset : 0;
+        }
+        // appsrc забирает ссылку на буфер
+        ok = gst_app_src_push_buffer(GST_APP_SRC(appsrc), buffer) == GST_FLOW_OK;
+    }
+
+    if (ok) {
+        gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
+        ok = wait_for_eos(pipeline, recording.path);
+    }
+    gst_object_unref(appsrc);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    if (ok) {
+        std::cout << name_ << ": записано кадров " << recording.buffers.size() << " (" << recording.reasons
+                  << ") в " << recording.path << std::endl;
+    } else {
+        std::cerr << name_ << ": не удалось записать " << recording.path << std::endl;
+    }
+    return ok;
+}
+
+std::string EventRecorder::next_path() {
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+    // Несколько событий в одну секунду получают номера. Файл появляется
+    // только при записи на диск, поэтому имя резервируется счётчиком уже при
+    // постановке записи; проверка файла - от записей прошлых запусков
+    if (path_stamp_ != stamp) {
+        path_stamp_ = stamp;
+        path_count_ = 0;
+    }
+    std::string base = name_ + "-" + stamp;
+    for (;;) {
+        int n = ++path_count_;
+        std::string file = (n == 1 ? base : base + "-" + std::to_string(n)) + "." + config_.container;
+        gchar *path = g_build_filename(config_.directory.c_str(), file.c_str(), NULL);
+        std::string result = path;
+        g_free(path);
+        if (!g_file_test(result.c_str(), G_FILE_TEST_EXISTS)) {
+            return result;
+        }
+    }
+}
+
+// Средние по первым кадрам ещё не устоялись
+static const int kSpikeWarmupFrames = 30;
+static const double kSpikeAverageWeight = 0.05;
+
+ContourSpikeTrigger::ContourSpikeTrigger(double ratio, size_t min_contours, int hold_frames)
+    : ratio_(ratio), min_contours_(min_contours), hold_frames_(hold_frames), average_(0), frames_(0), hold_(0) {}
+
+bool ContourSpikeTrigger::observe(size_t contours) {
+    bool spike = frames_ >= kSpikeWarmupFrames && hold_ == 0 && contours >= min_contours_ &&
+                 contours > ratio_ * average_;
+    if (hold_ > 0) {
+        --hold_;
+    }
+    if (spike) {
+        hold_ = hold_frames_;
+    }
+
+    average_ = frames_ == 0 ? (double)contours : average_ + kSpikeAverageWeight * (contours - average_);
+    if (frames_ < kSpikeWarmupFrames) {
+        ++frames_;
+    }
+    return spike;
+}
@@ -0,0 +1,144 @@
+#ifndef VIDSTREAM_EVENT_RECORDER_HPP
+#define VIDSTREAM_EVENT_RECORDER_HPP
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct RecorderConfig {
+    std::string directory = ".";
+    std::string container = "mp4";      // mp4 или mkv
+    double preroll = 10;                // с до события
+    double postroll = 5;                // с после последнего события
+    size_t budget_bytes = 64 << 20;     // предел памяти кольца до события
+    size_t max_pending = 4;             // записей в очереди на диск; сверх - события пропускаются
+    double max_duration = 300;          // с в одном файле записи
+    size_t max_bytes = 256 << 20;       // байт в одном файле записи
+};
+
+// Запись событий из закодированного потока. Пад-проба на выходе x264enc
+// держит в памяти последние preroll секунд H.264 - ссылки на те же буферы,
+// что уходят в rtph264pay, без копирования. Кольцо состоит из групп кадров
+// от ключевого кадра и вытесняется целыми группами, поэтому запись всегда
+// начинается с ключевого кадра; память кольца не превышает budget_bytes
+// (если не помещается даже одна группа, кольцо ждёт следующего ключевого кадра).
+//
+// trigger() берёт кольцо как предзапись и продолжает копить кадры ещё
+// postroll секунд по PTS; повторное событие за это время продлевает запись.
+// Запись длиннее max_duration или больше max_bytes завершается на следующем
+// ключевом кадре, и с него начинается новая запись в другой файл, поэтому
+// частые события не копят в памяти одну бесконечную запись.
+// Готовая запись уходит в отдельный поток, который пишет её через
+// "appsrc ! h264parse ! mp4mux|matroskamux ! filesink" в
+// <directory>/<поток>-<дата>-<время>.<container>. Поток кодера на время
+// записи не останавливается: проба только берёт ссылку на буфер.
+class EventRecorder {
+public:
+    EventRecorder(const std::string &name, const RecorderConfig &config);
+    ~EventRecorder();
+
+    EventRecorder(const EventRecorder &) = delete;
+    EventRecorder &operator=(const EventRecorder &) = delete;
+
+    // Закодированные кадры с пада pad_name (src у x264enc); запись должна
+    // пережить конвейер
+    bool attach(GstElement *encoder, const char *pad_name);
+
+    // Закодированный кадр в кольцо и в начатую запись; вызывается пробой
+    // attach(), берёт свою ссылку на буфер
+    void push(GstBuffer *buffer);
+
+    // Из любого потока; false - событие пропущено (очередь записи полна)
+    bool trigger(const std::string &reason);
+
+    void start();
+    // Дописывает начатую запись тем, что есть, и ждёт записи очереди на диск
+    void stop();
+
+    uint64_t buffered_bytes() const { return buffered_bytes_.load(std::memory_order_relaxed); }
+    uint64_t recordings() const { return recordings_.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    // Группа кадров от ключевого кадра
+    struct Gop {
+        std::vector<GstBuffer *> buffers;
+        size_t bytes = 0;
+        GstClockTime start = GST_CLOCK_TIME_NONE;
+    };
+
+    struct Recording {
+        std::vector<GstBuffer *> buffers;
+        GstCaps *caps = nullptr;
+        GstClockTime start = GST_CLOCK_TIME_NONE;  // PTS первого кадра
+        GstClockTime end = GST_CLOCK_TIME_NONE;  // PTS конца послезаписи
+        size_t bytes = 0;
+        std::string path;
+        std::string reasons;
+
+        ~Recording();
+    };
+
+    static GstPadProbeReturn on_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    void set_caps(GstCaps *caps);
+    void trim();
+    void release_ring();
+    void finish_active();  // под mutex_
+    bool over_limit(GstClockTime pts) const;  // под mutex_
+    void split_active();  // под mutex_
+    void write_loop();
+    bool write(Recording &recording);
+    std::string next_path();  // под mutex_
+
+    std::string name_;
+    RecorderConfig config_;
+
+    std::mutex mutex_;
+    std::deque<Gop> ring_;
+    size_t ring_bytes_;
+    GstCaps *caps_;
+    GstClockTime last_pts_;
+    std::unique_ptr<Recording> active_;
+    std::deque<std::unique_ptr<Recording>> pending_;
+    std::string path_stamp_;  // секунда последнего имени записи и номер в ней
+    int path_count_;
+    std::condition_variable wake_;
+    bool running_;
+    std::thread thread_;
+
+    std::atomic<uint64_t> buffered_bytes_;
+    std::atomic<uint64_t> recordings_;
+    std::atomic<uint64_t> failed_;
+};
+
+// Событие по числу контуров кадра: всплеск относительно скользящего среднего
+class ContourSpikeTrigger {
+public:
+    // ratio - во сколько раз число контуров выше среднего; min_contours -
+    // не меньше скольких; hold_frames - кадров без событий после события
+    ContourSpikeTrigger(double ratio, size_t min_contours = 8, int hold_frames = 150);
+
+    // По кадру за вызов; true - всплеск
+    bool observe(size_t contours);
+
+    double average() const { return average_; }
+
+private:
+    double ratio_;
+    size_t min_contours_;
+    int hold_frames_;
+    double average_;
+    int frames_;
+    int hold_;
+};
+
+#endif // VIDSTREAM_EVENT_RECORDER_HPP
@@ -0,0 +1,185 @@
+#include "flat_contours.hpp"
+#include "instrumentation.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace cv;
+
+Rect FlatContours::bounding_rect(size_t i) const {
+    const Point *points = contour(i);
+    int count = length(i);
+    if (count == 0) {
+        return Rect();
+    }
+
+    int x0 = points[0].x, x1 = points[0].x, y0 = points[0].y, y1 = points[0].y;
+    for (int k = 1; k < count; ++k) {
+        x0 = std::min(x0, points[k].x);
+        x1 = std::max(x1, points[k].x);
+        y0 = std::min(y0, points[k].y);
+        y1 = std::max(y1, points[k].y);
+    }
+    return Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+void FlatContours::append(const FlatContours &other, size_t i) {
+    const Point *points = other.contour(i);
+    points_.insert(points_.end(), points, points + other.length(i));
+    end_contour();
+}
+
+void FlatContours::assign_scaled(const FlatContours &other, int shift) {
+    const int center = (1 << shift) >> 1;
+    points_.resize(other.points_.size());
+    for (size_t k = 0; k < points_.size(); ++k) {
+        points_[k] = Point((other.points_[k].x << shift) + center, (other.points_[k].y << shift) + center);
+    }
+    offsets_ = other.offsets_;
+}
+
+// Шаги цепного кода по направлениям 0..7 (против часовой стрелки от оси x)
+static const Point kCodeDeltas[8] = {
+    Point(1, 0), Point(1, -1), Point(0, -1), Point(-1, -1),
+    Point(-1, 0), Point(-1, 1), Point(0, 1), Point(1, 1)
+};
+
+// Метка пройденной границы; со знаковым битом - пиксель, у которого справа фон
+static const schar kBorder = 2;
+static const schar kRightBorder = (schar)(kBorder | -128);
+
+// Обход внешней границы от пикселя start (как icvFetchContour в OpenCV):
+// точки пишутся только при смене направления (CHAIN_APPROX_SIMPLE),
+// пиксели границы помечаются, чтобы сканирование не начинало с них новый контур
+static void trace_outer_border(schar *start, const int *deltas, Point point, FlatContours &contours) {
+    int s = 4, s_end = 4;
+    schar *next = start;
+
+    // Первый ненулевой сосед по часовой стрелке от направления 4
+    do {
+        s = (s - 1) & 7;
+        next = start + deltas[s];
+    } while (*next == 0 && s != s_end);
+
+    if (s == s_end) {
+        // Одиночный пиксель
+        *start = kRightBorder;
+        contours.add_point(point);
+        contours.end_contour();
+        return;
+    }
+
+    schar *current = start;
+    schar *following = start;
+    int prev_s = s ^ 4;
+    for (;;) {
+        // Следующий ненулевой сосед против часовой стрелки
+        s_end = s;
+        while (s < 15) {
+            following = current + deltas[++s];
+            if (*following != 0) {
+                break;
+            }
+        }
+        s &= 7;
+
+        if ((unsigned)(s - 1) < (unsigned)s_end) {
+            *current = kRightBorder;
+        } else if (*current == 1) {
+            *current = kBorder;
+        }
+
+        if (s != prev_s) {
+            contours.add_point(point);
+            prev_s = s;
+        }
+        point += kCodeDeltas[s];
+
+        if (following == start && current == next) {
+            break;
+        }
+        current = following;
+        s = (s + 4) & 7;
+    }
+    contours.end_contour();
+}
+
+void find_external_contours(const Mat &binary, Mat &labels, FlatContours &contours, Point offset) {
+    TRACE_SPAN("findContours");
+
+    CV_Assert(binary.type() == CV_8UC1);
+    contours.clear();
+
+    const int rows = binary.rows;
+    const int cols = binary.cols;
+
+    // Разметка 0/1 с рамкой фона в 1 пиксель: обход не выходит за буфер
+    labels.create(rows + 2, cols + 2, CV_8SC1);
+    std::memset(labels.ptr<schar>(0), 0, cols + 2);
+    std::memset(labels.ptr<schar>(rows + 1), 0, cols + 2);
+    for (int y = 0; y < rows; ++y) {
+        const uchar *src = binary.ptr<uchar>(y);
+        schar *dst = labels.ptr<schar>(y + 1);
+        dst[0] = 0;
+        for (int x = 0; x < cols; ++x) {
+            dst[x + 1] = src[x] != 0;
+        }
+        dst[cols + 1] = 0;
+    }
+
+    const int step = (int)labels.step;
+    const int deltas[16] = {
+        1, -step + 1, -step, -step - 1, -1, step - 1, step, step + 1,
+        1, -step + 1, -step, -step - 1, -1, step - 1, step, step + 1
+    };
+
+    for (int y = 1; y <= rows; ++y) {
+        schar *row = labels.ptr<schar>(y);
+        // Последняя встреченная граница в строке: внешний контур, начатый
+        // после внешней границы, лежит внутри другого и пропускается
+        int last_border = 0;
+        int prev = 0;
+
+        for (int x = 1; x <= cols; ++x) {
+            int p = row[x];
+            if (p == prev) {
+                continue;
+            }
+
+            if (prev == 0 && p == 1) {
+                if (row[last_border] <= 0) {
+                    trace_outer_border(row + x, deltas, Point(x - 1, y - 1) + offset, contours);
+                    // Сканирование продолжается за стартовым пикселем с его новой меткой
+                    prev = row[x];
+                    continue;
+                }
+            } else if (p == 0 && prev >= 1) {
+                // Начало дыры: её контур в RETR_EXTERNAL не нужен
+                if (prev & -2) {
+                    last_border = x - 1;
+                }
+            }
+
+            prev = p;
+            if (prev & -2) {
+                last_border = x;
+            }
+        }
+    }
+}
+
+void draw_flat_contours(Mat &image, const FlatContours &contours, const Scalar &color,
+                        int thickness, int scale_shift) {
+    for (size_t i = 0; i < contours.size(); ++i) {
+        const Point *points = contours.contour(i);
+        int count = contours.length(i);
+        Point prev(points[count - 1].x >> scale_shift, points[count - 1].y >> scale_shift);
+        for (int k = 0; k < count; ++k) {
+            Point current(points[k].x >> scale_shift, points[k].y >> scale_shift);
+            line(image, prev, current, color, thickness);
+            prev = current;
+        }
+    }
+}
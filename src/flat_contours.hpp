@@ -0,0 +1,74 @@
+#ifndef VIDSTREAM_FLAT_CONTOURS_HPP
+#define VIDSTREAM_FLAT_CONTOURS_HPP
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Контуры кадра в плоском виде: точки всех контуров подряд в одном буфере и
+// индекс смещений начала каждого контура. clear() сохраняет ёмкость обоих
+// буферов, поэтому при повторном заполнении, в отличие от
+// vector<vector<Point>> с отдельным выделением на каждый контур, память
+// выделяется только пока буферы растут до рабочего размера. Пустой набор
+// (в том числе созданный по умолчанию и перемещённый) памяти не держит.
+class FlatContours {
+public:
+    void clear() {
+        points_.clear();
+        offsets_.clear();
+    }
+
+    size_t size() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+    bool empty() const { return size() == 0; }
+
+    const cv::Point *contour(size_t i) const { return points_.data() + offsets_[i]; }
+    int length(size_t i) const { return offsets_[i + 1] - offsets_[i]; }
+    cv::Rect bounding_rect(size_t i) const;
+
+    // Контур набирается точками и закрывается end_contour()
+    void add_point(cv::Point point) { points_.push_back(point); }
+    void end_contour() {
+        if (offsets_.empty()) {
+            offsets_.push_back(0);
+        }
+        offsets_.push_back((int)points_.size());
+    }
+
+    // Копия контура i другого набора
+    void append(const FlatContours &other, size_t i);
+
+    // Копия всех контуров other с координатами, умноженными на 2^shift:
+    // точка уменьшенного кадра переходит в центр своего блока 2^shift x 2^shift
+    void assign_scaled(const FlatContours &other, int shift);
+
+    void swap(FlatContours &other) {
+        points_.swap(other.points_);
+        offsets_.swap(other.offsets_);
+    }
+
+    const std::vector<cv::Point> &points() const { return points_; }
+
+private:
+    std::vector<cv::Point> points_;
+    std::vector<int> offsets_;  // size() + 1 смещений, первое равно 0; пуст без контуров
+};
+
+// Внешние контуры двоичного изображения (ненулевые пиксели - объект):
+// те же контуры и точки, что у findContours(RETR_EXTERNAL, CHAIN_APPROX_SIMPLE)
+// (та же трассировка границ Suzuki-Abe), но в порядке обхода сверху вниз,
+// а findContours отдаёт их в обратном. Вместо копии изображения и цепочек
+// CvSeq используется переиспользуемая разметка labels.
+//
+// binary - CV_8UC1; labels - рабочий буфер (пересоздаётся только при смене
+// размера); offset прибавляется к координатам точек.
+void find_external_contours(const cv::Mat &binary, cv::Mat &labels, FlatContours &contours,
+                            cv::Point offset = cv::Point());
+
+// Замкнутые ломаные контуров отрезками cv::line. drawContours и polylines
+// заводят буфер точек на каждый контур. Координаты делятся на 2^scale_shift:
+// так контуры плана яркости рисуются в планах цветности половинного разрешения.
+void draw_flat_contours(cv::Mat &image, const FlatContours &contours, const cv::Scalar &color,
+                        int thickness, int scale_shift = 0);
+
+#endif // VIDSTREAM_FLAT_CONTOURS_HPP
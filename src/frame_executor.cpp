@@ -0,0 +1,504 @@
+#include "frame_executor.hpp"
+#include "adaptive_controller.hpp"
+#include "gst_convert.hpp"
+#include "instrumentation.hpp"
+#include "latency_probe.hpp"
+#include "processing.hpp"
+
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#include <chrono>
+#include <iostream>
+
+using namespace cv;
+
+bool parse_drop_policy(const std::string &name, DropPolicy &policy) {
+    if (name == "drop-oldest") {
+        policy = DropPolicy::DropOldest;
+    } else if (name == "drop-newest") {
+        policy = DropPolicy::DropNewest;
+    } else if (name == "block") {
+        policy = DropPolicy::Block;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *drop_policy_name(DropPolicy policy) {
+    switch (policy) {
+        case DropPolicy::DropOldest:
+            return "drop-oldest";
+        case DropPolicy::DropNewest:
+            return "drop-newest";
+        case DropPolicy::Block:
+            return "block";
+    }
+    return "unknown";
+}
+
+static size_t resolve_workers(size_t workers, WorkerScheduler *scheduler) {
+    if (scheduler) {
+        return scheduler->workers();
+    }
+    if (workers > 0) {
+        return workers;
+    }
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+FrameExecutor::FrameExecutor(GstElement *appsink, GstElement *appsrc, const ExecutorConfig &config,
+                             WorkerScheduler *scheduler)
+    : appsink_(appsink),
+      appsrc_(appsrc),
+      config_(config),
+      latency_probe_(nullptr),
+      controller_(nullptr),
+      edge_thresholds_(0),
+      graph_(std::make_shared<StageGraph>()),
+      scheduler_(scheduler),
+      scheduler_stream_(-1),
+      input_(config.queue_capacity),
+      output_(config.queue_capacity + resolve_workers(config.workers, scheduler)),
+      next_output_seq_(0),
+      capture_running_(false),
+      workers_running_(false),
+      output_running_(false),
+      capture_eos_(false),
+      started_(false),
+      captured_(0),
+      processed_(0),
+      pushed_(0),
+      dropped_oldest_(0),
+      dropped_newest_(0),
+      blocked_(0),
+      failed_(0) {
+    config_.workers = resolve_workers(config_.workers, scheduler);
+    set_edge_params(EdgeParams().low_threshold, EdgeParams().high_threshold);
+
+    // Номера кадров между стадиями: очередь входа, кадры в работе,
+    // очередь выхода и кадр, который поток захвата вытесняет из очереди
+    size_t window = input_.capacity() + config_.workers + output_.capacity() + 2;
+    pending_.resize(window);
+    pending_ready_.assign(window, 0);
+    spare_contours_.reset(new BoundedQueue<FlatContours>(window));
+}
+
+FrameExecutor::~FrameExecutor() {
+    stop();
+}
+
+void FrameExecutor::set_output_callback(FrameCallback callback) {
+    output_callback_ = callback;
+}
+
+void FrameExecutor::set_contours_callback(ContoursCallback callback) {
+    contours_callback_ = callback;
+}
+
+void FrameExecutor::set_latency_probe(LatencyProbe *probe) {
+    latency_probe_ = probe;
+}
+
+void FrameExecutor::set_adaptive_controller(AdaptiveController *controller) {
+    controller_ = controller;
+}
+
+bool FrameExecutor::start() {
+    if (started_) {
+        return true;
+    }
+
+    // Без потока в планировщике кадры никто не обработал бы, а захват при
+    // DropPolicy::Block ждал бы места в очереди вечно
+    if (scheduler_) {
+        scheduler_stream_ = scheduler_->add_stream(config_.name, config_.priority, [this]() { return process_one(); });
+        if (scheduler_stream_ < 0) {
+            std::cerr << config_.name << ": не удалось зарегистрировать поток в планировщике" << std::endl;
+            return false;
+        }
+    }
+    started_ = true;
+
+    capture_running_ = true;
+    workers_running_ = true;
+    output_running_ = true;
+
+    output_thread_ = std::thread(&FrameExecutor::output_loop, this);
+    if (!scheduler_) {
+        for (size_t i = 0; i < config_.workers; ++i) {
+            worker_threads_.emplace_back(&FrameExecutor::worker_loop, this);
+        }
+    }
+    capture_thread_ = std::thread(&FrameExecutor::capture_loop, this);
+    return true;
+}
+
+void FrameExecutor::stop() {
+    if (!started_) {
+        return;
+    }
+    started_ = false;
+
+    // Останавливаем стадии по порядку, чтобы каждая дочитала свою очередь
+    capture_running_ = false;
+    capture_thread_.join();
+
+    workers_running_ = false;
+    if (scheduler_) {
+        // Общие рабочие дочитывают очередь входа, затем поток отключается
+        unsigned spins = 0;
+        while (input_.size_approx() > 0) {
+            backoff(spins);
+        }
+        scheduler_->remove_stream(scheduler_stream_);
+        scheduler_stream_ = -1;
+    }
+    for (std::thread &worker : worker_threads_) {
+        worker.join();
+    }
+    worker_threads_.clear();
+
+    output_running_ = false;
+    output_thread_.join();
+
+    // Кадры, застрявшие в окне переупорядочивания из-за пропусков
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        if (pending_ready_[i]) {
+            release(pending_[i]);
+            pending_ready_[i] = 0;
+        }
+    }
+}
+
+ExecutorStats FrameExecutor::stats() const {
+    ExecutorStats stats;
+    stats.captured = captured_.load(std::memory_order_relaxed);
+    stats.processed = processed_.load(std::memory_order_relaxed);
+    stats.pushed = pushed_.load(std::memory_order_relaxed);
+    stats.dropped_oldest = dropped_oldest_.load(std::memory_order_relaxed);
+    stats.dropped_newest = dropped_newest_.load(std::memory_order_relaxed);
+    stats.blocked = blocked_.load(std::memory_order_relaxed);
+    stats.failed = failed_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void FrameExecutor::release(FrameTask &task) {
+    if (task.sample) {
+        gst_sample_unref(task.sample);
+    }
+    if (task.caps) {
+        gst_caps_unref(task.caps);
+    }
+    task = FrameTask();
+}
+
+void FrameExecutor::capture_loop() {
+    uint64_t seq = 0;
+
+    trace_set_thread_name("capture");
+
+    while (capture_running_) {
+        GstSample *sample;
+        {
+            TRACE_SPAN("pull");
+            sample = gst_app_sink_try_pull_sample(GST_APP_SINK(appsink_), 100 * GST_MSECOND);
+        }
+
+        if (!sample) {
+            if (gst_app_sink_is_eos(GST_APP_SINK(appsink_))) {
+                capture_eos_.store(true, std::memory_order_release);
+                break;
+            }
+            continue;
+        }
+
+        captured_.fetch_add(1, std::memory_order_relaxed);
+
+        FrameTask task;
+        task.seq = seq;
+        task.sample = sample;
+
+        if (!wait_for_window(seq)) {
+            release(task);
+            break;
+        }
+
+        // Номер расходуется только кадром, попавшим в очередь
+        if (enqueue_input(task)) {
+            ++seq;
+        }
+    }
+}
+
+// Кредиты окна переупорядочивания: если рабочий застрял на кадре, который
+// ждёт стадия вывода, остальные кадры не должны обогнать его больше чем на
+// размер окна - иначе кадр seq + size займёт его слот. Захват ждёт, пока
+// вывод не продвинется; false - захват остановлен
+bool FrameExecutor::wait_for_window(uint64_t seq) {
+    unsigned spins = 0;
+    while (seq - next_output_seq_.load(std::memory_order_acquire) >= pending_.size()) {
+        if (!capture_running_) {
+            return false;
+        }
+        backoff(spins);
+    }
+    return true;
+}
+
+bool FrameExecutor::enqueue_input(FrameTask &task) {
+    if (input_.try_push(std::move(task))) {
+        return true;
+    }
+
+    switch (config_.drop_policy) {
+        case DropPolicy::DropNewest:
+            dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+            release(task);
+            return false;
+
+        case DropPolicy::DropOldest: {
+            FrameTask oldest;
+            while (!input_.try_push(std::move(task))) {
+                if (input_.try_pop(oldest)) {
+                    // Пустой кадр с тем же номером, чтобы стадия вывода не ждала его
+                    gst_sample_unref(oldest.sample);
+                    oldest.sample = nullptr;
+                    oldest.dropped = true;
+                    dropped_oldest_.fetch_add(1, std::memory_order_relaxed);
+                    push_output(std::move(oldest));
+                }
+            }
+            return true;
+        }
+
+        case DropPolicy::Block: {
+            blocked_.fetch_add(1, std::memory_order_relaxed);
+            unsigned spins = 0;
+            while (!input_.try_push(std::move(task))) {
+                if (!capture_running_) {
+                    release(task);
+                    return false;
+                }
+                backoff(spins);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void FrameExecutor::worker_loop() {
+    unsigned spins = 0;
+
+    trace_set_thread_name("worker");
+
+    for (;;) {
+        if (!process_one()) {
+            if (!workers_running_) {
+                break;
+            }
+            backoff(spins);
+            continue;
+        }
+        spins = 0;
+    }
+}
+
+bool FrameExecutor::process_one() {
+    FrameTask task;
+    if (!input_.try_pop(task)) {
+        return false;
+    }
+
+    // Кадр поверх памяти буфера источника может быть только для чтения
+    // (см. gst_sample_to_mat): обработка рисует в отдельный task.frame
+    Mat frame;
+    {
+        TRACE_SPAN("gst_sample_to_mat");
+        frame = gst_sample_to_mat(task.sample);
+    }
+    task.caps = gst_caps_ref(gst_sample_get_caps(task.sample));
+
+    // Временные метки источника переносятся на выходной буфер
+    GstBuffer *buffer = gst_sample_get_buffer(task.sample);
+    if (buffer) {
+        task.pts = GST_BUFFER_PTS(buffer);
+        task.duration = GST_BUFFER_DURATION(buffer);
+        task.capture_time = LatencyProbe::capture_time(appsink_, buffer);
+    }
+
+    // Буфер источника больше не нужен: кадр держит собственную ссылку
+    gst_sample_unref(task.sample);
+    task.sample = nullptr;
+
+    if (!frame.empty()) {
+        // Контуры кадра рабочего; обмен с overlay_ и копирование оставляют
+        // буферы у рабочего, а контуры кадра едут в буфере, который стадия
+        // вывода вернула после обратного вызова, поэтому память не
+        // выделяется на каждый кадр
+        static thread_local ContourOverlay overlay;
+        if (contours_callback_) {
+            spare_contours_->try_pop(task.contours);
+        }
+
+        EdgeParams edges = edge_params();
+        // Стандартный граф выполняет process_frame и redraw_frame
+        std::shared_ptr<const StageGraph> graph = stage_graph();
+
+        if (!controller_) {
+            if (contours_callback_) {
+                task.frame = graph->process(frame, &overlay, edges);
+                task.contours.swap(overlay.contours);
+            } else {
+                task.frame = graph->process(frame, nullptr, edges);
+            }
+        } else {
+            // Решение едет с кадром: рабочие берут кадры не по порядку
+            FrameDecision decision = controller_->next_frame();
+            task.encode = decision.encode;
+            if (decision.process) {
+                uint64_t start = trace_now_ns();
+                task.frame = graph->process(frame, &overlay, edges);
+                controller_->record_processing(trace_now_ns() - start);
+                if (contours_callback_) {
+                    task.contours = overlay.contours;
+                }
+
+                std::lock_guard<std::mutex> lock(overlay_mutex_);
+                overlay_.contours.swap(overlay.contours);
+            } else {
+                {
+                    std::lock_guard<std::mutex> lock(overlay_mutex_);
+                    overlay = overlay_;
+                }
+                task.frame = graph->redraw_copy(frame, overlay);
+                if (contours_callback_) {
+                    task.contours = overlay.contours;
+                }
+            }
+        }
+    }
+
+    if (task.frame.empty()) {
+        std::cerr << "Empty frame!" << std::endl;
+        task.dropped = true;
+        failed_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        processed_.fetch_add(1, std::memory_order_relaxed);
+        if (latency_probe_) {
+            latency_probe_->mark(task.capture_time, LatencyStage::Processed);
+        }
+    }
+
+    push_output(std::move(task));
+    return true;
+}
+
+void FrameExecutor::push_output(FrameTask &&task) {
+    unsigned spins = 0;
+    while (!output_.try_push(std::move(task))) {
+        backoff(spins);
+    }
+}
+
+void FrameExecutor::output_loop() {
+    unsigned spins = 0;
+    FrameTask task;
+
+    trace_set_thread_name("output");
+
+    for (;;) {
+        if (!output_.try_pop(task)) {
+            if (!output_running_) {
+                break;
+            }
+            backoff(spins);
+            continue;
+        }
+        spins = 0;
+
+        size_t slot = task.seq % pending_.size();
+        CV_Assert(!pending_ready_[slot] && task.seq - next_output_seq_.load(std::memory_order_relaxed) < pending_.size());
+        pending_[slot] = std::move(task);
+        pending_ready_[slot] = 1;
+
+        // Отдаём подряд идущие кадры, начиная с ожидаемого номера
+        uint64_t next_seq = next_output_seq_.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t next = next_seq % pending_.size();
+            if (!pending_ready_[next]) {
+                break;
+            }
+            emit(pending_[next]);
+            pending_ready_[next] = 0;
+            ++next_seq;
+            // Слот свободен: захват может выдать следующий номер
+            next_output_seq_.store(next_seq, std::memory_order_release);
+        }
+    }
+}
+
+// PTS источника отсчитан от base time конвейера захвата; appsrc живого
+// конвейера назначения ждёт running time своего конвейера. Оба конвейера
+// работают на системных часах, поэтому метка сдвигается на разницу base time.
+static GstClockTime rebase_pts(GstClockTime pts, GstElement *from, GstElement *to) {
+    if (!GST_CLOCK_TIME_IS_VALID(pts)) {
+        return GST_CLOCK_TIME_NONE;
+    }
+
+    GstClockTimeDiff offset = GST_CLOCK_DIFF(gst_element_get_base_time(to), gst_element_get_base_time(from));
+    GstClockTimeDiff rebased = (GstClockTimeDiff)pts + offset;
+
+    return rebased > 0 ? (GstClockTime)rebased : 0;
+}
+
+void FrameExecutor::emit(FrameTask &task) {
+    if (!task.dropped && appsrc_) {
+        GstClockTime pts = config_.live ? rebase_pts(task.pts, appsink_, appsrc_) : task.pts;
+        GstSample *out_sample;
+        {
+            TRACE_SPAN("mat_to_gst_sample");
+            out_sample = mat_to_gst_sample(task.frame, task.caps, pts, task.duration);
+        }
+
+        if (out_sample) {
+            if (!task.encode) {
+                // Буфер только что создан и принадлежит только out_sample
+                GST_BUFFER_FLAG_SET(gst_sample_get_buffer(out_sample), kAdaptiveSkipEncode);
+            }
+            GstFlowReturn ret;
+            {
+                TRACE_SPAN("push_sample");
+                ret = gst_app_src_push_sample(GST_APP_SRC(appsrc_), out_sample);
+            }
+            gst_sample_unref(out_sample);
+
+            if (ret != GST_FLOW_OK) {
+                std::cerr << "Error during sending frame to appsrc: " << ret << std::endl;
+            } else {
+                pushed_.fetch_add(1, std::memory_order_relaxed);
+                if (latency_probe_) {
+                    latency_probe_->mark(task.capture_time, LatencyStage::Pushed);
+                }
+            }
+        }
+    }
+
+    if (!task.dropped) {
+        if (output_callback_) {
+            output_callback_(task.frame);
+        }
+        if (contours_callback_) {
+            contours_callback_(task.contours, task.pts, task.frame.size());
+        }
+    }
+    if (contours_callback_) {
+        task.contours.clear();
+        spare_contours_->try_push(std::move(task.contours));
+    }
+
+    release(task);
+}
@@ -0,0 +1,195 @@
+#ifndef VIDSTREAM_FRAME_EXECUTOR_HPP
+#define VIDSTREAM_FRAME_EXECUTOR_HPP
+
+#include <opencv2/core.hpp>
+#include <gst/gst.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_queue.hpp"
+#include "processing.hpp"
+#include "stage_graph.hpp"
+#include "worker_scheduler.hpp"
+
+class AdaptiveController;
+class LatencyProbe;
+
+// Политика при переполнении очереди между захватом и обработкой
+enum class DropPolicy {
+    DropOldest,  // выбросить самый старый кадр из очереди
+    DropNewest,  // выбросить только что захваченный кадр
+    Block        // ждать освобождения места (давление на источник)
+};
+
+bool parse_drop_policy(const std::string &name, DropPolicy &policy);
+const char *drop_policy_name(DropPolicy policy);
+
+struct ExecutorConfig {
+    size_t workers = 0;          // 0 - по числу ядер; без планировщика
+    std::string name;            // имя потока кадров в планировщике
+    int priority = 1;            // доля общего пула, см. WorkerScheduler
+    size_t queue_capacity = 8;
+    DropPolicy drop_policy = DropPolicy::DropOldest;
+    // Живой источник: PTS пересчитываются в running time конвейера назначения.
+    // Для файлов метки уходят как есть
+    bool live = true;
+};
+
+struct ExecutorStats {
+    uint64_t captured = 0;
+    uint64_t processed = 0;
+    uint64_t pushed = 0;
+    uint64_t dropped_oldest = 0;
+    uint64_t dropped_newest = 0;
+    uint64_t blocked = 0;
+    uint64_t failed = 0;
+};
+
+// Конвейер обработки: поток захвата забирает кадры из appsink, N рабочих
+// потоков выполняют process_frame, стадия вывода восстанавливает порядок
+// кадров и отправляет их в appsrc. Стадии связаны lock-free очередями.
+// С планировщиком собственных рабочих потоков нет: кадры обрабатывает
+// общий пул WorkerScheduler, разделяемый несколькими исполнителями.
+// Без appsrc кадры только передаются обратным вызовам.
+class FrameExecutor {
+public:
+    typedef std::function<void(const cv::Mat &)> FrameCallback;
+    // Контуры кадра, PTS источника и размер кадра
+    typedef std::function<void(const FlatContours &, GstClockTime, cv::Size)> ContoursCallback;
+
+    FrameExecutor(GstElement *appsink, GstElement *appsrc, const ExecutorConfig &config,
+                  WorkerScheduler *scheduler = nullptr);
+    ~FrameExecutor();
+
+    FrameExecutor(const FrameExecutor &) = delete;
+    FrameExecutor &operator=(const FrameExecutor &) = delete;
+
+    // Вызывается на стадии вывода для каждого отправленного кадра, в порядке захвата
+    void set_output_callback(FrameCallback callback);
+
+    // Вызывается на стадии вывода с контурами, нарисованными на кадре, в
+    // порядке захвата. Контуры тогда едут с кадром через очередь вывода,
+    // поэтому на кадр выделяется память.
+    void set_contours_callback(ContoursCallback callback);
+
+    // Отметки стадий "обработка" и "отправка в appsrc"; probe должен
+    // пережить исполнитель
+    void set_latency_probe(LatencyProbe *probe);
+
+    // Регулятор нагрузки: решает, какие кадры обрабатывать полностью, и
+    // получает время обработки; должен пережить исполнитель
+    void set_adaptive_controller(AdaptiveController *controller);
+
+    // Пороги поиска краёв; из любого потока, действуют со следующего кадра.
+    // Пара хранится одним 64-битным словом: кадр не видит новый нижний порог
+    // со старым верхним
+    void set_edge_params(int low_threshold, int high_threshold) {
+        edge_thresholds_.store((uint64_t)(uint32_t)low_threshold << 32 | (uint32_t)high_threshold,
+                               std::memory_order_relaxed);
+    }
+    EdgeParams edge_params() const {
+        uint64_t packed = edge_thresholds_.load(std::memory_order_relaxed);
+        EdgeParams params;
+        params.low_threshold = (int)(uint32_t)(packed >> 32);
+        params.high_threshold = (int)(uint32_t)packed;
+        return params;
+    }
+
+    // Граф стадий обработки; из любого потока, действует со следующего кадра.
+    // По умолчанию - стандартная цепочка process_frame
+    void set_stage_graph(std::shared_ptr<const StageGraph> graph) { std::atomic_store(&graph_, graph); }
+    std::shared_ptr<const StageGraph> stage_graph() const { return std::atomic_load(&graph_); }
+
+    // false - поток не удалось зарегистрировать в планировщике (заняты все
+    // слоты); исполнитель тогда не запущен
+    bool start();
+    void stop();
+
+    // Поток захвата дошёл до конца потока appsink: после stop() все кадры
+    // будут обработаны и отданы
+    bool capture_eos() const { return capture_eos_.load(std::memory_order_acquire); }
+
+    ExecutorStats stats() const;
+
+private:
+    struct FrameTask {
+        uint64_t seq = 0;
+        GstSample *sample = nullptr;
+        GstCaps *caps = nullptr;
+        GstClockTime pts = GST_CLOCK_TIME_NONE;
+        GstClockTime duration = GST_CLOCK_TIME_NONE;
+        GstClockTime capture_time = GST_CLOCK_TIME_NONE;
+        cv::Mat frame;
+        FlatContours contours;  // только с обратным вызовом контуров
+        bool dropped = false;
+        bool encode = true;  // false - буфер помечается kAdaptiveSkipEncode
+    };
+
+    void capture_loop();
+    bool wait_for_window(uint64_t seq);
+    void worker_loop();
+    bool process_one();
+    void output_loop();
+
+    bool enqueue_input(FrameTask &task);
+    void push_output(FrameTask &&task);
+    void emit(FrameTask &task);
+    static void release(FrameTask &task);
+
+    GstElement *appsink_;
+    GstElement *appsrc_;
+    ExecutorConfig config_;
+    FrameCallback output_callback_;
+    ContoursCallback contours_callback_;
+    LatencyProbe *latency_probe_;
+    AdaptiveController *controller_;
+    std::atomic<uint64_t> edge_thresholds_;  // нижний порог в старших 32 битах, верхний - в младших
+    std::shared_ptr<const StageGraph> graph_;  // только через atomic_load/atomic_store
+
+    // Контуры последнего полностью обработанного кадра для пропущенных кадров
+    std::mutex overlay_mutex_;
+    ContourOverlay overlay_;
+    WorkerScheduler *scheduler_;
+    int scheduler_stream_;
+
+    BoundedQueue<FrameTask> input_;
+    BoundedQueue<FrameTask> output_;
+
+    // Окно переупорядочивания: кадр с номером seq хранится в слоте seq % size.
+    // Поток захвата не выдаёт номер дальше окна от next_output_seq_, поэтому
+    // слот кадра всегда свободен
+    std::vector<FrameTask> pending_;
+    std::vector<char> pending_ready_;
+    std::atomic<uint64_t> next_output_seq_;  // пишет только стадия вывода
+
+    // Буферы контуров отданных кадров возвращаются рабочим: с обратным
+    // вызовом контуров память кадра не выделяется заново
+    std::unique_ptr<BoundedQueue<FlatContours>> spare_contours_;
+
+    std::thread capture_thread_;
+    std::vector<std::thread> worker_threads_;
+    std::thread output_thread_;
+
+    std::atomic<bool> capture_running_;
+    std::atomic<bool> workers_running_;
+    std::atomic<bool> output_running_;
+    std::atomic<bool> capture_eos_;
+    bool started_;
+
+    std::atomic<uint64_t> captured_;
+    std::atomic<uint64_t> processed_;
+    std::atomic<uint64_t> pushed_;
+    std::atomic<uint64_t> dropped_oldest_;
+    std::atomic<uint64_t> dropped_newest_;
+    std::atomic<uint64_t> blocked_;
+    std::atomic<uint64_t> failed_;
+};
+
+#endif // VIDSTREAM_FRAME_EXECUTOR_HPP
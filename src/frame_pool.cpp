@@ -0,0 +1,44 @@
+#include "frame_pool.hpp"
+
+using namespace cv;
+
+// Кадр свободен, если на его данные ссылается только сам пул
+static bool is_free(const Mat &frame) {
+    return frame.u && CV_XADD(&frame.u->refcount, 0) == 1;
+}
+
+FramePool::FramePool(size_t capacity)
+    : capacity_(capacity), misses_(0) {
+    frames_.reserve(capacity_);
+}
+
+Mat FramePool::acquire(int rows, int cols, int type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Mat *reusable = nullptr;
+    for (Mat &frame : frames_) {
+        if (!is_free(frame)) {
+            continue;
+        }
+        if (frame.rows == rows && frame.cols == cols && frame.type() == type) {
+            return frame;
+        }
+        if (!reusable) {
+            reusable = &frame;
+        }
+    }
+
+    if (frames_.size() < capacity_) {
+        frames_.emplace_back(rows, cols, type);
+        return frames_.back();
+    }
+
+    // Пул заполнен кадрами другого размера: перевыделяем свободный
+    if (reusable) {
+        reusable->create(rows, cols, type);
+        return *reusable;
+    }
+
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return Mat(rows, cols, type);
+}
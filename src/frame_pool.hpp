@@ -0,0 +1,30 @@
+#ifndef VIDSTREAM_FRAME_POOL_HPP
+#define VIDSTREAM_FRAME_POOL_HPP
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Ограниченный пул кадров. Пул хранит собственную ссылку на каждый Mat:
+// кадр свободен, когда эта ссылка единственная, т.е. все внешние копии
+// уже освобождены. Если свободных кадров нет, acquire() выделяет
+// временный Mat вне пула и учитывает это в misses().
+class FramePool {
+public:
+    explicit FramePool(size_t capacity);
+
+    cv::Mat acquire(int rows, int cols, int type);
+
+    size_t capacity() const { return capacity_; }
+    size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex mutex_;
+    std::vector<cv::Mat> frames_;
+    size_t capacity_;
+    std::atomic<size_t> misses_;
+};
+
+#endif // VIDSTREAM_FRAME_POOL_HPP
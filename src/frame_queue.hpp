@@ -0,0 +1,130 @@
+#ifndef VIDSTREAM_FRAME_QUEUE_HPP
+#define VIDSTREAM_FRAME_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// Ожидание при пустой или полной очереди: сначала уступаем процессор,
+// затем засыпаем, чтобы не крутить ядро вхолостую
+inline void backoff(unsigned &spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+// Ограниченная lock-free очередь MPMC (схема Д. Вьюкова).
+// Ёмкость округляется вверх до степени двойки. Каждая ячейка хранит
+// порядковый номер, по которому производители и потребители определяют,
+// свободна ли ячейка, без общих блокировок.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : mask_(round_up_pow2(capacity) - 1),
+          cells_(new Cell[mask_ + 1]),
+          enqueue_pos_(0),
+          dequeue_pos_(0) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    bool try_push(T &&value) {
+        Cell *cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T &value) {
+        Cell *cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Приблизительный размер: точен только при отсутствии конкурентных операций
+    size_t size_approx() const {
+        size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+        size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t round_up_pow2(size_t value) {
+        size_t result = 2;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    // Позиции производителей и потребителей разнесены по разным строкам
+    // кэша дополнением, а не alignas: тип без повышенного выравнивания
+    // можно создавать через new в C++11 (иначе -Waligned-new)
+    static const size_t kCacheLine = 64;
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    char pad0_[kCacheLine];
+    std::atomic<size_t> enqueue_pos_;
+    char pad1_[kCacheLine - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_pos_;
+    char pad2_[kCacheLine - sizeof(std::atomic<size_t>)];
+};
+
+#endif // VIDSTREAM_FRAME_QUEUE_HPP
@@ -0,0 +1,223 @@
+#include "gst_convert.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <iostream>
+
+using namespace cv;
+
+// Пул кадров для входных данных, требующих перестановки каналов
+static FramePool ingest_pool(32);
+
+FramePool &egress_frame_pool() {
+    static FramePool pool(32);
+    return pool;
+}
+
+// Вызывается GStreamer при освобождении обёрнутой памяти:
+// снимает ссылку буфера с кадра, и тот возвращается в пул
+static void release_mat_data(gpointer data) {
+    UMatData *u = static_cast<UMatData *>(data);
+
+    if (CV_XADD(&u->refcount, -1) == 1) {
+        const MatAllocator *allocator = u->currAllocator ? u->currAllocator : Mat::getDefaultAllocator();
+        allocator->unmap(u);
+    }
+}
+
+// Функция для преобразования Mat в GstBuffer.
+// Непрерывный Mat оборачивается без копирования: буфер держит ссылку на
+// данные кадра до тех пор, пока GStreamer не освободит память.
+GstBuffer *mat_to_gst_buffer(const Mat &frame) {
+    Mat data = frame;
+
+    if (!data.u || !data.isContinuous()) {
+        data = egress_frame_pool().acquire(frame.rows, frame.cols, frame.type());
+        frame.copyTo(data);
+    }
+
+    gsize size = data.total() * data.elemSize();
+
+    CV_XADD(&data.u->refcount, 1);
+    GstBuffer *buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, data.data, size, 0, size,
+                                                    data.u, release_mat_data);
+
+    if (!buffer) {
+        std::cerr << "Couldn't create buffer!" << std::endl;
+        release_mat_data(data.u);
+        return nullptr;
+    }
+
+    return buffer;
+}
+
+// Функция для преобразования Mat в GstSample
+GstSample *mat_to_gst_sample(const Mat &frame, GstCaps *caps) {
+    return mat_to_gst_sample(frame, caps, gst_util_get_timestamp(), GST_CLOCK_TIME_NONE);
+}
+
+GstSample *mat_to_gst_sample(const Mat &frame, GstCaps *caps, GstClockTime pts, GstClockTime duration) {
+    GstBuffer *buffer = mat_to_gst_buffer(frame);
+
+    if (!buffer) {
+        return nullptr;
+    }
+
+    // Сырое видео не переупорядочивается, поэтому DTS совпадает с PTS
+    GST_BUFFER_PTS(buffer) = pts;
+    GST_BUFFER_DTS(buffer) = pts;
+    GST_BUFFER_DURATION(buffer) = duration;
+
+    // Строки кадра идут подряд с шагом cols*elemSize, а раскладка GStreamer по
+    // умолчанию выравнивает строку до 4 байт (BGR при ширине, не кратной 4).
+    // Реальный шаг передаётся через GstVideoMeta, иначе кадр ниже по конвейеру
+    // читается со сдвигом строк.
+    GstVideoInfo info;
+    gsize stride = frame.cols * frame.elemSize();
+    if (caps && gst_video_info_from_caps(&info, caps) && GST_VIDEO_INFO_N_PLANES(&info) == 1 &&
+        (gsize)GST_VIDEO_INFO_PLANE_STRIDE(&info, 0) != stride) {
+        gsize offset[GST_VIDEO_MAX_PLANES] = {0};
+        gint strides[GST_VIDEO_MAX_PLANES] = {(gint)stride};
+        gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_INFO_FORMAT(&info),
+                                       GST_VIDEO_INFO_WIDTH(&info), GST_VIDEO_INFO_HEIGHT(&info), 1, offset,
+                                       strides);
+    }
+
+    GstSample *sample = gst_sample_new(buffer, caps, NULL, NULL);
+
+    gst_buffer_unref(buffer);
+
+    return sample;
+}
+
+// Держатель отображённого GstBuffer для Mat без копирования.
+// Буфер остаётся захваченным и отображённым, пока жив последний Mat,
+// ссылающийся на его память; освобождение выполняет deallocate().
+struct GstBufferMatData : public UMatData {
+    explicit GstBufferMatData(const MatAllocator *allocator) : UMatData(allocator) {}
+
+    GstBuffer *buffer = nullptr;
+    GstMapInfo map;
+};
+
+class GstBufferMatAllocator : public MatAllocator {
+public:
+    // Mat с этим аллокатором создаются только в wrap_gst_buffer()
+    UMatData *allocate(int, const int *, int, void *, size_t *, AccessFlag, UMatUsageFlags) const override {
+        return nullptr;
+    }
+
+    bool allocate(UMatData *, AccessFlag, UMatUsageFlags) const override {
+        return false;
+    }
+
+    void deallocate(UMatData *u) const override {
+        GstBufferMatData *data = static_cast<GstBufferMatData *>(u);
+        gst_buffer_unmap(data->buffer, &data->map);
+        gst_buffer_unref(data->buffer);
+        delete data;
+    }
+};
+
+static GstBufferMatAllocator gst_buffer_mat_allocator;
+
+// Оборачивает память GstBuffer в Mat без копирования. Память writable-буфера
+// отображается для записи; writable - получилось ли это
+static Mat wrap_gst_buffer(GstBuffer *buffer, int rows, int cols, int type, gsize offset, gsize stride,
+                           bool &writable) {
+    GstBufferMatData *data = new GstBufferMatData(&gst_buffer_mat_allocator);
+
+    // Отображение для записи не удаётся, если память помечена READONLY
+    writable = gst_buffer_is_writable(buffer) && gst_buffer_map(buffer, &data->map, GST_MAP_READWRITE);
+    if (!writable && !gst_buffer_map(buffer, &data->map, GST_MAP_READ)) {
+        std::cerr << "Cannot map gstreamer buffer" << std::endl;
+        delete data;
+        return Mat();
+    }
+
+    if (data->map.size < offset + stride * rows) {
+        std::cerr << "Gstreamer buffer is smaller than frame" << std::endl;
+        gst_buffer_unmap(buffer, &data->map);
+        delete data;
+        return Mat();
+    }
+
+    data->buffer = gst_buffer_ref(buffer);
+    data->data = data->origdata = data->map.data;
+    data->size = data->map.size;
+    data->flags = UMatData::USER_ALLOCATED;
+    data->refcount = 1;
+
+    Mat frame(rows, cols, type, data->map.data + offset, stride);
+    frame.u = data;
+    return frame;
+}
+
+// Функция для преобразования GstSample в Mat.
+// Для BGR/BGRA/GRAY8 возвращает Mat поверх памяти буфера (для записи - только
+// если буфер writable), для RGB переставляет каналы одним проходом cvtColor
+// в кадр из пула.
+Mat gst_sample_to_mat(GstSample* sample, bool *writable) {
+    if (writable) {
+        *writable = false;
+    }
+
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    GstCaps* caps = gst_sample_get_caps(sample);
+    GstVideoInfo info;
+
+    if (!buffer || !caps || !gst_video_info_from_caps(&info, caps)) {
+        std::cerr << "Cannot parse gstreamer sample" << std::endl;
+        return Mat();
+    }
+
+    int width = GST_VIDEO_INFO_WIDTH(&info);
+    int height = GST_VIDEO_INFO_HEIGHT(&info);
+    gsize offset = GST_VIDEO_INFO_PLANE_OFFSET(&info, 0);
+    gsize stride = GST_VIDEO_INFO_PLANE_STRIDE(&info, 0);
+
+    // Реальная раскладка буфера может отличаться от раскладки по умолчанию
+    GstVideoMeta* meta = gst_buffer_get_video_meta(buffer);
+    if (meta) {
+        offset = meta->offset[0];
+        stride = meta->stride[0];
+    }
+
+    GstVideoFormat format = GST_VIDEO_INFO_FORMAT(&info);
+    int type;
+
+    switch (format) {
+        case GST_VIDEO_FORMAT_RGBA:
+        case GST_VIDEO_FORMAT_BGRA:
+        case GST_VIDEO_FORMAT_RGBx:
+        case GST_VIDEO_FORMAT_BGRx:
+            type = CV_8UC4;
+            break;
+        case GST_VIDEO_FORMAT_GRAY8:
+            type = CV_8UC1;
+            break;
+        default:
+            type = CV_8UC3;
+            break;
+    }
+
+    bool mapped_writable = false;
+    Mat frame = wrap_gst_buffer(buffer, height, width, type, offset, stride, mapped_writable);
+
+    if (frame.empty() || format != GST_VIDEO_FORMAT_RGB) {
+        if (writable) {
+            *writable = mapped_writable && !frame.empty();
+        }
+        return frame;
+    }
+
+    // Перестановка RGB -> BGR совмещена с копированием в кадр из пула;
+    // исходный буфер освобождается вместе с frame
+    Mat result = ingest_pool.acquire(height, width, CV_8UC3);
+    cvtColor(frame, result, COLOR_RGB2BGR);
+
+    if (writable) {
+        *writable = true;
+    }
+    return result;
+}
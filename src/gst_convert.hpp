@@ -0,0 +1,27 @@
+#ifndef VIDSTREAM_GST_CONVERT_HPP
+#define VIDSTREAM_GST_CONVERT_HPP
+
+#include <opencv2/core.hpp>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "frame_pool.hpp"
+
+// Преобразование GstSample -> Mat без копирования (для RGB - одна перестановка каналов).
+// Кадр поверх памяти буфера отображён для записи, только если буфер writable
+// (единственная ссылка) и его память не помечена READONLY; иначе кадр - только
+// для чтения: запись в него меняет буфер у других владельцев, а то и падает.
+// writable сообщает, можно ли менять кадр; без него кадр нельзя менять вовсе.
+cv::Mat gst_sample_to_mat(GstSample *sample, bool *writable = nullptr);
+
+// Преобразование Mat -> GstBuffer/GstSample без копирования непрерывных кадров
+GstBuffer *mat_to_gst_buffer(const cv::Mat &frame);
+GstSample *mat_to_gst_sample(const cv::Mat &frame, GstCaps *caps);
+
+// То же с заданными временными метками (например, перенесёнными из буфера источника)
+GstSample *mat_to_gst_sample(const cv::Mat &frame, GstCaps *caps, GstClockTime pts, GstClockTime duration);
+
+// Пул кадров, в который рисуются обработанные кадры перед отправкой в appsrc
+FramePool &egress_frame_pool();
+
+#endif // VIDSTREAM_GST_CONVERT_HPP
@@ -0,0 +1,429 @@
+#include "instrumentation.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+std::atomic<bool> trace_spans_enabled(false);
+
+// Окно трассы в наносекундах steady_clock; пустое окно - трасса не пишется
+static std::atomic<uint64_t> trace_window_begin(0);
+static std::atomic<uint64_t> trace_window_end(0);
+
+// Ёмкость буфера спанов одного потока на всё окно трассы
+static const size_t kThreadTraceCapacity = 1 << 16;
+
+struct SpanEvent {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+};
+
+// Буфер спанов потока: пишет только владелец, экспорт читает первые count
+// записей. Буферы живут до конца программы, поэтому завершение потока не
+// мешает экспорту.
+struct ThreadTrace {
+    std::vector<SpanEvent> events;
+    std::atomic<size_t> count;
+    int tid;
+    std::string name;
+
+    ThreadTrace() : count(0), tid(0) {}
+};
+
+static std::mutex &thread_registry_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<std::unique_ptr<ThreadTrace>> &thread_registry() {
+    static std::vector<std::unique_ptr<ThreadTrace>> registry;
+    return registry;
+}
+
+static ThreadTrace &thread_trace() {
+    static thread_local ThreadTrace *trace = nullptr;
+    if (!trace) {
+        std::lock_guard<std::mutex> lock(thread_registry_mutex());
+        std::vector<std::unique_ptr<ThreadTrace>> &registry = thread_registry();
+        registry.emplace_back(new ThreadTrace());
+        trace = registry.back().get();
+        trace->tid = (int)registry.size();
+    }
+    return *trace;
+}
+
+static std::mutex &site_registry_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<TraceSite *> &site_registry() {
+    static std::vector<TraceSite *> registry;
+    return registry;
+}
+
+void trace_set_thread_name(const std::string &name) {
+    ThreadTrace &trace = thread_trace();
+    std::lock_guard<std::mutex> lock(thread_registry_mutex());
+    trace.name = name;
+}
+
+LogHistogram::LogHistogram() : max_(0) {
+    for (int i = 0; i < kBuckets; ++i) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int LogHistogram::bucket_index(uint64_t value) {
+    if (value < (uint64_t)kSub) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= kMaxBits) {
+        return kBuckets - 1;
+    }
+    int shift = msb - kSubBits;
+    return (shift + 1) * kSub + (int)((value >> shift) & (kSub - 1));
+}
+
+uint64_t LogHistogram::bucket_upper(int index) {
+    if (index < kSub) {
+        return (uint64_t)index;
+    }
+    int shift = index / kSub - 1;
+    uint64_t lower = (uint64_t)(kSub + index % kSub) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void LogHistogram::record(uint64_t value) {
+    buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+LogHistogram::Snapshot LogHistogram::drain() {
+    Snapshot snapshot;
+    snapshot.buckets.resize(kBuckets);
+    for (int i = 0; i < kBuckets; ++i) {
+        snapshot.buckets[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.max = max_.exchange(0, std::memory_order_relaxed);
+    return snapshot;
+}
+
+uint64_t LogHistogram::Snapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)(p / 100.0 * count + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(bucket_upper(i), max);
+        }
+    }
+    return max;
+}
+
+TraceSite::TraceSite(const char *name) : name_(name), total_(0) {
+    std::lock_guard<std::mutex> lock(site_registry_mutex());
+    site_registry().push_back(this);
+}
+
+void TraceSite::record(uint64_t start_ns, uint64_t duration_ns) {
+    histogram_.record(duration_ns);
+    total_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t begin = trace_window_begin.load(std::memory_order_relaxed);
+    if (begin == 0 || start_ns < begin || start_ns >= trace_window_end.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    ThreadTrace &trace = thread_trace();
+    size_t count = trace.count.load(std::memory_order_relaxed);
+    if (count >= kThreadTraceCapacity) {
+        return;
+    }
+    if (trace.events.empty()) {
+        trace.events.resize(kThreadTraceCapacity);
+    }
+
+    SpanEvent &event = trace.events[count];
+    event.name = name_;
+    event.start_ns = start_ns;
+    event.duration_ns = duration_ns;
+    trace.count.store(count + 1, std::memory_order_release);
+}
+
+Instrumentation::Instrumentation(const InstrumentationConfig &config)
+    : config_(config), running_(false), listen_fd_(-1), start_ns_(0), trace_written_(false) {
+    if (config_.stats_interval <= 0) {
+        config_.stats_interval = 1;
+    }
+}
+
+Instrumentation::~Instrumentation() {
+    stop();
+}
+
+void Instrumentation::add_gauge(const std::string &name, GaugeReader reader) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_.push_back(std::make_pair(name, reader));
+}
+
+void Instrumentation::clear_gauges() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_.clear();
+}
+
+std::string Instrumentation::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshot_;
+}
+
+void Instrumentation::start() {
+    if (running_ || !config_.enabled()) {
+        return;
+    }
+    running_ = true;
+
+    start_ns_ = trace_now_ns();
+    if (!config_.trace_path.empty()) {
+        uint64_t begin = start_ns_ + (uint64_t)(config_.trace_start * 1e9);
+        trace_window_end.store(begin + (uint64_t)(config_.trace_seconds * 1e9), std::memory_order_relaxed);
+        trace_window_begin.store(begin, std::memory_order_relaxed);
+    }
+    trace_spans_enabled.store(true, std::memory_order_relaxed);
+
+    if (config_.stats_port > 0) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+
+        int reuse = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr = sockaddr_in();
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)config_.stats_port);
+
+        if (listen_fd_ < 0 || bind(listen_fd_, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd_, 4) < 0) {
+            std::cerr << "Не удалось открыть порт сводки " << config_.stats_port << std::endl;
+            if (listen_fd_ >= 0) {
+                close(listen_fd_);
+            }
+            listen_fd_ = -1;
+        } else {
+            serve_thread_ = std::thread(&Instrumentation::serve_loop, this);
+        }
+    }
+
+    stats_thread_ = std::thread(&Instrumentation::stats_loop, this);
+}
+
+void Instrumentation::stop() {
+    if (!running_) {
+        return;
+    }
+    running_ = false;
+
+    stats_thread_.join();
+    if (serve_thread_.joinable()) {
+        serve_thread_.join();
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+
+    trace_spans_enabled.store(false, std::memory_order_relaxed);
+
+    // Последняя сводка и трасса, если окно не успело закончиться
+    update_snapshot();
+    write_trace();
+}
+
+void Instrumentation::stats_loop() {
+    const std::chrono::microseconds period((long long)(config_.stats_interval * 1e6));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now() + period;
+
+    while (running_) {
+        // Спим короткими шагами, чтобы stop() не ждал целый интервал
+        if (std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            continue;
+        }
+        next += period;
+
+        update_snapshot();
+
+        uint64_t end = trace_window_end.load(std::memory_order_relaxed);
+        if (!config_.trace_path.empty() && end != 0 && trace_now_ns() >= end) {
+            write_trace();
+        }
+    }
+}
+
+void Instrumentation::update_snapshot() {
+    std::vector<TraceSite *> sites;
+    {
+        std::lock_guard<std::mutex> lock(site_registry_mutex());
+        sites = site_registry();
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << "# uptime_s " << (trace_now_ns() - start_ns_) / 1e9 << " window_s " << config_.stats_interval << "\n";
+
+    for (TraceSite *site : sites) {
+        LogHistogram::Snapshot s = site->histogram().drain();
+        out << "span " << site->name()
+            << " total " << site->total()
+            << " count " << s.count
+            << " p50_us " << s.percentile(50) / 1e3
+            << " p90_us " << s.percentile(90) / 1e3
+            << " p99_us " << s.percentile(99) / 1e3
+            << " max_us " << s.max / 1e3 << "\n";
+    }
+
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const std::pair<std::string, GaugeReader> &gauge : gauges_) {
+            out << "gauge " << gauge.first << " " << gauge.second() << "\n";
+        }
+        snapshot_ = out.str();
+        text = snapshot_;
+    }
+
+    write_stats_file(text);
+}
+
+void Instrumentation::write_stats_file(const std::string &text) {
+    if (config_.stats_path.empty()) {
+        return;
+    }
+
+    // Запись во временный файл и переименование: читатель не увидит половину сводки
+    std::string tmp_path = config_.stats_path + ".tmp";
+    {
+        std::ofstream file(tmp_path.c_str(), std::ios::trunc);
+        if (!file) {
+            return;
+        }
+        file << text;
+    }
+    std::rename(tmp_path.c_str(), config_.stats_path.c_str());
+}
+
+void Instrumentation::serve_loop() {
+    static const char kHeader[] = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; charset=utf-8\r\nConnection: close\r\n\r\n";
+
+    while (running_) {
+        pollfd pfd = pollfd();
+        pfd.fd = listen_fd_;
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        int client = accept(listen_fd_, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+
+        // Содержимое запроса не важно: на любой запрос отдаётся сводка
+        char request[1024];
+        pollfd cfd = pollfd();
+        cfd.fd = client;
+        cfd.events = POLLIN;
+        if (poll(&cfd, 1, 100) > 0) {
+            recv(client, request, sizeof(request), 0);
+        }
+
+        std::string response = kHeader + snapshot();
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += (size_t)n;
+        }
+        close(client);
+    }
+}
+
+void write_json_string(std::ostream &out, const std::string &value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+void Instrumentation::write_trace() {
+    if (config_.trace_path.empty() || trace_written_) {
+        return;
+    }
+    trace_written_ = true;
+
+    // Новые спаны в трассу больше не попадают
+    trace_window_begin.store(0, std::memory_order_relaxed);
+
+    std::ofstream file(config_.trace_path.c_str(), std::ios::trunc);
+    if (!file) {
+        std::cerr << "Не удалось записать трассу в " << config_.trace_path << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(thread_registry_mutex());
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    size_t events = 0;
+
+    for (const std::unique_ptr<ThreadTrace> &trace : thread_registry()) {
+        if (!trace->name.empty()) {
+            file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace->tid
+                 << ",\"args\":{\"name\":";
+            write_json_string(file, trace->name);
+            file << "}}";
+            first = false;
+        }
+
+        size_t count = trace->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const SpanEvent &event = trace->events[i];
+            file << (first ? "" : ",") << "\n{\"name\":";
+            write_json_string(file, event.name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->tid
+                 << ",\"ts\":" << (event.start_ns - start_ns_) / 1000.0
+                 << ",\"dur\":" << event.duration_ns / 1000.0 << "}";
+            first = false;
+        }
+        events += count;
+    }
+
+    file << "\n]}\n";
+    std::cout << "Трасса: " << events << " спанов записано в " << config_.trace_path << std::endl;
+}
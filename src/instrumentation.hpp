@@ -0,0 +1,170 @@
+#ifndef VIDSTREAM_INSTRUMENTATION_HPP
+#define VIDSTREAM_INSTRUMENTATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Инструментирование стадий обработки.
+//
+// TRACE_SPAN("name") измеряет длительность окружающего блока. Каждое место
+// вызова - статический TraceSite со своей гистограммой; запись идёт без
+// блокировок: атомарное увеличение корзины и, во время окна трассировки,
+// запись в буфер текущего потока. Пока инструментирование выключено,
+// спан стоит одной relaxed-загрузки флага.
+//
+// Instrumentation периодически снимает гистограммы (скользящее окно, равное
+// интервалу) и показатели, пишет текстовую сводку в файл и отдаёт её по
+// HTTP на 127.0.0.1, а выбранное окно спанов сохраняет в формате Chrome
+// trace-event (chrome://tracing, Perfetto).
+
+// Гистограмма с логарифмически-линейными корзинами (как HDR Histogram):
+// 16 корзин на каждую степень двойки, относительная ошибка не более 6%
+class LogHistogram {
+public:
+    static const int kSubBits = 4;
+    static const int kSub = 1 << kSubBits;
+    static const int kMaxBits = 40;
+    static const int kBuckets = (kMaxBits - kSubBits + 1) * kSub;
+
+    LogHistogram();
+
+    void record(uint64_t value);
+
+    // Забирает накопленные значения и обнуляет гистограмму
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t max = 0;
+
+        uint64_t percentile(double p) const;
+    };
+    Snapshot drain();
+
+private:
+    static int bucket_index(uint64_t value);
+    static uint64_t bucket_upper(int index);
+
+    std::atomic<uint64_t> buckets_[kBuckets];
+    std::atomic<uint64_t> max_;
+};
+
+inline uint64_t trace_now_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+extern std::atomic<bool> trace_spans_enabled;
+
+// Место измерения: имя и гистограмма длительностей в наносекундах. Сводка и
+// трасса различают места только по имени, поэтому имя должно быть уникальным
+// (разные пути одной функции - "process_frame.yuv", "redraw_frame.in_place")
+class TraceSite {
+public:
+    explicit TraceSite(const char *name);
+
+    const char *name() const { return name_; }
+    void record(uint64_t start_ns, uint64_t duration_ns);
+
+    LogHistogram &histogram() { return histogram_; }
+    uint64_t total() const { return total_.load(std::memory_order_relaxed); }
+
+private:
+    const char *name_;
+    LogHistogram histogram_;
+    std::atomic<uint64_t> total_;
+};
+
+class ScopedSpan {
+public:
+    explicit ScopedSpan(TraceSite &site)
+        : site_(site), start_(trace_spans_enabled.load(std::memory_order_relaxed) ? trace_now_ns() : 0) {}
+
+    ~ScopedSpan() {
+        if (start_) {
+            site_.record(start_, trace_now_ns() - start_);
+        }
+    }
+
+    ScopedSpan(const ScopedSpan &) = delete;
+    ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+private:
+    TraceSite &site_;
+    uint64_t start_;
+};
+
+#define VIDSTREAM_TRACE_CONCAT_(a, b) a##b
+#define VIDSTREAM_TRACE_CONCAT(a, b) VIDSTREAM_TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name)                                                                 \
+    static TraceSite VIDSTREAM_TRACE_CONCAT(trace_site_, __LINE__)(name);                \
+    ScopedSpan VIDSTREAM_TRACE_CONCAT(trace_span_, __LINE__)(VIDSTREAM_TRACE_CONCAT(trace_site_, __LINE__))
+
+// Имя текущего потока в трассе
+void trace_set_thread_name(const std::string &name);
+
+// Строка в кавычках для JSON трассы и результатов бенчмарков
+void write_json_string(std::ostream &out, const std::string &value);
+
+struct InstrumentationConfig {
+    std::string trace_path;       // пусто - трасса не пишется
+    double trace_start = 0;       // начало окна трассы, с от запуска
+    double trace_seconds = 5;     // длительность окна трассы
+    std::string stats_path;       // пусто - файл сводки не пишется
+    int stats_port = 0;           // 0 - HTTP-сводка выключена
+    double stats_interval = 1;    // период снятия гистограмм, с
+
+    bool enabled() const { return !trace_path.empty() || !stats_path.empty() || stats_port > 0; }
+};
+
+class Instrumentation {
+public:
+    typedef std::function<int64_t()> GaugeReader;
+
+    explicit Instrumentation(const InstrumentationConfig &config);
+    ~Instrumentation();
+
+    Instrumentation(const Instrumentation &) = delete;
+    Instrumentation &operator=(const Instrumentation &) = delete;
+
+    // Показатель, читаемый потоком сводки раз в интервал (счётчики кадров,
+    // уровень очереди appsrc и т.п.). Читатели удаляются clear_gauges()
+    // до того, как станут недействительны объекты, на которые они ссылаются.
+    void add_gauge(const std::string &name, GaugeReader reader);
+    void clear_gauges();
+
+    void start();
+    void stop();
+
+    // Последняя сводка в текстовом виде
+    std::string snapshot() const;
+
+private:
+    void stats_loop();
+    void serve_loop();
+    void update_snapshot();
+    void write_stats_file(const std::string &text);
+    void write_trace();
+
+    InstrumentationConfig config_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::pair<std::string, GaugeReader>> gauges_;
+    std::string snapshot_;
+
+    std::atomic<bool> running_;
+    std::thread stats_thread_;
+    std::thread serve_thread_;
+    int listen_fd_;
+
+    uint64_t start_ns_;
+    bool trace_written_;
+};
+
+#endif // VIDSTREAM_INSTRUMENTATION_HPP
@@ -0,0 +1,180 @@
+#include "latency_probe.hpp"
+
+#include <algorithm>
+
+// Записи кадров, не дошедших до udpsink (выброшены очередью или кодером),
+// удаляются, когда становятся старше этого срока
+static const GstClockTime kPendingTimeout = 2 * GST_SECOND;
+
+void LatencyProbe::Histogram::add(int64_t us) {
+    int64_t bucket = std::max<int64_t>(0, us) / kBucketUs;
+    buckets[std::min<int64_t>(bucket, kBuckets - 1)]++;
+    ++count;
+    max = std::max(max, us);
+}
+
+LatencySummary LatencyProbe::Histogram::summary() const {
+    LatencySummary result;
+    result.count = count;
+    result.max = max;
+    if (count == 0) {
+        return result;
+    }
+
+    // Процентиль - верхняя граница корзины, в которую он попал
+    uint64_t p50_rank = (count + 1) / 2;
+    uint64_t p99_rank = std::max<uint64_t>(1, (count * 99 + 99) / 100);
+    uint64_t seen = 0;
+    bool have_p50 = false;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (!have_p50 && seen >= p50_rank) {
+            result.p50 = std::min<int64_t>((int64_t)(i + 1) * kBucketUs, max);
+            have_p50 = true;
+        }
+        if (seen >= p99_rank) {
+            result.p99 = std::min<int64_t>((int64_t)(i + 1) * kBucketUs, max);
+            break;
+        }
+    }
+    return result;
+}
+
+LatencyProbe::LatencyProbe() : clock_(gst_system_clock_obtain()) {
+}
+
+LatencyProbe::~LatencyProbe() {
+    gst_object_unref(clock_);
+}
+
+GstClockTime LatencyProbe::capture_time(GstElement *element, GstBuffer *buffer) {
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(pts)) {
+        return GST_CLOCK_TIME_NONE;
+    }
+    return pts + gst_element_get_base_time(element);
+}
+
+static int64_t interval_us(GstClockTime from, GstClockTime to) {
+    return GST_CLOCK_DIFF(from, to) / (int64_t)GST_USECOND;
+}
+
+void LatencyProbe::mark(GstClockTime capture, LatencyStage stage) {
+    if (!GST_CLOCK_TIME_IS_VALID(capture)) {
+        return;
+    }
+
+    GstClockTime now = gst_clock_get_time(clock_);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::map<GstClockTime, Pending>::iterator it = pending_.find(capture);
+
+    switch (stage) {
+        case LatencyStage::Processed:
+            if (it != pending_.end()) {
+                return;
+            }
+            pending_[capture].processed = now;
+            to_processed_.add(interval_us(capture, now));
+
+            // Ключи упорядочены по времени захвата: старые записи в начале
+            while (!pending_.empty() && capture > pending_.begin()->first + kPendingTimeout) {
+                pending_.erase(pending_.begin());
+            }
+            break;
+
+        case LatencyStage::Pushed:
+            if (it == pending_.end() || GST_CLOCK_TIME_IS_VALID(it->second.pushed)) {
+                return;
+            }
+            it->second.pushed = now;
+            to_pushed_.add(interval_us(capture, now));
+            processed_to_pushed_.add(interval_us(it->second.processed, now));
+            break;
+
+        case LatencyStage::Sent:
+            if (it == pending_.end()) {
+                return;
+            }
+            to_sent_.add(interval_us(capture, now));
+            if (GST_CLOCK_TIME_IS_VALID(it->second.pushed)) {
+                pushed_to_sent_.add(interval_us(it->second.pushed, now));
+            }
+            pending_.erase(it);
+            break;
+    }
+}
+
+GstPadProbeReturn LatencyProbe::on_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data) {
+    ProbeData *probe_data = static_cast<ProbeData *>(data);
+    GstBuffer *buffer = nullptr;
+
+    // rtph264pay отправляет фрагменты кадра списком буферов
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        if (gst_buffer_list_length(list) > 0) {
+            buffer = gst_buffer_list_get(list, 0);
+        }
+    }
+
+    GstElement *element = GST_ELEMENT(GST_PAD_PARENT(pad));
+    if (buffer && element) {
+        probe_data->probe->mark(capture_time(element, buffer), probe_data->stage);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+void LatencyProbe::free_probe_data(gpointer data) {
+    delete static_cast<ProbeData *>(data);
+}
+
+void LatencyProbe::attach(GstElement *element, const char *pad_name, LatencyStage stage) {
+    GstPad *pad = gst_element_get_static_pad(element, pad_name);
+    if (!pad) {
+        return;
+    }
+
+    ProbeData *data = new ProbeData();
+    data->probe = this;
+    data->stage = stage;
+
+    gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                      on_pad_probe, data, free_probe_data);
+    gst_object_unref(pad);
+}
+
+LatencySummary LatencyProbe::summary(LatencyStage from_capture_to) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    switch (from_capture_to) {
+        case LatencyStage::Processed:
+            return to_processed_.summary();
+        case LatencyStage::Pushed:
+            return to_pushed_.summary();
+        case LatencyStage::Sent:
+            return to_sent_.summary();
+    }
+    return LatencySummary();
+}
+
+static void print_line(std::ostream &out, const char *name, const LatencySummary &s) {
+    out << "  " << name << ": кадров " << s.count
+        << ", p50 " << s.p50 / 1000.0 << " мс"
+        << ", p99 " << s.p99 / 1000.0 << " мс"
+        << ", max " << s.max / 1000.0 << " мс" << std::endl;
+}
+
+void LatencyProbe::print(std::ostream &out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    out << "Задержка от захвата:" << std::endl;
+    print_line(out, "захват -> обработка", to_processed_.summary());
+    print_line(out, "захват -> кодер", to_pushed_.summary());
+    print_line(out, "захват -> UDP", to_sent_.summary());
+    print_line(out, "обработка -> кодер", processed_to_pushed_.summary());
+    print_line(out, "кодер -> UDP", pushed_to_sent_.summary());
+}
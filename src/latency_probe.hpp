@@ -0,0 +1,95 @@
+#ifndef VIDSTREAM_LATENCY_PROBE_HPP
+#define VIDSTREAM_LATENCY_PROBE_HPP
+
+#include <gst/gst.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Стадии, которые проходит кадр после захвата
+enum class LatencyStage {
+    Processed,  // обработка завершена
+    Pushed,     // кадр передан кодеру (appsrc или вход x264enc)
+    Sent        // первый RTP-пакет кадра дошёл до udpsink
+};
+
+// Сводка по одному интервалу, в микросекундах
+struct LatencySummary {
+    uint64_t count = 0;
+    int64_t p50 = 0;
+    int64_t p99 = 0;
+    int64_t max = 0;
+};
+
+// Измерение задержки "от стекла до UDP". Кадр опознаётся по моменту
+// захвата на системных часах GStreamer (PTS буфера + base time конвейера),
+// поэтому отметки из разных конвейеров и потоков сопоставляются без
+// дополнительных метаданных. Оба конвейера должны использовать
+// gst_system_clock_obtain(). Интервалы копятся в гистограммах с шагом
+// 100 мкс, так что память не растёт со временем работы.
+class LatencyProbe {
+public:
+    LatencyProbe();
+    ~LatencyProbe();
+
+    LatencyProbe(const LatencyProbe &) = delete;
+    LatencyProbe &operator=(const LatencyProbe &) = delete;
+
+    // Момент захвата буфера, прошедшего через элемент element
+    static GstClockTime capture_time(GstElement *element, GstBuffer *buffer);
+
+    // Отметка стадии для кадра, захваченного в момент capture_time.
+    // Processed открывает запись кадра, остальные стадии её дополняют;
+    // Sent закрывает запись, повторные отметки кадра игнорируются.
+    void mark(GstClockTime capture_time, LatencyStage stage);
+
+    // Пад-проба, отмечающая стадию для каждого буфера на паде pad_name
+    void attach(GstElement *element, const char *pad_name, LatencyStage stage);
+
+    LatencySummary summary(LatencyStage from_capture_to) const;
+    void print(std::ostream &out) const;
+
+private:
+    static const int kBucketUs = 100;
+    static const int kBuckets = 20000;  // до 2 с, дальше - последняя корзина
+
+    struct Histogram {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        int64_t max = 0;
+
+        Histogram() : buckets(kBuckets, 0) {}
+        void add(int64_t us);
+        LatencySummary summary() const;
+    };
+
+    struct Pending {
+        GstClockTime processed = GST_CLOCK_TIME_NONE;
+        GstClockTime pushed = GST_CLOCK_TIME_NONE;
+    };
+
+    struct ProbeData {
+        LatencyProbe *probe;
+        LatencyStage stage;
+    };
+
+    static GstPadProbeReturn on_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static void free_probe_data(gpointer data);
+
+    GstClock *clock_;
+
+    mutable std::mutex mutex_;
+    std::map<GstClockTime, Pending> pending_;
+
+    // От захвата до каждой стадии и между соседними стадиями
+    Histogram to_processed_;
+    Histogram to_pushed_;
+    Histogram to_sent_;
+    Histogram processed_to_pushed_;
+    Histogram pushed_to_sent_;
+};
+
+#endif // VIDSTREAM_LATENCY_PROBE_HPP
@@ -1,13 +1,41 @@
 #include <opencv2/core.hpp>
-#include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/videoio.hpp>
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
 #include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
+#include <glib-unix.h>
 
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "adaptive_controller.hpp"
+#include "batch_runner.hpp"
+#include "control_server.hpp"
+#include "cv_filter.hpp"
+#include "edge_engine.hpp"
+#include "event_recorder.hpp"
+#include "frame_executor.hpp"
+#include "gst_convert.hpp"
+#include "instrumentation.hpp"
+#include "latency_probe.hpp"
+#include "metadata_output.hpp"
+#include "preview.hpp"
+#include "processing.hpp"
+#include "shm_output.hpp"
+#include "stream_config.hpp"
+#include "stage_graph.hpp"
+#include "stream_tuner.hpp"
+#include "udp_fanout.hpp"
+#include "worker_scheduler.hpp"
 
 using namespace cv;
 
@@ -27,9 +55,25 @@ typedef struct _DstData {
     GstElement* convert;
     GstElement* encoder;
     GstElement* payloader;
-    GstElement* udpsink;
 } DstData;
 
+// Структура для единого конвейера с обработкой внутри GStreamer
+typedef struct _FilterData {
+    GstElement* pipeline;
+    GstElement* source;
+    GstElement* convert;
+    GstElement* scale;
+    GstElement* capsfilter;
+    GstElement* process_queue;
+    GstElement* filter;
+    GstElement* encode_queue;
+    GstElement* encode_convert;
+    GstElement* encoder;
+    GstElement* payloader;
+    GstElement* sink;  // без видео: кадры после обработки сбрасываются
+    gint frames_dropped;  // выброшено очередью перед обработкой; g_atomic_int_*
+} FilterData;
+
 GMainLoop *main_loop = nullptr;
 
 // Обработчик сообщений из шины GStreamer
@@ -57,281 +101,813 @@ static gboolean bus_callback(GstBus *bus, GstMessage *message, gpointer data) {
     return TRUE;
 }
 
-// Функция для преобразования Mat в GstBuffer
-GstBuffer *mat_to_gst_buffer(const Mat &frame) {
-    gsize size = frame.step[0] * frame.rows;
+// Завершение по SIGINT/SIGTERM через главный цикл
+static gboolean quit_on_signal(gpointer data) {
+    GMainLoop *loop = (GMainLoop*)data;
+    std::cout << "Получен сигнал завершения" << std::endl;
+    g_main_loop_quit(loop);
+    return G_SOURCE_CONTINUE;
+}
 
-    GstBuffer *buffer = gst_buffer_new_allocate(NULL, size, NULL);
+// Формат кадров для обработки: BGR совпадает с раскладкой OpenCV,
+// поэтому кадры обрабатываются без копирования; I420 и NV12 обрабатываются
+// по планам и уходят в кодер без преобразования цвета
+static GstCaps *make_frame_caps(const std::string &format, const StreamConfig &stream) {
+    return gst_caps_new_simple("video/x-raw",
+                               "format", G_TYPE_STRING, format.c_str(),
+                               "width", G_TYPE_INT, stream.width,
+                               "height", G_TYPE_INT, stream.height,
+                               "framerate", GST_TYPE_FRACTION, 30, 1,
+                               NULL);
+}
 
-    if (!buffer) {
-        std::cerr << "Couldn't create buffer!" << std::endl;
-        return nullptr;
+static EncoderSettings encoder_settings(const StreamConfig &stream) {
+    EncoderSettings settings;
+    settings.bitrate = stream.bitrate;
+    settings.speed_preset = stream.speed_preset;
+    settings.tune = stream.tune;
+    return settings;
+}
+
+static bool configure_stream_encoder(GstElement *encoder, const StreamConfig &stream) {
+    std::string error;
+    if (!configure_encoder(encoder, encoder_settings(stream), error)) {
+        std::cerr << "Кодер потока " << stream.name << ": " << error << std::endl;
+        return false;
     }
+    return true;
+}
 
-    GstMapInfo map;
+static void configure_source(GstElement *source, const StreamConfig &stream) {
+    g_object_set(G_OBJECT(source), "device", stream.device.c_str(), NULL);
+}
 
-    if (!gst_buffer_map(buffer, &map, GST_MAP_WRITE)) {
-        std::cerr << "Couldn't map buffer!" << std::endl;
-        return nullptr;
+
+// Все конвейеры работают на системных часах: метки времени разных
+// конвейеров сопоставимы, а задержка меряется по тем же часам
+static void use_system_clock(GstElement *pipeline) {
+    GstClock *clock = gst_system_clock_obtain();
+    gst_pipeline_use_clock(GST_PIPELINE(pipeline), clock);
+    gst_object_unref(clock);
+}
+
+// Политика переполнения очереди перед обработкой в терминах GstQueue::leaky
+static gint queue_leaky_mode(DropPolicy policy) {
+    switch (policy) {
+        case DropPolicy::DropOldest:
+            return 2; // downstream: выбрасываются старые буферы
+        case DropPolicy::DropNewest:
+            return 1; // upstream: выбрасываются новые буферы
+        case DropPolicy::Block:
+            return 0; // без потерь, давление на источник
     }
+    return 0;
+}
 
-    if (frame.isContinuous()) {
-        memcpy(map.data, frame.data, size);
-    } else {
-        size_t row_size = frame.cols * frame.elemSize();
-        for (int i = 0; i < frame.rows; ++i) {
-            memcpy(map.data + i * row_size, frame.ptr(i), row_size);
+// Очередь перед обработкой заполнена: с leaky она выбрасывает один кадр
+// (новый или самый старый), иначе ждёт места
+static void count_queue_overrun(GstElement *, gpointer data) {
+    g_atomic_int_inc(static_cast<gint *>(data));
+}
+
+// Общие для всех потоков настройки и службы процесса
+struct RunContext {
+    ExecutorConfig executor;
+    std::string format;
+    WorkerScheduler *scheduler;
+    Preview *preview;  // показывает первый поток
+    LatencyProbe *latency;
+    Instrumentation *instrumentation;
+    ControlServer *control;
+    AdaptiveConfig adaptive;  // настройки регулятора; битрейт без нагрузки - у потока
+    bool adaptive_enabled;
+    bool incremental;
+    bool video;  // кодировать и отправлять видео H.264
+    int analysis_level;  // уровень анализа cvfilter; -1 - по бюджету кадра
+    bool output_blur;  // размывать кадр и на уровнях выше 0
+    guint64 analysis_budget;  // бюджет кадра для автовыбора, нс; 0 - интервал кадров
+    ContourPacketParams metadata;  // кодирование контуров для metadata_receivers
+    uint32_t shm_slots;  // слотов в кольце кадров в разделяемой памяти; 0 - без него
+    bool record;  // держать предзапись H.264 и записывать события в файлы
+    RecorderConfig recorder;
+    double spike_ratio;  // событие при всплеске числа контуров; 0 - только по команде
+};
+
+// Регулятор нагрузки потока; fill - заполненность очереди перед кодером
+static AdaptiveController *make_adaptive_controller(const StreamConfig &stream, const RunContext &ctx,
+                                                    GstElement *encoder, AdaptiveController::FillReader fill) {
+    AdaptiveConfig config = ctx.adaptive;
+    config.bitrate = stream.bitrate;
+    config.min_bitrate = std::min(config.min_bitrate, config.bitrate);
+    AdaptiveController *controller = new AdaptiveController(stream.name, config);
+    controller->set_fill_reader(fill);
+    controller->attach_encoder(encoder);
+    return controller;
+}
+
+static void add_adaptive_gauges(Instrumentation *instrumentation, const StreamConfig &stream,
+                                AdaptiveController *controller) {
+    instrumentation->add_gauge(stream.name + ".adaptive_level", [controller]() { return (int64_t)controller->level(); });
+    instrumentation->add_gauge(stream.name + ".adaptive_transitions", [controller]() { return (int64_t)controller->transitions(); });
+    instrumentation->add_gauge(stream.name + ".bitrate_kbps", [controller]() { return (int64_t)controller->bitrate(); });
+    instrumentation->add_gauge(stream.name + ".frames_skipped", [controller]() { return (int64_t)controller->skipped(); });
+    instrumentation->add_gauge(stream.name + ".frames_dropped_encode", [controller]() { return (int64_t)controller->dropped(); });
+}
+
+// Команды канала управления для получателей потоков; раздача контуров
+// потока называется "<поток>.meta"
+static void add_receiver_commands(ControlServer *control, const std::map<std::string, UdpFanout *> &by_name) {
+    auto change = [by_name](const std::vector<std::string> &args, bool add) -> std::string {
+        Receiver receiver;
+        if (args.size() != 2 || !parse_receiver(args[1], receiver)) {
+            return "error: ожидается STREAM HOST:PORT\n";
+        }
+        auto it = by_name.find(args[0]);
+        if (it == by_name.end()) {
+            return "error: нет потока " + args[0] + "\n";
+        }
+        std::string error;
+        bool changed = add ? it->second->add(receiver, error) : it->second->remove(receiver, error);
+        return changed ? "ok\n" : "error: " + error + "\n";
+    };
+    
+    control->add_command("add", "STREAM HOST:PORT - добавить получателя потока (STREAM.meta - получателя контуров)",
+                         [change](const std::vector<std::string> &args) { return change(args, true); });
+    control->add_command("remove", "STREAM HOST:PORT - удалить получателя потока",
+                         [change](const std::vector<std::string> &args) { return change(args, false); });
+    control->add_command("list", "[STREAM] - получатели потоков", [by_name](const std::vector<std::string> &args) {
+        std::string text;
+        for (const auto &entry : by_name) {
+            if (!args.empty() && args[0] != entry.first) {
+                continue;
+            }
+            text += entry.first;
+            for (const Receiver &receiver : entry.second->receivers()) {
+                text += " " + receiver_to_string(receiver);
+            }
+            text += "\n";
         }
+        return text;
+    });
+}
+
+// "WxH", например "1920x1080"
+static bool parse_resolution(const std::string &text, int &width, int &height) {
+    char *end = nullptr;
+    long w = std::strtol(text.c_str(), &end, 10);
+    if (*end != 'x') {
+        return false;
     }
+    long h = std::strtol(end + 1, &end, 10);
+    if (*end != '\0' || w <= 0 || h <= 0 || w > 16384 || h > 16384) {
+        return false;
+    }
+    width = (int)w;
+    height = (int)h;
+    return true;
+}
 
-    gst_buffer_unmap(buffer, &map);
-    return buffer;
+// Целое число без знака
+static bool parse_count(const std::string &text, int &value) {
+    char *end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || parsed < 0 || parsed > 1000000) {
+        return false;
+    }
+    value = (int)parsed;
+    return true;
+}
+
+// Пороги краёв "LOW:HIGH"
+static bool parse_edge_thresholds(const std::string &text, int &low, int &high) {
+    size_t colon = text.find(':');
+    return colon != std::string::npos && parse_count(text.substr(0, colon), low) &&
+           parse_count(text.substr(colon + 1), high) && low <= high && high <= kMaxEdgeThreshold;
+}
+
+// Команды канала управления для настроек потоков на ходу, без перезапуска
+// конвейеров
+static void add_tuning_commands(ControlServer *control, const std::map<std::string, StreamTuner *> &by_name) {
+    control->add_command("set", "STREAM bitrate KBPS | speed-preset NAME | tune NAME | edges LOW HIGH | stages LIST | resolution WxH"
+                         " - изменить настройку потока на ходу",
+                         [by_name](const std::vector<std::string> &args) -> std::string {
+        if (args.size() < 3) {
+            return "error: ожидается STREAM ПАРАМЕТР ЗНАЧЕНИЕ\n";
+        }
+        auto it = by_name.find(args[0]);
+        if (it == by_name.end()) {
+            return "error: нет потока " + args[0] + "\n";
+        }
+        StreamTuner *tuner = it->second;
+        const std::string &key = args[1];
+        std::string error = "неверное значение " + key;
+        bool changed = false;
+        int first = 0, second = 0;
+        if (key == "bitrate" && args.size() == 3) {
+            changed = parse_count(args[2], first) && tuner->set_bitrate(first, error);
+        } else if (key == "speed-preset" && args.size() == 3) {
+            changed = tuner->set_speed_preset(args[2], error);
+        } else if (key == "tune" && args.size() == 3) {
+            changed = tuner->set_tune(args[2], error);
+        } else if (key == "edges" && args.size() == 4) {
+            changed = parse_count(args[2], first) && parse_count(args[3], second) &&
+                      tuner->set_edge_thresholds(first, second, error);
+        } else if (key == "stages" && args.size() == 3) {
+            changed = tuner->set_stages(args[2], error);
+        } else if (key == "resolution" && args.size() == 3) {
+            changed = parse_resolution(args[2], first, second) && tuner->set_resolution(first, second, error);
+        } else {
+            error = "неизвестный параметр " + key;
+        }
+        return changed ? "ok\n" : "error: " + error + "\n";
+    });
+    control->add_command("get", "[STREAM] - текущие настройки потоков", [by_name](const std::vector<std::string> &args) {
+        std::string text;
+        for (const auto &entry : by_name) {
+            if (!args.empty() && args[0] != entry.first) {
+                continue;
+            }
+            text += entry.first + " " + entry.second->describe() + "\n";
+        }
+        return text;
+    });
 }
 
-// Функция для преобразования Mat в GstSample
-GstSample *mat_to_gst_sample(const Mat &frame, GstCaps *caps) {
-    GstBuffer *buffer = mat_to_gst_buffer(frame);
+static void add_fanout_gauge(Instrumentation *instrumentation, const std::string &name, UdpFanout *fanout) {
+    instrumentation->add_gauge(name + ".receivers", [fanout]() { return (int64_t)fanout->receivers().size(); });
+}
+
+static std::string metadata_name(const StreamConfig &stream) {
+    return stream.name + ".meta";
+}
 
-    if (!buffer) {
+// Кольцо кадров потока в разделяемой памяти на паде pad_name элемента;
+// nullptr - кольцо не подключено, поток работает без него
+static ShmOutput *make_shm_output(const StreamConfig &stream, const RunContext &ctx,
+                                  GstElement *element, const char *pad_name) {
+    ShmOutput *output = new ShmOutput(shm_ring_name(stream.name), ctx.shm_slots);
+    if (!output->attach(element, pad_name)) {
+        std::cerr << "Не удалось подключить кольцо кадров " << output->name() << std::endl;
+        delete output;
         return nullptr;
     }
+    std::cout << stream.name << ": кадры в разделяемой памяти " << output->name() << std::endl;
+    return output;
+}
 
-    GstClockTime timestamp = gst_util_get_timestamp();
+static void add_shm_gauges(Instrumentation *instrumentation, const StreamConfig &stream, ShmOutput *output) {
+    instrumentation->add_gauge(stream.name + ".shm_frames", [output]() { return (int64_t)output->frames(); });
+}
 
-    GST_BUFFER_PTS(buffer) = timestamp;
-    GST_BUFFER_DTS(buffer) = timestamp;
+static void add_recorder_gauges(Instrumentation *instrumentation, const StreamConfig &stream, EventRecorder *recorder) {
+    instrumentation->add_gauge(stream.name + ".record_buffered_bytes", [recorder]() { return (int64_t)recorder->buffered_bytes(); });
+    instrumentation->add_gauge(stream.name + ".recordings", [recorder]() { return (int64_t)recorder->recordings(); });
+    instrumentation->add_gauge(stream.name + ".recordings_failed", [recorder]() { return (int64_t)recorder->failed(); });
+}
 
-    GstSample *sample = gst_sample_new(buffer, caps, NULL, NULL);
+// Команда записи события по имени потока
+static void add_record_command(ControlServer *control, const std::map<std::string, EventRecorder *> &by_name) {
+    control->add_command("record", "STREAM [ПРИЧИНА] - записать предзапись и послезапись потока в файл",
+                         [by_name](const std::vector<std::string> &args) -> std::string {
+        if (args.empty()) {
+            return "error: ожидается STREAM [ПРИЧИНА]\n";
+        }
+        auto it = by_name.find(args[0]);
+        if (it == by_name.end()) {
+            return "error: нет записи потока " + args[0] + "\n";
+        }
+        std::string reason = "команда";
+        for (size_t i = 1; i < args.size(); ++i) {
+            reason += (i == 1 ? ": " : " ") + args[i];
+        }
+        return it->second->trigger(reason) ? "ok\n" : "error: событие пропущено\n";
+    });
+}
 
-    gst_buffer_unref(buffer);
+// Событие записи при всплеске числа контуров; состояние общее для копий обработчика
+static std::function<void(size_t)> make_spike_observer(const RunContext &ctx, EventRecorder *recorder) {
+    if (!recorder || ctx.spike_ratio <= 0) {
+        return std::function<void(size_t)>();
+    }
+    std::shared_ptr<ContourSpikeTrigger> spike = std::make_shared<ContourSpikeTrigger>(ctx.spike_ratio);
+    return [spike, recorder](size_t contours) {
+        if (spike->observe(contours)) {
+            recorder->trigger("контуров " + std::to_string(contours) + " при среднем " +
+                              std::to_string((int)spike->average()));
+        }
+    };
+}
 
-    return sample;
+static void add_metadata_gauges(Instrumentation *instrumentation, const StreamConfig &stream, MetadataOutput *metadata) {
+    std::string name = metadata_name(stream);
+    instrumentation->add_gauge(name + ".frames", [metadata]() { return (int64_t)metadata->frames(); });
+    instrumentation->add_gauge(name + ".bytes", [metadata]() { return (int64_t)metadata->bytes(); });
+    add_fanout_gauge(instrumentation, name, &metadata->fanout());
 }
 
-// Функция для преобразования GstSample в Mat
-Mat gst_sample_to_mat(GstSample* sample) {
-    GstBuffer* buffer = gst_sample_get_buffer(sample);
-    GstMapInfo map;
+// Единый конвейер потока: обработка выполняется элементом cvfilter,
+// очереди разделяют захват, обработку и кодирование по потокам.
+// Без видео (ctx.video) ветки кодирования нет, кадры после обработки
+// сбрасываются; metadata, если задан, отправляет контуры кадров, recorder
+// держит предзапись выхода кодера.
+static bool build_filter_stream(const StreamConfig &stream, const RunContext &ctx, bool with_preview,
+                                FilterData &data, UdpFanout &fanout, MetadataOutput *metadata,
+                                EventRecorder *recorder) {
+    // x264enc принимает I420 и NV12 напрямую, преобразование нужно только для BGR
+    bool needs_encode_convert = ctx.video && ctx.format == "BGR";
+    
+    data.pipeline = gst_pipeline_new(stream.name.c_str());
+    data.source = gst_element_factory_make("v4l2src", "cv_source");
+    data.convert = gst_element_factory_make("videoconvert", "cv_convert");
+    data.scale = gst_element_factory_make("videoscale", "cv_scale");
+    data.capsfilter = gst_element_factory_make("capsfilter", "cv_caps");
+    data.process_queue = gst_element_factory_make("queue", "cv_process_queue");
+    data.filter = gst_element_factory_make("cvfilter", "cv_filter");
+    data.encode_queue = ctx.video ? gst_element_factory_make("queue", "cv_encode_queue") : nullptr;
+    data.encode_convert = needs_encode_convert ? gst_element_factory_make("videoconvert", "cv_encode_convert") : nullptr;
+    data.encoder = ctx.video ? gst_element_factory_make("x264enc", "cv_encoder") : nullptr;
+    data.payloader = ctx.video ? gst_element_factory_make("rtph264pay", "cv_payloader") : nullptr;
+    data.sink = ctx.video ? nullptr : gst_element_factory_make("fakesink", "cv_sink");
     
-    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
-        std::cerr << "Cannot map gstreamer buffer" << std::endl;
-        return Mat();
+    bool created = data.pipeline && data.source && data.convert && data.scale && data.capsfilter &&
+                   data.process_queue && data.filter;
+    if (ctx.video) {
+        created = created && data.encode_queue && (!needs_encode_convert || data.encode_convert) &&
+                  data.encoder && data.payloader && fanout.create(GST_BIN(data.pipeline), stream);
+    } else {
+        created = created && data.sink;
+    }
+    if (created && metadata) {
+        created = metadata->create(GST_BIN(data.pipeline), stream);
+    }
+    if (!created) {
+        std::cerr << "Не удалось создать элементы конвейера " << stream.name << "!" << std::endl;
+        return false;
     }
     
-    GstCaps* caps = gst_sample_get_caps(sample);
-    GstStructure* structure = gst_caps_get_structure(caps, 0);
+    GstCaps *caps = make_frame_caps(ctx.format, stream);
+    g_object_set(G_OBJECT(data.capsfilter), "caps", caps, NULL);
+    gst_caps_unref(caps);
     
-    int width, height;
-    gst_structure_get_int(structure, "width", &width);
-    gst_structure_get_int(structure, "height", &height);
-
-    const char* format = gst_structure_get_string(structure, "format");
-    int type;
-
-    if (g_str_equal(format, "RGB")) {
-        type = CV_8UC3;
-    } else if (g_str_equal(format, "BGR")) {
-        type = CV_8UC3;
-    } else if (g_str_equal(format, "RGBA")) {
-        type = CV_8UC4;
-    } else if (g_str_equal(format, "BGRA")) {
-        type = CV_8UC4;
-    } else if (g_str_equal(format, "GRAY8")) {
-        type = CV_8UC1;
+    // Очередь перед обработкой ограничена числом кадров и ведёт себя
+    // согласно политике переполнения
+    g_object_set(G_OBJECT(data.process_queue),
+                 "max-size-buffers", (guint)ctx.executor.queue_capacity,
+                 "max-size-bytes", 0,
+                 "max-size-time", (guint64)0,
+                 "leaky", queue_leaky_mode(ctx.executor.drop_policy),
+                 NULL);
+    data.frames_dropped = 0;
+    if (ctx.executor.drop_policy != DropPolicy::Block) {
+        g_signal_connect(data.process_queue, "overrun", G_CALLBACK(count_queue_overrun), &data.frames_dropped);
+    }
+    if (ctx.video) {
+        g_object_set(G_OBJECT(data.encode_queue),
+                     "max-size-buffers", (guint)ctx.executor.queue_capacity,
+                     "max-size-bytes", 0,
+                     "max-size-time", (guint64)0,
+                     NULL);
+        if (!configure_stream_encoder(data.encoder, stream)) {
+            return false;
+        }
     } else {
-        type = CV_8UC3;
+        g_object_set(G_OBJECT(data.sink), "sync", FALSE, NULL);
     }
-
-    Mat frame(height, width, type, (void*)map.data);
-
-    if (g_str_equal(format, "RGB")) {
-        cvtColor(frame, frame, COLOR_RGB2BGR);
+    
+    configure_source(data.source, stream);
+    g_object_set(G_OBJECT(data.filter),
+                 // Нестандартный граф обрабатывает кадр целиком
+                 "incremental", (gboolean)(ctx.incremental && stream.stages == standard_stages()),
+                 "analysis-level", (gint)ctx.analysis_level,
+                 "analysis-budget", (guint64)ctx.analysis_budget,
+                 "output-blur", (gboolean)ctx.output_blur,
+                 "low-threshold", (gint)stream.low_threshold,
+                 "high-threshold", (gint)stream.high_threshold,
+                 "stages", stream.stages.c_str(),
+                 NULL);
+    use_system_clock(data.pipeline);
+    
+    if (ctx.latency) {
+        ctx.latency->attach(data.filter, "src", LatencyStage::Processed);
+        if (ctx.video) {
+            ctx.latency->attach(data.encoder, "sink", LatencyStage::Pushed);
+            ctx.latency->attach(fanout.sink(), "sink", LatencyStage::Sent);
+        }
     }
-
-    Mat result = frame.clone();
-
-    gst_buffer_unmap(buffer, &map);
     
-    return result;
-}
-
-// Функция для обработки кадров с помощью OpenCV
-Mat process_frame(const Mat &input_frame) {
-    if(input_frame.empty()) {
-        std::cerr << "Error: Empty input frame" << std::endl;
-        return Mat();
+    if (recorder) {
+        recorder->attach(data.encoder, "src");
     }
-
-    Mat processed_frame;
     
-    // Делаем копию входного кадра для обработки
-    processed_frame = input_frame.clone();
+    std::function<void(size_t)> spike = make_spike_observer(ctx, recorder);
+    if (metadata || spike) {
+        cv_filter_set_contours_callback(data.filter, [metadata, spike](const FlatContours &contours, GstClockTime pts, Size size) {
+            if (metadata) {
+                metadata->push(contours, pts, size);
+            }
+            if (spike) {
+                spike(contours.size());
+            }
+        });
+    }
     
-    // Применяем размытие по Гауссу
-    GaussianBlur(processed_frame, processed_frame, Size(5, 5), 1.5);
+    if (with_preview && ctx.preview) {
+        // Копия делается только когда предпросмотр готов принять кадр
+        Preview *preview = ctx.preview;
+        cv_filter_set_frame_callback(data.filter, [preview](const Mat &frame) {
+            if (preview->needs_frame()) {
+                Mat copy = egress_frame_pool().acquire(frame.rows, frame.cols, frame.type());
+                frame.copyTo(copy);
+                preview->publish(copy);
+            }
+        });
+    }
     
-    // Обнаружение краев с помощью Canny
-    Mat edges;
-    Canny(processed_frame, edges, 100, 200);
+    gst_bin_add_many(GST_BIN(data.pipeline), data.source, data.convert, data.scale, data.capsfilter,
+                     data.process_queue, data.filter, NULL);
+    bool linked = gst_element_link_many(data.source, data.convert, data.scale, data.capsfilter,
+                                        data.process_queue, data.filter, NULL);
     
-    // Поиск контуров
-    std::vector<std::vector<Point>> contours;
-    findContours(edges, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+    if (ctx.video) {
+        gst_bin_add_many(GST_BIN(data.pipeline), data.encode_queue, data.encoder, data.payloader, NULL);
+        // Между очередью кодирования и кодером videoconvert стоит только для BGR
+        if (data.encode_convert) {
+            gst_bin_add(GST_BIN(data.pipeline), data.encode_convert);
+            linked = linked && gst_element_link_many(data.filter, data.encode_queue, data.encode_convert,
+                                                     data.encoder, NULL);
+        } else {
+            linked = linked && gst_element_link_many(data.filter, data.encode_queue, data.encoder, NULL);
+        }
+        linked = linked && gst_element_link_many(data.encoder, data.payloader, fanout.input(), NULL);
+    } else {
+        gst_bin_add(GST_BIN(data.pipeline), data.sink);
+        linked = linked && gst_element_link(data.filter, data.sink);
+    }
     
-    // Рисуем контуры на исходном изображении
-    drawContours(processed_frame, contours, -1, Scalar(0, 255, 0), 2);
+    if (!linked) {
+        std::cerr << "Элементы конвейера " << stream.name << " не могут быть связаны!" << std::endl;
+        return false;
+    }
     
-    // Добавляем текст с информацией
-    std::string info = "Frame contours: " + std::to_string(contours.size());
-    putText(processed_frame, info, Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.7, Scalar(0, 0, 255), 2);
+    GstBus *bus = gst_element_get_bus(data.pipeline);
+    gst_bus_add_watch(bus, bus_callback, main_loop);
+    gst_object_unref(bus);
     
-    return processed_frame;
+    return true;
+}
+
+static void add_filter_gauges(Instrumentation *instrumentation, const StreamConfig &stream, const FilterData &data) {
+    GstElement *filter = data.filter;
+    GstElement *process_queue = data.process_queue;
+    GstElement *encode_queue = data.encode_queue;
+    instrumentation->add_gauge(stream.name + ".frames_processed", [filter]() {
+        guint64 processed = 0;
+        g_object_get(G_OBJECT(filter), "frames-processed", &processed, NULL);
+        return (int64_t)processed;
+    });
+    instrumentation->add_gauge(stream.name + ".frames_unchanged", [filter]() {
+        guint64 unchanged = 0;
+        g_object_get(G_OBJECT(filter), "frames-unchanged", &unchanged, NULL);
+        return (int64_t)unchanged;
+    });
+    instrumentation->add_gauge(stream.name + ".frames_partial", [filter]() {
+        guint64 partial = 0;
+        g_object_get(G_OBJECT(filter), "frames-partial", &partial, NULL);
+        return (int64_t)partial;
+    });
+    instrumentation->add_gauge(stream.name + ".analysis_level", [filter]() {
+        gint level = 0;
+        g_object_get(G_OBJECT(filter), "current-analysis-level", &level, NULL);
+        return (int64_t)level;
+    });
+    const gint *dropped = &data.frames_dropped;
+    instrumentation->add_gauge(stream.name + ".frames_dropped", [dropped]() {
+        return (int64_t)g_atomic_int_get(dropped);
+    });
+    instrumentation->add_gauge(stream.name + ".process_queue_buffers", [process_queue]() {
+        guint level = 0;
+        g_object_get(G_OBJECT(process_queue), "current-level-buffers", &level, NULL);
+        return (int64_t)level;
+    });
+    if (encode_queue) {
+        instrumentation->add_gauge(stream.name + ".encode_queue_buffers", [encode_queue]() {
+            guint level = 0;
+            g_object_get(G_OBJECT(encode_queue), "current-level-buffers", &level, NULL);
+            return (int64_t)level;
+        });
+    }
 }
 
-static GstFlowReturn new_sample_callback(GstElement *sink, gpointer data) {
-    DstData* dst_data = (DstData*)data;
-    GstSample *sample;
+// Настройки потока cvfilter на ходу; при замене кодера пробы задержки и
+// записи переносятся на новый
+static StreamTuner *make_filter_tuner(const StreamConfig &stream, const RunContext &ctx, const FilterData &data,
+                                      EventRecorder *recorder) {
+    StreamTuner *tuner = new StreamTuner(stream.name, encoder_settings(stream), ctx.adaptive_enabled);
+    tuner->attach_filter(data.filter);
+    tuner->attach_capsfilter(data.capsfilter);
+    if (ctx.video) {
+        tuner->attach_encoder(data.pipeline, data.encode_convert ? data.encode_convert : data.encode_queue,
+                              data.encoder, data.payloader);
+        LatencyProbe *latency = ctx.latency;
+        tuner->set_encoder_callback([latency, recorder](GstElement *encoder) {
+            if (latency) {
+                latency->attach(encoder, "sink", LatencyStage::Pushed);
+            }
+            if (recorder) {
+                recorder->attach(encoder, "src");
+            }
+        });
+    }
+    return tuner;
+}
+
+// Потоки в режиме cvfilter. Если потоков несколько, обработка всех камер
+// выполняется общим планировщиком, а потоки конвейеров только ждут её
+static int run_filter_pipelines(const std::vector<StreamConfig> &streams, const RunContext &ctx) {
+    // Регуляторы и выходы контуров объявлены первыми: пробники на падах и
+    // cvfilter ссылаются на них до удаления конвейеров
+    std::vector<std::unique_ptr<AdaptiveController>> controllers;
+    std::vector<std::unique_ptr<MetadataOutput>> metadata(streams.size());
+    std::vector<std::unique_ptr<ShmOutput>> shm(streams.size());
+    std::vector<std::unique_ptr<EventRecorder>> recorders(streams.size());
+    std::vector<std::unique_ptr<StreamTuner>> tuners(streams.size());
+    std::vector<FilterData> pipelines(streams.size());
+    std::vector<std::unique_ptr<UdpFanout>> fanouts;
+    std::vector<UdpFanout *> fanout_ptrs;
+    std::vector<int> scheduler_streams;
+    bool use_scheduler = ctx.scheduler && streams.size() > 1;
+    
+    for (size_t i = 0; i < streams.size(); ++i) {
+        FilterData &data = pipelines[i];
+        fanouts.emplace_back(new UdpFanout());
+        fanout_ptrs.push_back(fanouts.back().get());
+        if (!streams[i].metadata_receivers.empty()) {
+            metadata[i].reset(new MetadataOutput(ctx.metadata));
+        }
+        if (ctx.record) {
+            recorders[i].reset(new EventRecorder(streams[i].name, ctx.recorder));
+        }
+        if (!build_filter_stream(streams[i], ctx, i == 0, data, *fanouts.back(), metadata[i].get(),
+                                 recorders[i].get())) {
+            for (size_t j = 0; j <= i; ++j) {
+                if (pipelines[j].pipeline) {
+                    gst_object_unref(pipelines[j].pipeline);
+                }
+            }
+            return -1;
+        }
+        
+        if (ctx.shm_slots > 0) {
+            shm[i].reset(make_shm_output(streams[i], ctx, data.filter, "src"));
+        }
+        
+        tuners[i].reset(make_filter_tuner(streams[i], ctx, data, recorders[i].get()));
+        
+        if (use_scheduler) {
+            WorkerScheduler *scheduler = ctx.scheduler;
+            int id = scheduler->add_stream(streams[i].name, streams[i].priority);
+            if (id < 0) {
+                // Иначе run() выполнял бы кадры потока на месте, мимо планировщика
+                std::cerr << streams[i].name << ": не удалось зарегистрировать поток в планировщике" << std::endl;
+                for (int registered : scheduler_streams) {
+                    scheduler->remove_stream(registered);
+                }
+                for (size_t j = 0; j <= i; ++j) {
+                    gst_object_unref(pipelines[j].pipeline);
+                }
+                return -1;
+            }
+            scheduler_streams.push_back(id);
+            cv_filter_set_dispatcher(data.filter, [scheduler, id](const std::function<void()> &job) {
+                scheduler->run(id, job);
+            });
+        }
+        
+        if (ctx.adaptive_enabled) {
+            GstElement *encode_queue = data.encode_queue;
+            double capacity = (double)ctx.executor.queue_capacity;
+            controllers.emplace_back(make_adaptive_controller(streams[i], ctx, data.encoder, [encode_queue, capacity]() {
+                guint level = 0;
+                g_object_get(G_OBJECT(encode_queue), "current-level-buffers", &level, NULL);
+                return level / capacity;
+            }));
+            // Выброшенный кадр не занимает место в очереди кодера
+            controllers.back()->attach_drop_point(data.encode_queue, "sink");
+            cv_filter_set_adaptive_controller(data.filter, controllers.back().get());
+        }
+    }
     
-    // Get sample from appsink
-    sample = gst_app_sink_pull_sample(GST_APP_SINK(sink));
+    for (size_t i = 0; i < pipelines.size(); ++i) {
+        if (gst_element_set_state(pipelines[i].pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+            std::cerr << "Failed to start pipeline " << streams[i].name << "!" << std::endl;
+            for (FilterData &data : pipelines) {
+                gst_element_set_state(data.pipeline, GST_STATE_NULL);
+                gst_object_unref(data.pipeline);
+            }
+            return -1;
+        }
+    }
     
-    if (!sample) {
-        std::cerr << "Couldn't acquire sample" << std::endl;
-        return GST_FLOW_ERROR;
+    if (ctx.instrumentation) {
+        for (size_t i = 0; i < pipelines.size(); ++i) {
+            add_filter_gauges(ctx.instrumentation, streams[i], pipelines[i]);
+            if (ctx.video) {
+                add_fanout_gauge(ctx.instrumentation, streams[i].name, fanout_ptrs[i]);
+            }
+            if (metadata[i]) {
+                add_metadata_gauges(ctx.instrumentation, streams[i], metadata[i].get());
+            }
+            if (shm[i]) {
+                add_shm_gauges(ctx.instrumentation, streams[i], shm[i].get());
+            }
+            if (recorders[i]) {
+                add_recorder_gauges(ctx.instrumentation, streams[i], recorders[i].get());
+            }
+        }
+        for (size_t i = 0; i < controllers.size(); ++i) {
+            add_adaptive_gauges(ctx.instrumentation, streams[i], controllers[i].get());
+        }
     }
     
-    // Convert sample to Mat
-    Mat frame = gst_sample_to_mat(sample);
+    if (ctx.control) {
+        std::map<std::string, UdpFanout *> targets;
+        for (size_t i = 0; i < streams.size(); ++i) {
+            if (ctx.video) {
+                targets[streams[i].name] = fanout_ptrs[i];
+            }
+            if (metadata[i]) {
+                targets[metadata_name(streams[i])] = &metadata[i]->fanout();
+            }
+        }
+        add_receiver_commands(ctx.control, targets);
+        
+        std::map<std::string, StreamTuner *> tuner_targets;
+        for (size_t i = 0; i < streams.size(); ++i) {
+            tuner_targets[streams[i].name] = tuners[i].get();
+        }
+        add_tuning_commands(ctx.control, tuner_targets);
+        
+        std::map<std::string, EventRecorder *> recorder_targets;
+        for (size_t i = 0; i < streams.size(); ++i) {
+            if (recorders[i]) {
+                recorder_targets[streams[i].name] = recorders[i].get();
+            }
+        }
+        if (!recorder_targets.empty()) {
+            add_record_command(ctx.control, recorder_targets);
+        }
+    }
     
-    if (frame.empty()) {
-        std::cerr << "Empty frame!" << std::endl;
-        gst_sample_unref(sample);
-        return GST_FLOW_ERROR;
+    for (std::unique_ptr<AdaptiveController> &controller : controllers) {
+        controller->start();
     }
+    for (std::unique_ptr<EventRecorder> &recorder : recorders) {
+        if (recorder) {
+            recorder->start();
+        }
+    }
+    
+    std::cout << "Pipelines started (" << pipelines.size() << "), capturing video..." << std::endl;
     
-    // Process the image
-    Mat processed_frame = process_frame(frame);
+    g_main_loop_run(main_loop);
     
-    // Display the result
-    imshow("GStreamer + OpenCV", processed_frame);
-    int key = waitKey(30);
-    if (key == 27 && main_loop) { // ESC key
-        g_main_loop_quit(main_loop);
+    if (ctx.instrumentation) {
+        ctx.instrumentation->clear_gauges();
+    }
+    if (ctx.control) {
+        ctx.control->clear_commands();
     }
     
-    // Get caps from sample to create a new sample
-    GstCaps* caps = gst_sample_get_caps(sample);
-    gst_sample_unref(sample);
+    for (std::unique_ptr<AdaptiveController> &controller : controllers) {
+        controller->stop();
+    }
     
-    // Create a new sample from processed image
-    GstSample* out_sample = mat_to_gst_sample(processed_frame, caps);
+    for (FilterData &data : pipelines) {
+        gst_element_set_state(data.pipeline, GST_STATE_NULL);
+    }
     
-    if (out_sample) {
-        // Send processed frame to UDP stream
-        GstFlowReturn ret = gst_app_src_push_sample(GST_APP_SRC(dst_data->appsrc), out_sample);
-        gst_sample_unref(out_sample);
-        
-        if (ret != GST_FLOW_OK) {
-            std::cerr << "Error during sending frame to appsrc: " << ret << std::endl;
-            return GST_FLOW_ERROR;
+    // Начатые записи дописываются тем, что успело накопиться
+    for (std::unique_ptr<EventRecorder> &recorder : recorders) {
+        if (recorder) {
+            recorder->stop();
         }
     }
     
-    return GST_FLOW_OK;
-}
-
-int main(int argc, char *argv[]) {
-    // Инициализация GStreamer
-    gst_init(&argc, &argv);
+    // Потоки конвейеров остановлены, задания больше не поступают
+    for (int id : scheduler_streams) {
+        ctx.scheduler->remove_stream(id);
+    }
     
-    // Создаем главный цикл
-    main_loop = g_main_loop_new(NULL, FALSE);
+    for (size_t i = 0; i < pipelines.size(); ++i) {
+        guint64 processed = 0;
+        g_object_get(G_OBJECT(pipelines[i].filter), "frames-processed", &processed, NULL);
+        std::cout << streams[i].name << ": обработано кадров " << processed << ", выброшено ("
+                  << drop_policy_name(ctx.executor.drop_policy) << ") " << g_atomic_int_get(&pipelines[i].frames_dropped)
+                  << std::endl;
+        gst_object_unref(GST_OBJECT(pipelines[i].pipeline));
+    }
     
-    // Создаем структуры для конвейеров
-    SrcData src_data;
-    DstData dst_data;
+    return 0;
+}
+
+// Очередь appsrc: четыре BGR-кадра потока
+static guint64 appsrc_max_bytes(const StreamConfig &stream) {
+    return 4 * (guint64)stream.width * stream.height * 3;
+}
+
+// Пара конвейеров потока, связанных через appsink/appsrc
+struct BridgeStream {
+    std::unique_ptr<StreamTuner> tuner;              // переживает конвейеры: держит пробу замены кодера
+    std::unique_ptr<AdaptiveController> controller;  // переживает конвейеры и исполнитель
+    std::unique_ptr<ShmOutput> shm;                  // тоже, проба стоит на appsrc
+    std::unique_ptr<EventRecorder> recorder;         // тоже, проба стоит на кодере
+    SrcData src;
+    DstData dst;
+    UdpFanout fanout;
+    std::unique_ptr<FrameExecutor> executor;
+};
+
+static bool build_bridge_stream(const StreamConfig &stream, const RunContext &ctx, BridgeStream &bridge) {
+    SrcData &src_data = bridge.src;
+    DstData &dst_data = bridge.dst;
     
     // Создаем конвейер источника
-    src_data.pipeline = gst_pipeline_new("src_pipeline");
+    src_data.pipeline = gst_pipeline_new((stream.name + "_src").c_str());
     src_data.source = gst_element_factory_make("v4l2src", "src_source");
     src_data.convert = gst_element_factory_make("videoconvert", "src_convert");
     src_data.scale = gst_element_factory_make("videoscale", "src_scale");
     src_data.sink = gst_element_factory_make("appsink", "src_sink");
     
     // Создаем конвейер назначения
-    dst_data.pipeline = gst_pipeline_new("dst_pipeline");
+    dst_data.pipeline = gst_pipeline_new((stream.name + "_dst").c_str());
     dst_data.appsrc = gst_element_factory_make("appsrc", "dst_source");
     dst_data.convert = gst_element_factory_make("videoconvert", "dst_convert");
     dst_data.encoder = gst_element_factory_make("x264enc", "dst_encoder");
     dst_data.payloader = gst_element_factory_make("rtph264pay", "dst_payloader");
-    dst_data.udpsink = gst_element_factory_make("udpsink", "dst_udpsink");
     
     // Проверяем элементы src конвейера
     if (!src_data.pipeline || !src_data.source || !src_data.convert || 
         !src_data.scale || !src_data.sink) {
-        std::cerr << "Не удалось создать элементы src конвейера!" << std::endl;
-        return -1;
+        std::cerr << "Не удалось создать элементы src конвейера " << stream.name << "!" << std::endl;
+        return false;
     }
     
     // Проверяем элементы dst конвейера
     if (!dst_data.pipeline || !dst_data.appsrc || !dst_data.convert || 
-        !dst_data.encoder || !dst_data.payloader || !dst_data.udpsink) {
-        std::cerr << "Не удалось создать элементы dst конвейера!" << std::endl;
-        return -1;
+        !dst_data.encoder || !dst_data.payloader || !bridge.fanout.create(GST_BIN(dst_data.pipeline), stream)) {
+        std::cerr << "Не удалось создать элементы dst конвейера " << stream.name << "!" << std::endl;
+        return false;
     }
     
-    // Настраиваем appsink для получения кадров
-    g_object_set(G_OBJECT(src_data.sink), "emit-signals", TRUE, NULL);
-    g_object_set(G_OBJECT(src_data.sink), "max-buffers", 1, NULL);
-    g_object_set(G_OBJECT(src_data.sink), "drop", TRUE, NULL);
+    // Настраиваем appsink: кадры забирает поток захвата исполнителя,
+    // а переполнение обрабатывается его политикой, а не молча в appsink
+    g_object_set(G_OBJECT(src_data.sink), "emit-signals", FALSE, NULL);
+    g_object_set(G_OBJECT(src_data.sink), "max-buffers", 2, NULL);
+    g_object_set(G_OBJECT(src_data.sink), "drop", FALSE, NULL);
     
     // Настраиваем appsrc
     g_object_set(G_OBJECT(dst_data.appsrc), "stream-type", 0, NULL); // GST_APP_STREAM_TYPE_STREAM
     g_object_set(G_OBJECT(dst_data.appsrc), "format", GST_FORMAT_TIME, NULL);
     g_object_set(G_OBJECT(dst_data.appsrc), "is-live", TRUE, NULL);
+    // Очередь appsrc ограничена несколькими кадрами: если кодер отстаёт,
+    // стадия вывода ждёт, а переполнение решает политика входной очереди
+    g_object_set(G_OBJECT(dst_data.appsrc), "max-bytes", appsrc_max_bytes(stream), NULL);
+    g_object_set(G_OBJECT(dst_data.appsrc), "block", TRUE, NULL);
     
-    // Настраиваем UDP-sink
-    g_object_set(G_OBJECT(dst_data.udpsink), "host", "127.0.0.1", NULL); // Локальный адрес для тестирования
-    g_object_set(G_OBJECT(dst_data.udpsink), "port", 5000, NULL);
+    // Настраиваем камеру и H.264 кодер
+    configure_source(src_data.source, stream);
+    if (!configure_stream_encoder(dst_data.encoder, stream)) {
+        return false;
+    }
     
-    // Настраиваем H.264 кодер
-    g_object_set(G_OBJECT(dst_data.encoder), "tune", 4, NULL);  // zerolatency preset
-    g_object_set(G_OBJECT(dst_data.encoder), "speed-preset", 1, NULL);  // ultrafast
-    g_object_set(G_OBJECT(dst_data.encoder), "bitrate", 500, NULL);  // 500 kbps
+    // Общие часы нужны для пересчёта PTS источника в running time appsrc
+    use_system_clock(src_data.pipeline);
+    use_system_clock(dst_data.pipeline);
     
-    // Устанавливаем формат видео
-    GstCaps *caps = gst_caps_new_simple("video/x-raw",
-                                       "format", G_TYPE_STRING, "RGB",
-                                       "width", G_TYPE_INT, 640,
-                                       "height", G_TYPE_INT, 480,
-                                       "framerate", GST_TYPE_FRACTION, 30, 1,
-                                       NULL);
+    if (ctx.latency) {
+        ctx.latency->attach(bridge.fanout.sink(), "sink", LatencyStage::Sent);
+    }
     
     // Устанавливаем caps для appsink и appsrc
+    GstCaps *caps = make_frame_caps("BGR", stream);
     gst_app_sink_set_caps(GST_APP_SINK(src_data.sink), caps);
     g_object_set(G_OBJECT(dst_data.appsrc), "caps", caps, NULL);
-
-    // Connect handler for new frames
-    g_signal_connect(src_data.sink, "new-sample", G_CALLBACK(new_sample_callback), &dst_data);
+    gst_caps_unref(caps);
     
     // Добавляем элементы в конвейеры
     gst_bin_add_many(GST_BIN(src_data.pipeline), src_data.source, src_data.convert, src_data.scale, src_data.sink, NULL);
-    gst_bin_add_many(GST_BIN(dst_data.pipeline), dst_data.appsrc, dst_data.convert, dst_data.encoder, dst_data.payloader, dst_data.udpsink, NULL);
+    gst_bin_add_many(GST_BIN(dst_data.pipeline), dst_data.appsrc, dst_data.convert, dst_data.encoder, dst_data.payloader, NULL);
     
     // Связываем элементы src конвейера
     if (!gst_element_link_many(src_data.source, src_data.convert, src_data.scale, src_data.sink, NULL)) {
-        std::cerr << "Элементы src конвейера не могут быть связаны!" << std::endl;
-        gst_object_unref(src_data.pipeline);
-        gst_object_unref(dst_data.pipeline);
-        return -1;
+        std::cerr << "Элементы src конвейера " << stream.name << " не могут быть связаны!" << std::endl;
+        return false;
     }
     
     // Связываем элементы dst конвейера
-    if (!gst_element_link_many(dst_data.appsrc, dst_data.convert, dst_data.encoder, dst_data.payloader, dst_data.udpsink, NULL)) {
-        std::cerr << "Элементы dst конвейера не могут быть связаны!" << std::endl;
-        gst_object_unref(src_data.pipeline);
-        gst_object_unref(dst_data.pipeline);
-        return -1;
+    if (!gst_element_link_many(dst_data.appsrc, dst_data.convert, dst_data.encoder, dst_data.payloader, bridge.fanout.input(), NULL)) {
+        std::cerr << "Элементы dst конвейера " << stream.name << " не могут быть связаны!" << std::endl;
+        return false;
     }
     
     GstBus *src_bus = gst_element_get_bus(src_data.pipeline);
@@ -342,36 +918,672 @@ int main(int argc, char *argv[]) {
     gst_bus_add_watch(dst_bus, bus_callback, main_loop);
     gst_object_unref(dst_bus);
     
-    // Create OpenCV window
-    namedWindow("GStreamer + OpenCV", WINDOW_AUTOSIZE);
+    return true;
+}
+
+static void add_bridge_gauges(Instrumentation *instrumentation, const StreamConfig &stream, BridgeStream &bridge) {
+    FrameExecutor *executor = bridge.executor.get();
+    GstElement *appsrc = bridge.dst.appsrc;
+    instrumentation->add_gauge(stream.name + ".frames_in", [executor]() { return (int64_t)executor->stats().captured; });
+    instrumentation->add_gauge(stream.name + ".frames_out", [executor]() { return (int64_t)executor->stats().pushed; });
+    instrumentation->add_gauge(stream.name + ".frames_dropped", [executor]() {
+        ExecutorStats stats = executor->stats();
+        return (int64_t)(stats.dropped_oldest + stats.dropped_newest);
+    });
+    instrumentation->add_gauge(stream.name + ".frames_failed", [executor]() { return (int64_t)executor->stats().failed; });
+    instrumentation->add_gauge(stream.name + ".appsrc_queue_bytes", [appsrc]() {
+        return (int64_t)gst_app_src_get_current_level_bytes(GST_APP_SRC(appsrc));
+    });
+}
+
+static void release_bridge_streams(std::vector<BridgeStream> &bridges) {
+    for (BridgeStream &bridge : bridges) {
+        bridge.executor.reset();
+        if (bridge.src.pipeline) {
+            gst_element_set_state(bridge.src.pipeline, GST_STATE_NULL);
+            gst_object_unref(GST_OBJECT(bridge.src.pipeline));
+        }
+        if (bridge.dst.pipeline) {
+            gst_element_set_state(bridge.dst.pipeline, GST_STATE_NULL);
+            gst_object_unref(GST_OBJECT(bridge.dst.pipeline));
+        }
+    }
+}
+
+// Останавливает регулятор, исполнитель и запись потока; сами конвейеры
+// освобождает release_bridge_streams
+static void stop_bridge_stream(BridgeStream &bridge) {
+    if (bridge.controller) {
+        bridge.controller->stop();
+    }
+    // Остановленный appsrc освобождает стадию вывода, ждущую места в очереди
+    gst_element_set_state(bridge.dst.pipeline, GST_STATE_NULL);
+    bridge.executor->stop();
+    if (bridge.recorder) {
+        bridge.recorder->stop();
+    }
+}
+
+// Потоки в режиме appsink/appsrc; кадры всех камер обрабатывает общий планировщик
+static int run_bridge(const std::vector<StreamConfig> &streams, const RunContext &ctx) {
+    std::vector<BridgeStream> bridges(streams.size());
+    
+    for (size_t i = 0; i < streams.size(); ++i) {
+        if (!build_bridge_stream(streams[i], ctx, bridges[i])) {
+            release_bridge_streams(bridges);
+            return -1;
+        }
+    }
     
     // Start pipelines
-    GstStateChangeReturn src_ret = gst_element_set_state(src_data.pipeline, GST_STATE_PLAYING);
-    GstStateChangeReturn dst_ret = gst_element_set_state(dst_data.pipeline, GST_STATE_PLAYING);
+    for (size_t i = 0; i < bridges.size(); ++i) {
+        GstStateChangeReturn src_ret = gst_element_set_state(bridges[i].src.pipeline, GST_STATE_PLAYING);
+        GstStateChangeReturn dst_ret = gst_element_set_state(bridges[i].dst.pipeline, GST_STATE_PLAYING);
+        
+        if (src_ret == GST_STATE_CHANGE_FAILURE || dst_ret == GST_STATE_CHANGE_FAILURE) {
+            std::cerr << "Failed to start pipeline " << streams[i].name << "!" << std::endl;
+            release_bridge_streams(bridges);
+            return -1;
+        }
+    }
     
-    if (src_ret == GST_STATE_CHANGE_FAILURE || dst_ret == GST_STATE_CHANGE_FAILURE) {
-        std::cerr << "Failed to start pipeline!" << std::endl;
-        return -1;
+    // Start capture and output threads; processing runs on the shared scheduler
+    for (size_t i = 0; i < bridges.size(); ++i) {
+        BridgeStream &bridge = bridges[i];
+        ExecutorConfig config = ctx.executor;
+        config.name = streams[i].name;
+        config.priority = streams[i].priority;
+        
+        bridge.executor.reset(new FrameExecutor(bridge.src.sink, bridge.dst.appsrc, config, ctx.scheduler));
+        bridge.executor->set_latency_probe(ctx.latency);
+        bridge.executor->set_edge_params(streams[i].low_threshold, streams[i].high_threshold);
+        std::shared_ptr<StageGraph> graph = std::make_shared<StageGraph>();
+        std::string stages_error;
+        graph->compile(streams[i].stages, stages_error);  // проверено при разборе аргументов
+        bridge.executor->set_stage_graph(graph);
+        
+        if (ctx.adaptive_enabled) {
+            GstElement *appsrc = bridge.dst.appsrc;
+            // Предел очереди меняется вместе с размером кадров
+            bridge.controller.reset(make_adaptive_controller(streams[i], ctx, bridge.dst.encoder, [appsrc]() {
+                return (double)gst_app_src_get_current_level_bytes(GST_APP_SRC(appsrc)) /
+                       (double)gst_app_src_get_max_bytes(GST_APP_SRC(appsrc));
+            }));
+            bridge.controller->attach_drop_point(appsrc, "src");
+            bridge.executor->set_adaptive_controller(bridge.controller.get());
+            bridge.controller->start();
+        }
+        
+        if (ctx.shm_slots > 0) {
+            bridge.shm.reset(make_shm_output(streams[i], ctx, bridge.dst.appsrc, "src"));
+        }
+        
+        if (ctx.record) {
+            bridge.recorder.reset(new EventRecorder(streams[i].name, ctx.recorder));
+            bridge.recorder->attach(bridge.dst.encoder, "src");
+            // Контуры едут с кадром через очередь вывода исполнителя
+            std::function<void(size_t)> spike = make_spike_observer(ctx, bridge.recorder.get());
+            if (spike) {
+                bridge.executor->set_contours_callback([spike](const FlatContours &contours, GstClockTime, Size) {
+                    spike(contours.size());
+                });
+            }
+            bridge.recorder->start();
+        }
+        
+        bridge.tuner.reset(new StreamTuner(streams[i].name, encoder_settings(streams[i]), ctx.adaptive_enabled));
+        bridge.tuner->attach_encoder(bridge.dst.pipeline, bridge.dst.convert, bridge.dst.encoder, bridge.dst.payloader);
+        bridge.tuner->attach_executor(bridge.executor.get());
+        bridge.tuner->attach_bridge(bridge.src.sink, bridge.dst.appsrc);
+        EventRecorder *recorder = bridge.recorder.get();
+        if (recorder) {
+            bridge.tuner->set_encoder_callback([recorder](GstElement *encoder) { recorder->attach(encoder, "src"); });
+        }
+        
+        if (i == 0 && ctx.preview) {
+            Preview *preview = ctx.preview;
+            bridge.executor->set_output_callback([preview](const Mat &frame) { preview->publish(frame); });
+        }
+        
+        if (ctx.instrumentation) {
+            add_bridge_gauges(ctx.instrumentation, streams[i], bridge);
+            add_fanout_gauge(ctx.instrumentation, streams[i].name, &bridge.fanout);
+            if (bridge.controller) {
+                add_adaptive_gauges(ctx.instrumentation, streams[i], bridge.controller.get());
+            }
+            if (bridge.shm) {
+                add_shm_gauges(ctx.instrumentation, streams[i], bridge.shm.get());
+            }
+            if (bridge.recorder) {
+                add_recorder_gauges(ctx.instrumentation, streams[i], bridge.recorder.get());
+            }
+        }
+        
+        if (!bridge.executor->start()) {
+            if (ctx.instrumentation) {
+                ctx.instrumentation->clear_gauges();
+            }
+            for (size_t j = 0; j <= i; ++j) {
+                stop_bridge_stream(bridges[j]);
+            }
+            release_bridge_streams(bridges);
+            return -1;
+        }
     }
     
-    std::cout << "Pipelines started, capturing video..." << std::endl;
+    if (ctx.control) {
+        std::map<std::string, UdpFanout *> targets;
+        std::map<std::string, EventRecorder *> recorder_targets;
+        std::map<std::string, StreamTuner *> tuner_targets;
+        for (size_t i = 0; i < bridges.size(); ++i) {
+            targets[streams[i].name] = &bridges[i].fanout;
+            tuner_targets[streams[i].name] = bridges[i].tuner.get();
+            if (bridges[i].recorder) {
+                recorder_targets[streams[i].name] = bridges[i].recorder.get();
+            }
+        }
+        add_receiver_commands(ctx.control, targets);
+        add_tuning_commands(ctx.control, tuner_targets);
+        if (!recorder_targets.empty()) {
+            add_record_command(ctx.control, recorder_targets);
+        }
+    }
+    
+    std::cout << "Pipelines started (" << bridges.size() << "), capturing video..." << std::endl;
     
     // Start main loop
     g_main_loop_run(main_loop);
     
     // Cleanup resources
-    destroyAllWindows();
-    gst_caps_unref(caps);
+    if (ctx.instrumentation) {
+        ctx.instrumentation->clear_gauges();
+    }
+    if (ctx.control) {
+        ctx.control->clear_commands();
+    }
     
-    gst_element_set_state(src_data.pipeline, GST_STATE_NULL);
-    gst_element_set_state(dst_data.pipeline, GST_STATE_NULL);
+    for (size_t i = 0; i < bridges.size(); ++i) {
+        stop_bridge_stream(bridges[i]);
+        
+        ExecutorStats stats = bridges[i].executor->stats();
+        std::cout << streams[i].name << ": кадры: захвачено " << stats.captured
+                  << ", обработано " << stats.processed
+                  << ", отправлено " << stats.pushed
+                  << ", выброшено (" << drop_policy_name(ctx.executor.drop_policy) << ") "
+                  << stats.dropped_oldest + stats.dropped_newest
+                  << ", ожиданий очереди " << stats.blocked
+                  << ", ошибок " << stats.failed << std::endl;
+    }
     
-    gst_object_unref(GST_OBJECT(src_data.pipeline));
-    gst_object_unref(GST_OBJECT(dst_data.pipeline));
+    release_bridge_streams(bridges);
+    
+    return 0;
+}
+
+// Уровень анализа 0..kMaxDownsampleLevel или "auto" (-1)
+static bool parse_analysis_level(const std::string &text, int &level) {
+    if (text == "auto") {
+        level = -1;
+        return true;
+    }
+    char *end = nullptr;
+    long value = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || value < 0 || value > kMaxDownsampleLevel) {
+        return false;
+    }
+    level = (int)value;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    // Параметры командной строки
+    gint workers = 0;
+    gint queue_size = 8;
+    gchar *drop_policy_arg = NULL;
+    gboolean headless = FALSE;
+    gdouble preview_fps = 5;
+    gboolean bridge = FALSE;
+    gchar *format_arg = NULL;
+    gboolean latency_arg = FALSE;
+    gchar *trace_path = NULL;
+    gdouble trace_start = 0;
+    gdouble trace_seconds = 5;
+    gchar *stats_path = NULL;
+    gint stats_port = 0;
+    gdouble stats_interval = 1;
+    gchar *streams_path = NULL;
+    gboolean pin_cpus = FALSE;
+    gint control_port = 0;
+    gboolean adaptive = FALSE;
+    gint bitrate = 0;
+    gchar *speed_preset_arg = NULL;
+    gchar *tune_arg = NULL;
+    gchar *edge_thresholds_arg = NULL;
+    gchar *stages_arg = NULL;
+    gint min_bitrate = 150;
+    gboolean incremental = TRUE;
+    gboolean video = TRUE;
+    gchar *metadata_arg = NULL;
+    gdouble metadata_epsilon = 0;
+    gchar *resolution_arg = NULL;
+    gchar *analysis_level_arg = NULL;
+    gdouble analysis_budget_ms = 0;
+    gboolean output_blur = FALSE;
+    gchar **input_files = NULL;
+    gchar *output_dir = NULL;
+    gchar *batch_output_arg = NULL;
+    gint batch_jobs = 0;
+    gboolean shm = FALSE;
+    gint shm_slots = 4;
+    gchar *record_dir = NULL;
+    gdouble record_preroll = 10;
+    gdouble record_postroll = 5;
+    gint record_budget_mb = 64;
+    gdouble record_max_duration = 300;
+    gint record_max_mb = 256;
+    gchar *record_format_arg = NULL;
+    gdouble record_on_spike = 0;
+
+    GOptionEntry entries[] = {
+        { "streams", 0, 0, G_OPTION_ARG_FILENAME, &streams_path, "Файл со списком камер и получателей (INI)", "FILE" },
+        { "workers", 'w', 0, G_OPTION_ARG_INT, &workers, "Число потоков общего пула обработки (0 - по числу ядер)", "N" },
+        { "pin-cpus", 0, 0, G_OPTION_ARG_NONE, &pin_cpus, "Привязать потоки пула обработки к ядрам", NULL },
+        { "queue-size", 'q', 0, G_OPTION_ARG_INT, &queue_size, "Ёмкость очереди кадров перед обработкой", "N" },
+        { "drop-policy", 'd', 0, G_OPTION_ARG_STRING, &drop_policy_arg, "Политика переполнения: drop-oldest, drop-newest, block", "POLICY" },
+        { "headless", 0, 0, G_OPTION_ARG_NONE, &headless, "Работа без окна предпросмотра", NULL },
+        { "preview-fps", 0, 0, G_OPTION_ARG_DOUBLE, &preview_fps, "Частота обновления окна предпросмотра", "FPS" },
+        { "bridge", 0, 0, G_OPTION_ARG_NONE, &bridge, "Два конвейера, связанные через appsink/appsrc, вместо элемента cvfilter", NULL },
+        { "format", 'f', 0, G_OPTION_ARG_STRING, &format_arg, "Формат обработки: BGR, I420, NV12 (I420/NV12 - без преобразования цвета)", "FORMAT" },
+        { "latency", 0, 0, G_OPTION_ARG_NONE, &latency_arg, "Измерять задержку от захвата до отправки по UDP (p50/p99/max)", NULL },
+        { "trace", 0, 0, G_OPTION_ARG_FILENAME, &trace_path, "Записать спаны стадий в формате Chrome trace-event", "FILE" },
+        { "trace-start", 0, 0, G_OPTION_ARG_DOUBLE, &trace_start, "Начало окна трассы, с от запуска", "SEC" },
+        { "trace-seconds", 0, 0, G_OPTION_ARG_DOUBLE, &trace_seconds, "Длительность окна трассы, с", "SEC" },
+        { "stats-file", 0, 0, G_OPTION_ARG_FILENAME, &stats_path, "Файл сводки гистограмм стадий и счётчиков", "FILE" },
+        { "stats-port", 0, 0, G_OPTION_ARG_INT, &stats_port, "Отдавать сводку по HTTP на 127.0.0.1:PORT", "PORT" },
+        { "stats-interval", 0, 0, G_OPTION_ARG_DOUBLE, &stats_interval, "Окно гистограмм сводки, с", "SEC" },
+        { "bitrate", 'b', 0, G_OPTION_ARG_INT, &bitrate, "Битрейт H.264, кбит/с (по умолчанию 500)", "KBPS" },
+        { "speed-preset", 0, 0, G_OPTION_ARG_STRING, &speed_preset_arg, "Предустановка скорости x264 (по умолчанию ultrafast)", "NAME" },
+        { "tune", 0, 0, G_OPTION_ARG_STRING, &tune_arg, "Настройка x264 tune (по умолчанию zerolatency)", "NAME" },
+        { "edge-thresholds", 0, 0, G_OPTION_ARG_STRING, &edge_thresholds_arg, "Пороги гистерезиса поиска краёв (по умолчанию 100:200)", "LOW:HIGH" },
+        { "stages", 0, 0, G_OPTION_ARG_STRING, &stages_arg, "Стадии обработки через запятую: blur, edges, threshold[:N], contours, draw, stamp (по умолчанию blur,edges,contours,draw,stamp)", "LIST" },
+        { "adaptive", 0, 0, G_OPTION_ARG_NONE, &adaptive, "Снижать битрейт, прореживать обработку и кодирование при перегрузке", NULL },
+        { "min-bitrate", 0, 0, G_OPTION_ARG_INT, &min_bitrate, "Нижняя граница битрейта в режиме --adaptive, кбит/с", "KBPS" },
+        { "full-frames", 0, G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &incremental, "Обрабатывать каждый кадр целиком, без повторного использования краёв неизменных областей", NULL },
+        { "control-port", 0, 0, G_OPTION_ARG_INT, &control_port, "Канал управления на 127.0.0.1:PORT (получатели и настройки потоков на ходу)", "PORT" },
+        { "metadata", 0, 0, G_OPTION_ARG_STRING, &metadata_arg, "Отправлять контуры кадров получателю по UDP (без файла --streams)", "HOST:PORT" },
+        { "metadata-epsilon", 0, 0, G_OPTION_ARG_DOUBLE, &metadata_epsilon, "Упрощать контуры перед отправкой с точностью EPS пикселей (0 - без упрощения)", "EPS" },
+        { "no-video", 0, G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &video, "Не кодировать и не отправлять видео, только контуры", NULL },
+        { "resolution", 0, 0, G_OPTION_ARG_STRING, &resolution_arg, "Размер кадров камеры (без файла --streams, по умолчанию 640x480)", "WxH" },
+        { "analysis-level", 0, 0, G_OPTION_ARG_STRING, &analysis_level_arg, "Искать края в кадре, уменьшенном в 2^N раз (0-3), auto - по бюджету кадра", "N|auto" },
+        { "analysis-budget", 0, 0, G_OPTION_ARG_DOUBLE, &analysis_budget_ms, "Бюджет обработки кадра для --analysis-level auto, мс (0 - интервал кадров)", "MS" },
+        { "output-blur", 0, 0, G_OPTION_ARG_NONE, &output_blur, "Размывать кадр и на уровнях анализа выше 0 (проход по всем пикселям кадра)", NULL },
+        { "input", 'i', 0, G_OPTION_ARG_FILENAME_ARRAY, &input_files, "Обработать записанный файл вместо камеры (можно несколько раз)", "FILE" },
+        { "output-dir", 'o', 0, G_OPTION_ARG_FILENAME, &output_dir, "Каталог результатов пакетной обработки", "DIR" },
+        { "batch-output", 0, 0, G_OPTION_ARG_STRING, &batch_output_arg, "Результат пакетной обработки: video, contours, both", "KIND" },
+        { "batch-jobs", 0, 0, G_OPTION_ARG_INT, &batch_jobs, "Число файлов, обрабатываемых одновременно (0 - по числу рабочих потоков)", "N" },
+        { "shm", 0, 0, G_OPTION_ARG_NONE, &shm, "Публиковать обработанные кадры в разделяемой памяти /vidstream.<поток> для процессов на этом узле", NULL },
+        { "shm-slots", 0, 0, G_OPTION_ARG_INT, &shm_slots, "Кадров в кольце разделяемой памяти (не меньше 2, по умолчанию 4)", "N" },
+        { "record-dir", 0, 0, G_OPTION_ARG_FILENAME, &record_dir, "Держать в памяти предзапись H.264 и записывать события в файлы каталога", "DIR" },
+        { "record-preroll", 0, 0, G_OPTION_ARG_DOUBLE, &record_preroll, "Секунд видео до события (по умолчанию 10)", "SEC" },
+        { "record-postroll", 0, 0, G_OPTION_ARG_DOUBLE, &record_postroll, "Секунд видео после события (по умолчанию 5)", "SEC" },
+        { "record-budget", 0, 0, G_OPTION_ARG_INT, &record_budget_mb, "Предел памяти предзаписи на поток, МБ (по умолчанию 64)", "MB" },
+        { "record-max-duration", 0, 0, G_OPTION_ARG_DOUBLE, &record_max_duration, "Секунд в одном файле записи, дальше - новый файл (по умолчанию 300)", "SEC" },
+        { "record-max-size", 0, 0, G_OPTION_ARG_INT, &record_max_mb, "МБ в одном файле записи, дальше - новый файл (по умолчанию 256)", "MB" },
+        { "record-format", 0, 0, G_OPTION_ARG_STRING, &record_format_arg, "Контейнер записи: mp4 или mkv", "FORMAT" },
+        { "record-on-spike", 0, 0, G_OPTION_ARG_DOUBLE, &record_on_spike, "Записывать событие, когда контуров в RATIO раз больше среднего (0 - только командой record)", "RATIO" },
+        { NULL }
+    };
+
+    // Инициализация GStreamer вместе с разбором аргументов
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- захват, обработка и трансляция видео");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        std::cerr << "Ошибка разбора аргументов: " << error->message << std::endl;
+        g_error_free(error);
+        g_option_context_free(context);
+        return -1;
+    }
+    g_option_context_free(context);
+
+    ExecutorConfig executor_config;
+    executor_config.queue_capacity = queue_size > 0 ? queue_size : 1;
+    if (drop_policy_arg && !parse_drop_policy(drop_policy_arg, executor_config.drop_policy)) {
+        std::cerr << "Неизвестная политика переполнения: " << drop_policy_arg << std::endl;
+        return -1;
+    }
+    g_free(drop_policy_arg);
+
+    std::string format = format_arg ? format_arg : "BGR";
+    g_free(format_arg);
+    if (format != "BGR" && format != "I420" && format != "NV12") {
+        std::cerr << "Неизвестный формат: " << format << std::endl;
+        return -1;
+    }
+    if (bridge && format != "BGR") {
+        std::cerr << "Режим --bridge поддерживает только формат BGR" << std::endl;
+        return -1;
+    }
+
+    // Пакетный режим: файлы вместо камер, результат - файлы в --output-dir
+    BatchConfig batch;
+    for (gchar **file = input_files; file && *file; ++file) {
+        batch.inputs.push_back(*file);
+    }
+    g_strfreev(input_files);
+    if (output_dir) {
+        batch.output_dir = output_dir;
+        g_free(output_dir);
+    }
+    std::string batch_output = batch_output_arg ? batch_output_arg : "video";
+    g_free(batch_output_arg);
+    if (batch_output != "video" && batch_output != "contours" && batch_output != "both") {
+        std::cerr << "Неизвестный результат пакетной обработки: " << batch_output << std::endl;
+        return -1;
+    }
+    batch.write_video = batch_output != "contours";
+    batch.write_contours = batch_output != "video";
+    batch.bitrate = bitrate > 0 ? bitrate : 500;
+    batch.jobs = batch_jobs > 0 ? batch_jobs : 0;
+    batch.queue_capacity = executor_config.queue_capacity;
+    if (!batch.inputs.empty() && (streams_path || bridge || metadata_arg || !video || adaptive || shm || record_dir ||
+                                  format != "BGR")) {
+        std::cerr << "Пакетная обработка (--input) несовместима с --streams, --bridge, --metadata, "
+                     "--no-video, --adaptive, --shm, --record-dir и --format" << std::endl;
+        return -1;
+    }
+
+    // Без файла - одна камера с настройками по умолчанию
+    std::vector<StreamConfig> streams(1);
+    bool streams_from_file = streams_path != NULL;
+    if (streams_path) {
+        std::string streams_error;
+        bool loaded = load_stream_configs(streams_path, streams, streams_error);
+        if (!loaded) {
+            std::cerr << "Не удалось прочитать " << streams_path << ": " << streams_error << std::endl;
+            g_free(streams_path);
+            return -1;
+        }
+        g_free(streams_path);
+    }
+
+    if (metadata_arg) {
+        Receiver receiver;
+        if (streams.size() != 1 || !streams[0].metadata_receivers.empty() || !parse_receiver(metadata_arg, receiver)) {
+            std::cerr << "Неверный получатель контуров: " << metadata_arg
+                      << " (для файла --streams задаётся ключом metadata-receivers)" << std::endl;
+            g_free(metadata_arg);
+            return -1;
+        }
+        streams[0].metadata_receivers.push_back(receiver);
+        g_free(metadata_arg);
+    }
+
+    if (resolution_arg) {
+        int width = 0, height = 0;
+        if (streams_from_file || !parse_resolution(resolution_arg, width, height)) {
+            std::cerr << "Неверный размер кадра: " << resolution_arg
+                      << " (для файла --streams задаётся ключами width и height)" << std::endl;
+            g_free(resolution_arg);
+            return -1;
+        }
+        streams[0].width = width;
+        streams[0].height = height;
+        g_free(resolution_arg);
+    }
+
+    // Настройки кодера, порогов и стадий: командная строка, затем файл, затем по умолчанию
+    int low_threshold = -1, high_threshold = -1;
+    if (edge_thresholds_arg) {
+        std::string thresholds_text = edge_thresholds_arg;
+        g_free(edge_thresholds_arg);
+        if (!parse_edge_thresholds(thresholds_text, low_threshold, high_threshold)) {
+            std::cerr << "Неверные пороги краёв: " << thresholds_text << std::endl;
+            g_free(stages_arg);
+            return -1;
+        }
+    }
+    EdgeParams default_edges;
+    EncoderSettings default_encoder;
+    for (StreamConfig &stream : streams) {
+        if (bitrate > 0 || stream.bitrate <= 0) {
+            stream.bitrate = bitrate > 0 ? bitrate : default_encoder.bitrate;
+        }
+        if (speed_preset_arg || stream.speed_preset.empty()) {
+            stream.speed_preset = speed_preset_arg ? speed_preset_arg : default_encoder.speed_preset;
+        }
+        if (tune_arg || stream.tune.empty()) {
+            stream.tune = tune_arg ? tune_arg : default_encoder.tune;
+        }
+        if (low_threshold >= 0 || stream.low_threshold < 0) {
+            stream.low_threshold = low_threshold >= 0 ? low_threshold : default_edges.low_threshold;
+        }
+        if (high_threshold >= 0 || stream.high_threshold < 0) {
+            stream.high_threshold = high_threshold >= 0 ? high_threshold : default_edges.high_threshold;
+        }
+        if (stream.low_threshold > stream.high_threshold || stream.high_threshold > kMaxEdgeThreshold) {
+            std::cerr << "Неверные пороги краёв потока " << stream.name << ": " << stream.low_threshold << ":"
+                      << stream.high_threshold << std::endl;
+            g_free(speed_preset_arg);
+            g_free(tune_arg);
+            g_free(stages_arg);
+            return -1;
+        }
+        if (stages_arg || stream.stages.empty()) {
+            stream.stages = stages_arg ? stages_arg : standard_stages();
+        }
+        StageGraph graph;
+        std::string stages_error;
+        if (!graph.compile(stream.stages, stages_error)) {
+            std::cerr << "Неверные стадии потока " << stream.name << " (" << stream.stages << "): " << stages_error
+                      << std::endl;
+            g_free(speed_preset_arg);
+            g_free(tune_arg);
+            g_free(stages_arg);
+            return -1;
+        }
+        stream.stages = stages_to_string(graph.stages());
+    }
+    g_free(speed_preset_arg);
+    g_free(tune_arg);
+    g_free(stages_arg);
+    batch.stages = streams[0].stages;
+
+    int analysis_level = 0;
+    if (analysis_level_arg) {
+        std::string level_text = analysis_level_arg;
+        g_free(analysis_level_arg);
+        if (!parse_analysis_level(level_text, analysis_level)) {
+            std::cerr << "Неверный уровень анализа: " << level_text << std::endl;
+            return -1;
+        }
+        if (bridge && analysis_level != 0) {
+            std::cerr << "Уровень анализа поддерживается только в режиме cvfilter" << std::endl;
+            return -1;
+        }
+        for (const StreamConfig &stream : streams) {
+            if (analysis_level != 0 && stream.stages != standard_stages()) {
+                std::cerr << "Уровень анализа не применяется к стадиям потока " << stream.name << " ("
+                          << stream.stages << "): они обрабатывают кадр целиком" << std::endl;
+                return -1;
+            }
+        }
+    }
+
+    bool any_metadata = false;
+    bool all_metadata = true;
+    for (const StreamConfig &stream : streams) {
+        any_metadata = any_metadata || !stream.metadata_receivers.empty();
+        all_metadata = all_metadata && !stream.metadata_receivers.empty();
+    }
+    if (bridge && (any_metadata || !video)) {
+        std::cerr << "Отправка контуров поддерживается только в режиме cvfilter" << std::endl;
+        return -1;
+    }
+    if (!video && !all_metadata && !shm) {
+        std::cerr << "Без видео каждому потоку нужен получатель контуров (--metadata или metadata-receivers) "
+                     "или кольцо кадров --shm" << std::endl;
+        return -1;
+    }
+    // Запись событий: кольцо предзаписи на выходе кодера каждого потока
+    RecorderConfig recorder_config;
+    bool record = record_dir != NULL;
+    std::string record_format = record_format_arg ? record_format_arg : "mp4";
+    g_free(record_format_arg);
+    if (record_dir) {
+        recorder_config.directory = record_dir;
+        g_free(record_dir);
+        if (!video) {
+            std::cerr << "Запись событий сохраняет видео H.264 и несовместима с --no-video" << std::endl;
+            return -1;
+        }
+        if (record_format != "mp4" && record_format != "mkv") {
+            std::cerr << "Неизвестный контейнер записи: " << record_format << std::endl;
+            return -1;
+        }
+        if (record_preroll < 0 || record_postroll < 0 || record_budget_mb <= 0 || record_on_spike < 0 ||
+            record_max_duration <= 0 || record_max_mb <= 0) {
+            std::cerr << "Неверные параметры записи событий" << std::endl;
+            return -1;
+        }
+        if (g_mkdir_with_parents(recorder_config.directory.c_str(), 0755) != 0) {
+            std::cerr << "Не удалось создать каталог " << recorder_config.directory << std::endl;
+            return -1;
+        }
+        recorder_config.container = record_format;
+        recorder_config.preroll = record_preroll;
+        recorder_config.postroll = record_postroll;
+        recorder_config.budget_bytes = (size_t)record_budget_mb << 20;
+        recorder_config.max_duration = record_max_duration;
+        recorder_config.max_bytes = (size_t)record_max_mb << 20;
+    }
+    if (shm && shm_slots < 2) {
+        std::cerr << "В кольце кадров нужно не меньше двух слотов: " << shm_slots << std::endl;
+        return -1;
+    }
+    if (!video && adaptive) {
+        std::cerr << "Режим --adaptive управляет кодером и несовместим с --no-video" << std::endl;
+        return -1;
+    }
+
+    InstrumentationConfig instrumentation_config;
+    instrumentation_config.trace_path = trace_path ? trace_path : "";
+    instrumentation_config.trace_start = trace_start;
+    instrumentation_config.trace_seconds = trace_seconds;
+    instrumentation_config.stats_path = stats_path ? stats_path : "";
+    instrumentation_config.stats_port = stats_port;
+    instrumentation_config.stats_interval = stats_interval;
+    g_free(trace_path);
+    g_free(stats_path);
+
+    if (!bridge && !cv_filter_register()) {
+        std::cerr << "Не удалось зарегистрировать элемент cvfilter!" << std::endl;
+        return -1;
+    }
+    
+    // Создаем главный цикл
+    main_loop = g_main_loop_new(NULL, FALSE);
+    
+    // Завершение по сигналам вместо ESC в окне
+    g_unix_signal_add(SIGINT, quit_on_signal, main_loop);
+    g_unix_signal_add(SIGTERM, quit_on_signal, main_loop);
+
+    // Optional low-rate preview fed from a single-slot mailbox
+    std::unique_ptr<Preview> preview;
+    if (!headless && batch.inputs.empty()) {
+        preview.reset(new Preview("GStreamer + OpenCV", preview_fps));
+        preview->set_quit_callback([]() { g_main_loop_quit(main_loop); });
+        preview->start();
+    }
+
+    std::unique_ptr<LatencyProbe> latency;
+    if (latency_arg) {
+        latency.reset(new LatencyProbe());
+    }
+
+    std::unique_ptr<Instrumentation> instrumentation;
+    if (instrumentation_config.enabled()) {
+        instrumentation.reset(new Instrumentation(instrumentation_config));
+        instrumentation->start();
+    }
+
+    std::unique_ptr<ControlServer> control;
+    if (control_port > 0) {
+        control.reset(new ControlServer(control_port));
+        if (!control->start()) {
+            control.reset();
+        }
+    }
+
+    // Один пул обработки на все камеры процесса
+    SchedulerConfig scheduler_config;
+    scheduler_config.workers = workers > 0 ? workers : 0;
+    scheduler_config.pin_cpus = pin_cpus;
+    WorkerScheduler scheduler(scheduler_config);
+    scheduler.start();
+
+    RunContext ctx;
+    ctx.executor = executor_config;
+    ctx.format = format;
+    ctx.scheduler = &scheduler;
+    ctx.preview = preview.get();
+    ctx.latency = latency.get();
+    ctx.instrumentation = instrumentation.get();
+    ctx.control = control.get();
+    ctx.adaptive.min_bitrate = min_bitrate > 0 ? min_bitrate : 1;
+    ctx.adaptive_enabled = adaptive;
+    ctx.incremental = incremental;
+    ctx.video = video;
+    ctx.metadata.epsilon = metadata_epsilon > 0 ? metadata_epsilon : 0;
+    ctx.analysis_level = analysis_level;
+    ctx.output_blur = output_blur;
+    ctx.analysis_budget = analysis_budget_ms > 0 ? (guint64)(analysis_budget_ms * GST_MSECOND) : 0;
+    ctx.shm_slots = shm ? (uint32_t)shm_slots : 0;
+    ctx.record = record;
+    ctx.recorder = recorder_config;
+    ctx.spike_ratio = record_on_spike;
+
+    int ret;
+    if (!batch.inputs.empty()) {
+        ret = run_batch(batch, scheduler);
+    } else {
+        // Кадры параллелит общий планировщик; полосы detect_edges в пуле
+        // OpenCV заняли бы те же ядра второй раз, как и в пакетном режиме
+        bool shared = bridge || streams.size() > 1;
+        int cv_threads = cv::getNumThreads();
+        if (shared) {
+            cv::setNumThreads(1);
+        }
+        ret = bridge ? run_bridge(streams, ctx) : run_filter_pipelines(streams, ctx);
+        if (shared) {
+            cv::setNumThreads(cv_threads);
+        }
+    }
+
+    scheduler.stop();
+
+    if (control) {
+        control->stop();
+    }
+
+    if (instrumentation) {
+        instrumentation->stop();
+    }
+
+    if (latency && ret == 0) {
+        latency->print(std::cout);
+    }
+
+    if (preview) {
+        preview->stop();
+    }
     
     g_main_loop_unref(main_loop);
     
-    std::cout << "Программа завершена" << std::endl;
+    if (ret == 0) {
+        std::cout << "Программа завершена" << std::endl;
+    }
     
-    return 0;
+    return ret;
 }
@@ -0,0 +1,58 @@
+#include "metadata_output.hpp"
+
+#include <gst/app/gstappsrc.h>
+
+MetadataOutput::MetadataOutput(const ContourPacketParams &params)
+    : appsrc_(nullptr), writer_(params), sequence_(0), frames_(0), bytes_(0) {}
+
+MetadataOutput::~MetadataOutput() {
+    if (appsrc_) {
+        gst_object_unref(appsrc_);
+    }
+}
+
+bool MetadataOutput::create(GstBin *bin, const StreamConfig &stream) {
+    appsrc_ = gst_element_factory_make("appsrc", "metadata_source");
+    if (appsrc_) {
+        gst_object_ref_sink(appsrc_);
+    }
+    if (!appsrc_ || !fanout_.create(bin, stream, stream.metadata_receivers, "metadata")) {
+        return false;
+    }
+
+    GstCaps *caps = gst_caps_new_empty_simple("application/x-vidstream-contours");
+    g_object_set(G_OBJECT(appsrc_),
+                 "caps", caps,
+                 "stream-type", 0,  // GST_APP_STREAM_TYPE_STREAM
+                 "format", GST_FORMAT_TIME,
+                 "is-live", TRUE,
+                 NULL);
+    gst_caps_unref(caps);
+
+    // Датаграммы уходят сразу: метка кадра есть в самих данных, а ожидание
+    // по часам только добавило бы задержку
+    g_object_set(G_OBJECT(fanout_.sink()), "sync", FALSE, "async", FALSE, NULL);
+
+    gst_bin_add(bin, appsrc_);
+    return gst_element_link(appsrc_, fanout_.input());
+}
+
+void MetadataOutput::push(const FlatContours &contours, GstClockTime pts, cv::Size frame_size) {
+    writer_.encode(contours, sequence_++, GST_CLOCK_TIME_IS_VALID(pts) ? pts : kContourPacketNoPts, frame_size);
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < writer_.datagrams(); ++i) {
+        size_t size = writer_.datagram_size(i);
+        GstBuffer *buffer = gst_buffer_new_allocate(NULL, size, NULL);
+        gst_buffer_fill(buffer, 0, writer_.datagram(i), size);
+        GST_BUFFER_PTS(buffer) = pts;
+        // appsrc забирает ссылку на буфер
+        if (gst_app_src_push_buffer(GST_APP_SRC(appsrc_), buffer) != GST_FLOW_OK) {
+            return;
+        }
+        bytes += size;
+    }
+
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
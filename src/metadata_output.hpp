@@ -0,0 +1,46 @@
+#ifndef VIDSTREAM_METADATA_OUTPUT_HPP
+#define VIDSTREAM_METADATA_OUTPUT_HPP
+
+#include <opencv2/core.hpp>
+#include <gst/gst.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "contour_packet.hpp"
+#include "stream_config.hpp"
+#include "udp_fanout.hpp"
+
+// Выход контуров потока по UDP: "appsrc ! queue ! multiudpsink" в конвейере
+// потока, получатели - metadata_receivers. Контуры кадра кодируются в
+// датаграммы ContourPacketWriter и уходят без кодирования видео, поэтому
+// может работать вместе с H.264 или вместо него.
+class MetadataOutput {
+public:
+    explicit MetadataOutput(const ContourPacketParams &params);
+    ~MetadataOutput();
+
+    MetadataOutput(const MetadataOutput &) = delete;
+    MetadataOutput &operator=(const MetadataOutput &) = delete;
+
+    bool create(GstBin *bin, const StreamConfig &stream);
+
+    // Из потока обработки, по кадру за вызов; pts - GST_CLOCK_TIME_NONE, если метки нет
+    void push(const FlatContours &contours, GstClockTime pts, cv::Size frame_size);
+
+    UdpFanout &fanout() { return fanout_; }
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+private:
+    GstElement *appsrc_;
+    UdpFanout fanout_;
+    ContourPacketWriter writer_;
+    uint64_t sequence_;
+
+    std::atomic<uint64_t> frames_;
+    std::atomic<uint64_t> bytes_;
+};
+
+#endif // VIDSTREAM_METADATA_OUTPUT_HPP
@@ -0,0 +1,23 @@
+#include "pipeline_util.hpp"
+
+#include <iostream>
+
+bool wait_for_eos(GstElement *pipeline, const std::string &label) {
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *message = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+                                                     (GstMessageType)(GST_MESSAGE_ERROR | GST_MESSAGE_EOS));
+    gst_object_unref(bus);
+    bool ok = message && GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+    if (message && !ok) {
+        GError *err;
+        gchar *debug;
+        gst_message_parse_error(message, &err, &debug);
+        std::cerr << label << ": " << err->message << std::endl;
+        g_error_free(err);
+        g_free(debug);
+    }
+    if (message) {
+        gst_message_unref(message);
+    }
+    return ok;
+}
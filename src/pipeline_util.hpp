@@ -0,0 +1,12 @@
+#ifndef VIDSTREAM_PIPELINE_UTIL_HPP
+#define VIDSTREAM_PIPELINE_UTIL_HPP
+
+#include <gst/gst.h>
+
+#include <string>
+
+// Ждёт конца потока или ошибки на шине конвейера; ошибка печатается в
+// std::cerr с префиксом label (обычно путь обрабатываемого файла)
+bool wait_for_eos(GstElement *pipeline, const std::string &label);
+
+#endif // VIDSTREAM_PIPELINE_UTIL_HPP
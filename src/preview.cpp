@@ -0,0 +1,85 @@
+#include "preview.hpp"
+
+#include <opencv2/highgui.hpp>
+
+#include <chrono>
+
+using namespace cv;
+
+Preview::Preview(const std::string &window_name, double fps)
+    : window_name_(window_name), fps_(fps > 0 ? fps : 5), running_(false) {
+}
+
+Preview::~Preview() {
+    stop();
+}
+
+void Preview::set_quit_callback(QuitCallback callback) {
+    quit_callback_ = callback;
+}
+
+void Preview::publish(const Mat &frame) {
+    // Под блокировкой только обмен заголовками Mat, без копирования пикселей
+    std::lock_guard<std::mutex> lock(mailbox_mutex_);
+    mailbox_ = frame;
+}
+
+bool Preview::needs_frame() {
+    std::lock_guard<std::mutex> lock(mailbox_mutex_);
+    return mailbox_.empty();
+}
+
+void Preview::start() {
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&Preview::run, this);
+}
+
+void Preview::stop() {
+    if (!running_) {
+        return;
+    }
+    running_ = false;
+    thread_.join();
+}
+
+void Preview::run() {
+    const std::chrono::microseconds period((long long)(1000000.0 / fps_));
+
+    // Все вызовы HighGUI выполняются в этом потоке
+    namedWindow(window_name_, WINDOW_AUTOSIZE);
+
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    while (running_) {
+        Mat frame;
+        {
+            std::lock_guard<std::mutex> lock(mailbox_mutex_);
+            std::swap(frame, mailbox_);
+        }
+
+        if (!frame.empty()) {
+            imshow(window_name_, frame);
+        }
+
+        // Освобождаем кадр до ожидания, чтобы он вернулся в пул
+        frame.release();
+
+        int key = waitKey(1);
+        if (key == 27 && quit_callback_) { // ESC key
+            quit_callback_();
+        }
+
+        next += period;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (next > now) {
+            std::this_thread::sleep_for(next - now);
+        } else {
+            next = now;
+        }
+    }
+
+    destroyWindow(window_name_);
+}
@@ -0,0 +1,52 @@
+#ifndef VIDSTREAM_PREVIEW_HPP
+#define VIDSTREAM_PREVIEW_HPP
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Окно предпросмотра в отдельном потоке. Конвейер только кладёт последний
+// кадр в одноместный почтовый ящик; поток предпросмотра забирает его с
+// заданной частотой, поэтому HighGUI никогда не тормозит обработку.
+class Preview {
+public:
+    typedef std::function<void()> QuitCallback;
+
+    Preview(const std::string &window_name, double fps);
+    ~Preview();
+
+    Preview(const Preview &) = delete;
+    Preview &operator=(const Preview &) = delete;
+
+    // Вызывается при нажатии ESC в окне предпросмотра
+    void set_quit_callback(QuitCallback callback);
+
+    // Заменяет кадр в почтовом ящике; не блокируется на отрисовке
+    void publish(const cv::Mat &frame);
+
+    // Почтовый ящик пуст: предыдущий кадр уже забран потоком предпросмотра.
+    // Позволяет не копировать кадры, которые всё равно не будут показаны.
+    bool needs_frame();
+
+    void start();
+    void stop();
+
+private:
+    void run();
+
+    std::string window_name_;
+    double fps_;
+    QuitCallback quit_callback_;
+
+    std::mutex mailbox_mutex_;
+    cv::Mat mailbox_;
+
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+#endif // VIDSTREAM_PREVIEW_HPP
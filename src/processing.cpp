@@ -0,0 +1,375 @@
+#include "processing.hpp"
+#include "edge_engine.hpp"
+#include "gst_convert.hpp"
+#include "instrumentation.hpp"
+#include "text_stamp.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <cstdio>
+#include <iostream>
+
+using namespace cv;
+
+// Цвета наложения в BGR и их значения Y, U, V (BT.601, ограниченный диапазон)
+static const Scalar kContourBgr(0, 255, 0);
+static const Scalar kTextBgr(0, 0, 255);
+static const int kContourY = 145, kContourU = 54, kContourV = 34;
+static const int kTextY = 81, kTextU = 90, kTextV = 240;
+
+FrameContext &frame_context() {
+    static thread_local FrameContext context;
+    return context;
+}
+
+// Подпись наложения; буфер на стеке вместо std::string на каждый кадр
+struct ContoursInfo {
+    char text[32];
+
+    explicit ContoursInfo(size_t count) {
+        std::snprintf(text, sizeof(text), "Frame contours: %zu", count);
+    }
+};
+
+// Шрифты подписи: на кадре и в планах цветности половинного разрешения
+static const TextStamp &text_stamp() {
+    static const TextStamp stamp(FONT_HERSHEY_SIMPLEX, 0.7, 2);
+    return stamp;
+}
+
+static const TextStamp &chroma_text_stamp() {
+    static const TextStamp stamp(FONT_HERSHEY_SIMPLEX, 0.35, 1);
+    return stamp;
+}
+
+// Размытие, которое на кадрах уровня 0 делает detect_edges: без него
+// пропущенные кадры отличались бы от соседних резкостью
+static void blur_like_edges(const Mat &image, Mat &blurred) {
+    TRACE_SPAN("GaussianBlur");
+    GaussianBlur(image, blurred, Size(5, 5), 1.5);
+}
+
+// Края и контуры кадра в контексте потока, в координатах image. На уровне
+// анализа 0 image размывается в blurred попутно с поиском краёв; на уровнях
+// выше края ищутся в уменьшенной яркости, а image размывается отдельным
+// проходом, только если задан blur.
+static void find_frame_contours(const Mat &image, Mat &blurred, FrameContext &context, int level,
+                                const EdgeParams &params, bool blur) {
+    if (level == 0) {
+        detect_edges(image, blurred, context.edges, params);
+        find_external_contours(context.edges, context.labels, context.contours);
+        return;
+    }
+
+    downsample_luma(image, context.analysis, level);
+    detect_edges(context.analysis, context.analysis_blurred, context.edges, params);
+    find_external_contours(context.edges, context.labels, context.analysis_contours);
+    context.contours.assign_scaled(context.analysis_contours, level);
+    if (blur) {
+        blur_like_edges(image, blurred);
+    }
+}
+
+// Контуры кадра переходят в overlay; прошлые контуры overlay остаются
+// контексту как буфер для следующего кадра
+static void publish_contours(FrameContext &context, ContourOverlay *overlay, int level) {
+    if (overlay) {
+        overlay->contours.swap(context.contours);
+        overlay->level = level;
+    }
+}
+
+void draw_overlay(Mat &frame, const FlatContours &contours, bool with_contours, bool with_stamp) {
+    // Рисуем контуры на исходном изображении
+    if (with_contours) {
+        TRACE_SPAN("drawContours");
+        draw_flat_contours(frame, contours, kContourBgr, 2);
+    }
+    
+    // Добавляем текст с информацией
+    if (with_stamp) {
+        TRACE_SPAN("putText");
+        text_stamp().draw(frame, ContoursInfo(contours.size()).text, Point(10, 30), kTextBgr);
+    }
+}
+
+// Наложение контуров с подписью на кадр
+static void draw_contours_overlay(Mat &frame, const FlatContours &contours) {
+    draw_overlay(frame, contours, true, true);
+}
+
+// Функция для обработки кадров с помощью OpenCV
+Mat process_frame(const Mat &input_frame, ContourOverlay *overlay, const EdgeParams &params) {
+    TRACE_SPAN("process_frame");
+
+    if(input_frame.empty()) {
+        std::cerr << "Error: Empty input frame" << std::endl;
+        return Mat();
+    }
+
+    // Результат рисуется сразу в кадр из пула, который затем
+    // без копирования уходит в appsrc
+    Mat processed_frame = egress_frame_pool().acquire(input_frame.rows, input_frame.cols, input_frame.type());
+    
+    // Размытие по Гауссу и обнаружение краев одним проходом по полосам
+    FrameContext &context = frame_context();
+    find_frame_contours(input_frame, processed_frame, context, 0, params, true);
+    draw_contours_overlay(processed_frame, context.contours);
+    publish_contours(context, overlay, 0);
+    
+    return processed_frame;
+}
+
+Mat redraw_frame(const Mat &input_frame, const ContourOverlay &overlay) {
+    TRACE_SPAN("redraw_frame");
+
+    if(input_frame.empty()) {
+        return Mat();
+    }
+
+    Mat processed_frame = egress_frame_pool().acquire(input_frame.rows, input_frame.cols, input_frame.type());
+    if (overlay.level == 0) {
+        TRACE_SPAN("GaussianBlur.copy");
+        GaussianBlur(input_frame, processed_frame, Size(5, 5), 1.5);
+    } else {
+        input_frame.copyTo(processed_frame);
+    }
+    draw_contours_overlay(processed_frame, overlay.contours);
+    
+    return processed_frame;
+}
+
+void process_frame_in_place(Mat &frame, ContourOverlay *overlay, int level, const EdgeParams &params, bool blur) {
+    TRACE_SPAN("process_frame.in_place");
+
+    if(frame.empty()) {
+        std::cerr << "Error: Empty input frame" << std::endl;
+        return;
+    }
+
+    FrameContext &context = frame_context();
+    find_frame_contours(frame, frame, context, level, params, blur);
+    draw_contours_overlay(frame, context.contours);
+    publish_contours(context, overlay, level);
+}
+
+void redraw_frame_in_place(Mat &frame, const ContourOverlay &overlay, bool blur) {
+    TRACE_SPAN("redraw_frame.in_place");
+
+    if(frame.empty()) {
+        return;
+    }
+
+    if (overlay.level == 0 || blur) {
+        blur_like_edges(frame, frame);
+    }
+    draw_contours_overlay(frame, overlay.contours);
+}
+
+// Поле вокруг изменённой области: радиус размытия 5x5, Собеля и подавления
+// немаксимумов плюс запас, чтобы края внутри области не зависели от её границы
+static const int kDirtyHalo = 8;
+
+// Края изменённых областей; за пределами областей карта краёв остаётся прошлой
+static void update_dirty_edges(const Mat &image, const std::vector<Rect> &dirty, IncrementalState &state) {
+    TRACE_SPAN("dirty_edges");
+
+    Rect bounds(0, 0, image.cols, image.rows);
+    for (const Rect &inner : dirty) {
+        Rect outer = Rect(inner.x - kDirtyHalo, inner.y - kDirtyHalo,
+                          inner.width + 2 * kDirtyHalo, inner.height + 2 * kDirtyHalo) & bounds;
+        detect_edges(image(outer), state.roi_blurred, state.roi_edges, state.edge_params);
+        state.roi_edges(inner - outer.tl()).copyTo(state.edges(inner));
+    }
+}
+
+// Контуры, которые задевают изменённые области, ищутся заново, остальные
+// остаются прошлыми. Область поиска расширяется рамками задетых контуров,
+// пока ни один оставшийся контур не касается её: так найденные контуры
+// целиком лежат внутри области, а RETR_EXTERNAL видит все вложения.
+static void update_dirty_contours(const std::vector<Rect> &dirty, IncrementalState &state, FlatContours &contours) {
+    TRACE_SPAN("dirty_contours");
+
+    Rect bounds(0, 0, state.edges.cols, state.edges.rows);
+
+    Rect region = dirty[0];
+    for (const Rect &rect : dirty) {
+        region |= rect;
+    }
+
+    std::vector<Rect> &boxes = state.boxes;
+    boxes.resize(contours.size());
+    for (size_t i = 0; i < contours.size(); ++i) {
+        boxes[i] = contours.bounding_rect(i);
+    }
+
+    std::vector<char> &keep = state.keep;
+    keep.assign(contours.size(), 1);
+    bool grown = true;
+    while (grown) {
+        grown = false;
+        // Касание тоже считается: новые края могут продолжить контур
+        Rect touch(region.x - 1, region.y - 1, region.width + 2, region.height + 2);
+        for (size_t i = 0; i < contours.size(); ++i) {
+            if (keep[i] && (boxes[i] & touch).area() > 0) {
+                keep[i] = 0;
+                region |= boxes[i];
+                grown = true;
+            }
+        }
+    }
+    region &= bounds;
+
+    find_external_contours(state.edges(region), frame_context().labels, state.found, region.tl());
+
+    state.merged.clear();
+    for (size_t i = 0; i < contours.size(); ++i) {
+        if (keep[i]) {
+            state.merged.append(contours, i);
+        }
+    }
+    for (size_t i = 0; i < state.found.size(); ++i) {
+        state.merged.append(state.found, i);
+    }
+    contours.swap(state.merged);
+}
+
+// Края и контуры кадра по состоянию потока, contours - в координатах image;
+// blur - размыть image на месте, как кадр уровня анализа 0
+static void process_incremental(Mat &image, IncrementalState &state, FlatContours &contours, bool blur) {
+    ChangeResult change = state.detector.update(image);
+
+    if (change.full || state.edges.size() != image.size()) {
+        ++state.frames_full;
+        Mat &blurred = blur ? image : frame_context().analysis_blurred;
+        detect_edges(image, blurred, state.edges, state.edge_params);
+        find_external_contours(state.edges, frame_context().labels, contours);
+        return;
+    }
+
+    if (change.dirty.empty()) {
+        ++state.frames_unchanged;
+    } else {
+        ++state.frames_partial;
+        update_dirty_edges(image, change.dirty, state);
+        update_dirty_contours(change.dirty, state, contours);
+    }
+    if (blur) {
+        blur_like_edges(image, image);
+    }
+}
+
+// Инкрементальная обработка на уровне анализа: на уровне выше 0 края и
+// контуры прошлых кадров хранятся в разрешении уровня, а в overlay
+// попадают контуры в координатах полного кадра; image там размывается,
+// только если задан blur
+static void process_incremental_at(Mat &image, IncrementalState &state, int level, const EdgeParams &params,
+                                   bool blur) {
+    if (state.overlay.level != level || state.edge_params.low_threshold != params.low_threshold ||
+        state.edge_params.high_threshold != params.high_threshold) {
+        state.detector.reset();
+        state.overlay.level = level;
+    }
+    state.edge_params = params;
+
+    if (level == 0) {
+        process_incremental(image, state, state.overlay.contours, true);
+        return;
+    }
+
+    Mat &analysis = frame_context().analysis;
+    downsample_luma(image, analysis, level);
+    process_incremental(analysis, state, state.analysis_contours, false);
+    state.overlay.contours.assign_scaled(state.analysis_contours, level);
+    if (blur) {
+        blur_like_edges(image, image);
+    }
+}
+
+void process_frame_incremental(Mat &frame, IncrementalState &state, int level, const EdgeParams &params,
+                               bool blur) {
+    TRACE_SPAN("process_frame.incremental");
+
+    if(frame.empty()) {
+        std::cerr << "Error: Empty input frame" << std::endl;
+        return;
+    }
+
+    process_incremental_at(frame, state, level, params, blur);
+    draw_contours_overlay(frame, state.overlay.contours);
+}
+
+void draw_overlay(YuvFrame &frame, const FlatContours &contours, bool with_contours, bool with_stamp) {
+    ContoursInfo info(contours.size());
+
+    TRACE_SPAN("draw_yuv");
+
+    // Цветность в половинном разрешении: координаты и толщина делятся на 2
+    const TextStamp &chroma_stamp = chroma_text_stamp();
+    if (with_contours) {
+        draw_flat_contours(frame.y, contours, Scalar(kContourY), 2);
+        if (frame.v.empty()) {
+            // NV12: U и V чередуются в одном плане
+            draw_flat_contours(frame.u, contours, Scalar(kContourU, kContourV), 1, 1);
+        } else {
+            draw_flat_contours(frame.u, contours, Scalar(kContourU), 1, 1);
+            draw_flat_contours(frame.v, contours, Scalar(kContourV), 1, 1);
+        }
+    }
+    if (with_stamp) {
+        text_stamp().draw(frame.y, info.text, Point(10, 30), Scalar(kTextY));
+        if (frame.v.empty()) {
+            chroma_stamp.draw(frame.u, info.text, Point(5, 15), Scalar(kTextU, kTextV));
+        } else {
+            chroma_stamp.draw(frame.u, info.text, Point(5, 15), Scalar(kTextU));
+            chroma_stamp.draw(frame.v, info.text, Point(5, 15), Scalar(kTextV));
+        }
+    }
+}
+
+// Наложение на планы Y/U/V; contours в координатах плана яркости
+static void draw_yuv_overlay(YuvFrame &frame, const FlatContours &contours) {
+    draw_overlay(frame, contours, true, true);
+}
+
+void process_yuv_frame_in_place(YuvFrame &frame, ContourOverlay *overlay, int level, const EdgeParams &params,
+                                bool blur) {
+    TRACE_SPAN("process_frame.yuv");
+
+    if(frame.y.empty() || frame.u.empty()) {
+        std::cerr << "Error: Empty input frame" << std::endl;
+        return;
+    }
+
+    // Размытие пишется обратно в план яркости, как и в BGR-кадре
+    FrameContext &context = frame_context();
+    find_frame_contours(frame.y, frame.y, context, level, params, blur);
+    draw_yuv_overlay(frame, context.contours);
+    publish_contours(context, overlay, level);
+}
+
+void process_yuv_frame_incremental(YuvFrame &frame, IncrementalState &state, int level,
+                                   const EdgeParams &params, bool blur) {
+    TRACE_SPAN("process_frame.yuv_incremental");
+
+    if(frame.y.empty() || frame.u.empty()) {
+        std::cerr << "Error: Empty input frame" << std::endl;
+        return;
+    }
+
+    process_incremental_at(frame.y, state, level, params, blur);
+    draw_yuv_overlay(frame, state.overlay.contours);
+}
+
+void redraw_yuv_frame_in_place(YuvFrame &frame, const ContourOverlay &overlay, bool blur) {
+    TRACE_SPAN("redraw_frame.yuv");
+
+    if(frame.y.empty() || frame.u.empty()) {
+        return;
+    }
+
+    if (overlay.level == 0 || blur) {
+        blur_like_edges(frame.y, frame.y);
+    }
+    draw_yuv_overlay(frame, overlay.contours);
+}
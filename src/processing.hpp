@@ -0,0 +1,117 @@
+#ifndef VIDSTREAM_PROCESSING_HPP
+#define VIDSTREAM_PROCESSING_HPP
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "change_detector.hpp"
+#include "edge_engine.hpp"
+#include "flat_contours.hpp"
+
+// Контуры последнего обработанного кадра потока: кадр, который регулятор
+// нагрузки пропускает, получает то же наложение без поиска краёв.
+// Координаты всегда в пикселях полного кадра; level - уровень анализа,
+// на котором контуры найдены.
+struct ContourOverlay {
+    FlatContours contours;
+    int level = 0;
+};
+
+// Рабочие буферы обработки кадра: карта краёв, разметка трассировки
+// контуров и сами контуры. Контекст свой у каждого потока выполнения
+// (рабочие исполнителя и планировщика, потоки фильтров) и переживает кадр,
+// поэтому после первых кадров обработка не выделяет память.
+struct FrameContext {
+    cv::Mat edges;
+    cv::Mat labels;
+    FlatContours contours;
+    cv::Mat analysis;  // уменьшенная яркость кадра и её размытие для уровня анализа > 0
+    cv::Mat analysis_blurred;
+    FlatContours analysis_contours;
+};
+
+// Контекст текущего потока выполнения
+FrameContext &frame_context();
+
+// Уровень анализа level: края и контуры ищутся в яркости кадра, уменьшенной
+// в 2^level раз (downsample_luma), а контуры переводятся в координаты полного
+// кадра и рисуются на нём. На уровне 0 кадр размывается попутно с поиском
+// краёв. На уровнях выше полный кадр размывается, только если задан blur:
+// это отдельный проход по всем пикселям, его цена от уровня не зависит.
+// Поэтому по умолчанию кадр уровня выше 0 остаётся резким, а blur = true
+// даёт выход того же вида, что на уровне 0, при любом уровне.
+//
+// params - пороги гистерезиса поиска краёв; могут меняться от кадра к кадру.
+
+// Размытие, поиск контуров и наложение их на кадр;
+// overlay, если задан, получает найденные контуры
+cv::Mat process_frame(const cv::Mat &input_frame, ContourOverlay *overlay = nullptr,
+                      const EdgeParams &params = EdgeParams());
+
+// Облегчённый вариант process_frame: размытие (если контуры найдены на
+// уровне 0) и наложение готовых контуров
+cv::Mat redraw_frame(const cv::Mat &input_frame, const ContourOverlay &overlay);
+
+// То же самое поверх памяти кадра, без отдельного выходного буфера
+void process_frame_in_place(cv::Mat &frame, ContourOverlay *overlay = nullptr, int level = 0,
+                            const EdgeParams &params = EdgeParams(), bool blur = false);
+
+// Облегчённая обработка: только наложение готовых контуров и размытие,
+// если контуры найдены на уровне 0 или задан blur
+void redraw_frame_in_place(cv::Mat &frame, const ContourOverlay &overlay, bool blur = false);
+
+// Состояние потока для инкрементальной обработки: карта краёв и контуры
+// прошлых кадров и детектор изменений. Без изменений в кадре края и
+// контуры берутся готовыми; при изменении части кадра края пересчитываются
+// только в изменённых областях (с полем по краям), а контуры - только те,
+// что задевают эти области. При сильном движении кадр обрабатывается целиком.
+// Карта краёв и детектор работают в разрешении уровня анализа; смена уровня
+// обрабатывает кадр целиком, как и смена порогов краёв.
+struct IncrementalState {
+    ChangeDetector detector;
+    cv::Mat edges;
+    ContourOverlay overlay;
+    FlatContours analysis_contours;  // контуры в координатах уровня анализа > 0
+    EdgeParams edge_params;  // пороги, с которыми построена карта краёв
+    cv::Mat roi_blurred;  // рабочие буферы пересчёта областей
+    cv::Mat roi_edges;
+    std::vector<cv::Rect> boxes;
+    std::vector<char> keep;
+    FlatContours found;
+    FlatContours merged;
+
+    uint64_t frames_full = 0;
+    uint64_t frames_partial = 0;
+    uint64_t frames_unchanged = 0;
+};
+
+// Результат совпадает с process_frame_in_place с точностью до краёв у
+// границ изменённых областей (гистерезис не видит кадр целиком)
+void process_frame_incremental(cv::Mat &frame, IncrementalState &state, int level = 0,
+                               const EdgeParams &params = EdgeParams(), bool blur = false);
+
+// Кадр YUV 4:2:0 поверх планов буфера. Для I420 u и v - отдельные планы
+// CV_8UC1 половинного разрешения, для NV12 u - план CV_8UC2 с чередованием
+// U/V, а v пуст.
+struct YuvFrame {
+    cv::Mat y;
+    cv::Mat u;
+    cv::Mat v;
+};
+
+// Края ищутся прямо по плану яркости, контуры и подпись рисуются в планы
+// Y/U/V, поэтому перевод в BGR и обратно не нужен
+void process_yuv_frame_in_place(YuvFrame &frame, ContourOverlay *overlay = nullptr, int level = 0,
+                                const EdgeParams &params = EdgeParams(), bool blur = false);
+void redraw_yuv_frame_in_place(YuvFrame &frame, const ContourOverlay &overlay, bool blur = false);
+void process_yuv_frame_incremental(YuvFrame &frame, IncrementalState &state, int level = 0,
+                                   const EdgeParams &params = EdgeParams(), bool blur = false);
+
+// Наложение по частям для графа стадий (stage_graph.hpp): контуры и/или
+// подпись с их числом, в BGR-кадр или в планы YUV
+void draw_overlay(cv::Mat &frame, const FlatContours &contours, bool with_contours = true, bool with_stamp = true);
+void draw_overlay(YuvFrame &frame, const FlatContours &contours, bool with_contours = true, bool with_stamp = true);
+
+#endif // VIDSTREAM_PROCESSING_HPP
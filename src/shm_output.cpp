@@ -0,0 +1,79 @@
+#include "shm_output.hpp"
+
+#include <cstring>
+#include <iostream>
+
+ShmOutput::ShmOutput(const std::string &name, uint32_t slots)
+    : name_(name), slots_(slots), have_info_(false), failed_(false), frames_(0) {
+    gst_video_info_init(&info_);
+}
+
+ShmOutput::~ShmOutput() {
+    writer_.close();
+}
+
+bool ShmOutput::attach(GstElement *element, const char *pad_name) {
+    GstPad *pad = gst_element_get_static_pad(element, pad_name);
+    if (!pad) {
+        return false;
+    }
+    gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                      on_pad_probe, this, NULL);
+    gst_object_unref(pad);
+    return true;
+}
+
+GstPadProbeReturn ShmOutput::on_pad_probe(GstPad *, GstPadProbeInfo *info, gpointer data) {
+    ShmOutput *output = static_cast<ShmOutput *>(data);
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        output->write(GST_PAD_PROBE_INFO_BUFFER(info));
+    } else if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            GstCaps *caps = NULL;
+            gst_event_parse_caps(event, &caps);
+            output->have_info_ = gst_video_info_from_caps(&output->info_, caps);
+        }
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+void ShmOutput::write(GstBuffer *buffer) {
+    if (!have_info_ || failed_) {
+        return;
+    }
+
+    const size_t size = gst_buffer_get_size(buffer);
+    if (!writer_.is_open() || size > writer_.frame_capacity()) {
+        std::string error;
+        if (!writer_.create(name_, slots_, size, error)) {
+            std::cerr << "Не удалось создать кольцо кадров " << error << std::endl;
+            failed_ = true;
+            return;
+        }
+    }
+
+    ShmFrameInfo frame;
+    frame.pts = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : kShmNoPts;
+    frame.width = (uint32_t)GST_VIDEO_INFO_WIDTH(&info_);
+    frame.height = (uint32_t)GST_VIDEO_INFO_HEIGHT(&info_);
+    std::strncpy(frame.format, gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&info_)), sizeof(frame.format) - 1);
+    frame.size = (uint32_t)size;
+
+    // Раскладка планов буфера может отличаться от caps (например, у v4l2src)
+    GstVideoMeta *meta = gst_buffer_get_video_meta(buffer);
+    frame.planes = meta ? meta->n_planes : GST_VIDEO_INFO_N_PLANES(&info_);
+    for (uint32_t i = 0; i < frame.planes && i < kShmMaxPlanes; ++i) {
+        frame.offsets[i] = (uint32_t)(meta ? meta->offset[i] : GST_VIDEO_INFO_PLANE_OFFSET(&info_, i));
+        frame.strides[i] = (uint32_t)(meta ? meta->stride[i] : GST_VIDEO_INFO_PLANE_STRIDE(&info_, i));
+    }
+
+    // Копия из памяти буфера сразу в слот, без промежуточного gst_buffer_map
+    // (он склеивал бы буфер из нескольких GstMemory)
+    uint8_t *out = writer_.begin(frame);
+    gst_buffer_extract(buffer, 0, out, size);
+    writer_.commit();
+    frames_.fetch_add(1, std::memory_order_relaxed);
+}
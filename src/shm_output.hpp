@@ -0,0 +1,48 @@
+#ifndef VIDSTREAM_SHM_OUTPUT_HPP
+#define VIDSTREAM_SHM_OUTPUT_HPP
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "shm_ring.hpp"
+
+// Выход обработанных кадров потока в кольцо разделяемой памяти (shm_ring.hpp)
+// для процессов на том же узле. Пад-проба на выходе обработки копирует
+// буфер прямо в слот кольца - одна копия на кадр, без кодирования; читатели
+// берут кадр из слота на месте. Кольцо создаётся по первому кадру и
+// пересоздаётся, если кадр перестал помещаться в слот.
+class ShmOutput {
+public:
+    ShmOutput(const std::string &name, uint32_t slots);
+    ~ShmOutput();
+
+    ShmOutput(const ShmOutput &) = delete;
+    ShmOutput &operator=(const ShmOutput &) = delete;
+
+    // Кадры с пада pad_name элемента; выход должен пережить конвейер
+    bool attach(GstElement *element, const char *pad_name);
+
+    const std::string &name() const { return name_; }
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }
+
+private:
+    static GstPadProbeReturn on_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    void write(GstBuffer *buffer);
+
+    std::string name_;
+    uint32_t slots_;
+    ShmRingWriter writer_;
+
+    // Только в потоке конвейера
+    GstVideoInfo info_;
+    bool have_info_;
+    bool failed_;  // кольцо не создаётся - кадры не пишутся
+
+    std::atomic<uint64_t> frames_;
+};
+
+#endif // VIDSTREAM_SHM_OUTPUT_HPP
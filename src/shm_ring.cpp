@@ -0,0 +1,314 @@
+#include "shm_ring.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+static size_t align64(size_t size) {
+    return (size + 63) & ~(size_t)63;
+}
+
+static std::string system_error(const std::string &name) {
+    return name + ": " + std::strerror(errno);
+}
+
+std::string shm_ring_name(const std::string &stream) {
+    std::string name = "/vidstream." + stream;
+    for (size_t i = 1; i < name.size(); ++i) {
+        if (name[i] == '/') {
+            name[i] = '_';
+        }
+    }
+    return name;
+}
+
+ShmRingWriter::ShmRingWriter()
+    : base_(nullptr), mapped_size_(0), header_(nullptr), frame_capacity_(0), published_(0), writing_(false) {}
+
+ShmRingWriter::~ShmRingWriter() {
+    close();
+}
+
+// Кольцо прежнего писателя: его читатели должны узнать, что кадров больше не будет
+static void close_stale_ring(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmRingHeader)) {
+        void *mapped = mmap(NULL, sizeof(ShmRingHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped != MAP_FAILED) {
+            ShmRingHeader *header = static_cast<ShmRingHeader *>(mapped);
+            if (header->magic == kShmRingMagic) {
+                header->closed.store(1, std::memory_order_release);
+            }
+            munmap(mapped, sizeof(ShmRingHeader));
+        }
+    }
+    ::close(fd);
+    shm_unlink(name.c_str());
+}
+
+bool ShmRingWriter::create(const std::string &name, uint32_t slot_count, size_t frame_capacity, std::string &error) {
+    close();
+    if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos) {
+        error = "имя кольца должно иметь вид /имя: " + name;
+        return false;
+    }
+    if (slot_count < 2) {
+        error = "в кольце нужно не меньше двух слотов";
+        return false;
+    }
+
+    close_stale_ring(name);
+
+    const size_t data_offset = align64(sizeof(ShmRingHeader));
+    const size_t slot_size = kShmSlotDataOffset + align64(frame_capacity);
+    const size_t total = data_offset + slot_size * slot_count;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        error = system_error(name);
+        return false;
+    }
+    if (ftruncate(fd, (off_t)total) != 0) {
+        error = system_error(name);
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void *mapped = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        error = system_error(name);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // Память после ftruncate заполнена нулями: sequence слотов 0 не совпадает
+    // ни с одним записанным кадром
+    base_ = static_cast<uint8_t *>(mapped);
+    mapped_size_ = total;
+    header_ = new (base_) ShmRingHeader();
+    header_->version = kShmRingVersion;
+    header_->slot_count = slot_count;
+    header_->slot_size = slot_size;
+    header_->data_offset = data_offset;
+    header_->published.store(0, std::memory_order_relaxed);
+    header_->closed.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        new (base_ + data_offset + i * slot_size) ShmSlotHeader();
+        slot(i)->sequence.store(0, std::memory_order_relaxed);
+    }
+
+    // Сигнатура последней: читатель, увидевший её, видит и остальной заголовок
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kShmRingMagic;
+
+    name_ = name;
+    frame_capacity_ = frame_capacity;
+    published_ = 0;
+    writing_ = false;
+    return true;
+}
+
+void ShmRingWriter::close() {
+    if (!header_) {
+        return;
+    }
+    header_->closed.store(1, std::memory_order_release);
+    munmap(base_, mapped_size_);
+    shm_unlink(name_.c_str());
+    base_ = nullptr;
+    header_ = nullptr;
+    mapped_size_ = 0;
+    frame_capacity_ = 0;
+    writing_ = false;
+}
+
+ShmSlotHeader *ShmRingWriter::slot(uint64_t frame) const {
+    return reinterpret_cast<ShmSlotHeader *>(base_ + header_->data_offset +
+                                             (frame % header_->slot_count) * header_->slot_size);
+}
+
+uint8_t *ShmRingWriter::begin(const ShmFrameInfo &info) {
+    if (!header_ || info.size > frame_capacity_) {
+        return nullptr;
+    }
+
+    // Нечётный счётчик - до любых изменений слота
+    ShmSlotHeader *s = slot(published_);
+    s->sequence.store(2 * published_ + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s->info = info;
+    writing_ = true;
+    return reinterpret_cast<uint8_t *>(s) + kShmSlotDataOffset;
+}
+
+void ShmRingWriter::commit() {
+    if (!writing_) {
+        return;
+    }
+    writing_ = false;
+    slot(published_)->sequence.store(2 * published_ + 2, std::memory_order_release);
+    ++published_;
+    header_->published.store(published_, std::memory_order_release);
+}
+
+bool ShmRingWriter::write(const ShmFrameInfo &info, const uint8_t *data) {
+    uint8_t *out = begin(info);
+    if (!out) {
+        return false;
+    }
+    std::memcpy(out, data, info.size);
+    commit();
+    return true;
+}
+
+ShmRingReader::ShmRingReader() : base_(nullptr), mapped_size_(0), header_(nullptr), next_(0), lost_(0) {}
+
+ShmRingReader::~ShmRingReader() {
+    close();
+}
+
+bool ShmRingReader::open(const std::string &name, std::string &error) {
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error = system_error(name);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        error = system_error(name);
+        ::close(fd);
+        return false;
+    }
+    const size_t size = (size_t)st.st_size;
+    if (size < sizeof(ShmRingHeader)) {
+        error = name + ": кольцо ещё не создано";
+        ::close(fd);
+        return false;
+    }
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        error = system_error(name);
+        return false;
+    }
+
+    const ShmRingHeader *header = static_cast<const ShmRingHeader *>(mapped);
+    std::string problem;
+    if (header->magic != kShmRingMagic) {
+        problem = "кольцо ещё не создано";
+    } else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->version != kShmRingVersion) {
+            problem = "другая версия кольца";
+        } else if (header->slot_count < 2 || header->slot_size <= kShmSlotDataOffset ||
+                   header->data_offset < sizeof(ShmRingHeader) ||
+                   header->data_offset + header->slot_size * header->slot_count > size) {
+            problem = "повреждённый заголовок кольца";
+        }
+    }
+    if (!problem.empty()) {
+        error = name + ": " + problem;
+        munmap(mapped, size);
+        return false;
+    }
+
+    base_ = static_cast<uint8_t *>(mapped);
+    mapped_size_ = size;
+    header_ = header;
+    next_ = header_->published.load(std::memory_order_acquire);
+    lost_ = 0;
+    return true;
+}
+
+void ShmRingReader::close() {
+    if (!header_) {
+        return;
+    }
+    munmap(base_, mapped_size_);
+    base_ = nullptr;
+    header_ = nullptr;
+    mapped_size_ = 0;
+}
+
+bool ShmRingReader::writer_closed() const {
+    return !header_ || header_->closed.load(std::memory_order_acquire) != 0;
+}
+
+const ShmSlotHeader *ShmRingReader::slot(uint64_t frame) const {
+    return reinterpret_cast<const ShmSlotHeader *>(base_ + header_->data_offset +
+                                                   (frame % header_->slot_count) * header_->slot_size);
+}
+
+bool ShmRingReader::read(uint64_t number, ShmFrame &frame) const {
+    const ShmSlotHeader *s = slot(number);
+    const uint64_t expected = 2 * number + 2;
+    if (s->sequence.load(std::memory_order_acquire) != expected) {
+        return false;
+    }
+    ShmFrameInfo info = s->info;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s->sequence.load(std::memory_order_relaxed) != expected ||
+        info.size > header_->slot_size - kShmSlotDataOffset || info.planes > kShmMaxPlanes) {
+        return false;
+    }
+
+    frame.number = number;
+    frame.info = info;
+    frame.data = reinterpret_cast<const uint8_t *>(s) + kShmSlotDataOffset;
+    return true;
+}
+
+bool ShmRingReader::next(ShmFrame &frame) {
+    if (!header_) {
+        return false;
+    }
+
+    // Слот кадра published может уже перезаписываться, поэтому безопасно
+    // доступны только slot_count - 1 последних кадров
+    const uint64_t window = header_->slot_count - 1;
+    uint64_t published;
+    while (next_ < (published = header_->published.load(std::memory_order_acquire))) {
+        if (published - next_ > window) {
+            lost_ += published - window - next_;
+            next_ = published - window;
+        }
+        if (read(next_++, frame)) {
+            return true;
+        }
+        ++lost_;
+    }
+    return false;
+}
+
+bool ShmRingReader::latest(ShmFrame &frame) {
+    if (!header_) {
+        return false;
+    }
+    const uint64_t published = header_->published.load(std::memory_order_acquire);
+    if (published <= next_) {
+        return false;
+    }
+    next_ = published;
+    return read(published - 1, frame);
+}
+
+bool ShmRingReader::valid(const ShmFrame &frame) const {
+    if (!header_) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot(frame.number)->sequence.load(std::memory_order_relaxed) == 2 * frame.number + 2;
+}
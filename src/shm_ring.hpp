@@ -0,0 +1,162 @@
+#ifndef VIDSTREAM_SHM_RING_HPP
+#define VIDSTREAM_SHM_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Кольцо обработанных кадров в разделяемой памяти POSIX (shm_open) для
+// процессов на том же узле: кадры без кодирования, читатели берут их прямо
+// из отображённой памяти. Библиотека не зависит от GStreamer и OpenCV,
+// читателю достаточно этого заголовка и shm_ring.cpp.
+//
+// Объект "/vidstream.<поток>" (см. shm_ring_name):
+//   ShmRingHeader                       с начала, выровнен на 64 байта
+//   slot_count слотов по slot_size байт  с data_offset
+//     ShmSlotHeader                     выровнен на 64 байта
+//     данные кадра                      с начала слота + kShmSlotDataOffset
+//
+// Кадр n пишется в слот n % slot_count. Слот защищён счётчиком sequence
+// (seqlock): на время записи кадра n в нём 2n + 1, после - 2n + 2, поэтому
+// читатели не берут блокировок и не видны писателю - подключаются и
+// отключаются в любой момент. Читатель проверяет sequence до и после
+// использования данных: если кадр успели перезаписать, результат отбрасывается.
+// Писатель не ждёт читателей: отставший читатель теряет кадры.
+//
+// Когда писатель завершается или пересоздаёт кольцо под кадры большего
+// размера, в старом кольце выставляется closed и имя отвязывается;
+// читатель должен открыть кольцо заново.
+
+static const uint32_t kShmRingMagic = 0x464d5356;  // "VSMF"
+static const uint32_t kShmRingVersion = 1;
+static const size_t kShmMaxPlanes = 4;
+static const uint64_t kShmNoPts = UINT64_MAX;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "атомарные счётчики кольца должны работать между процессами");
+
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t slot_size;                // байт на слот вместе с ShmSlotHeader
+    uint64_t data_offset;              // смещение первого слота
+    std::atomic<uint64_t> published;   // записано кадров; последний - published - 1
+    std::atomic<uint32_t> closed;      // 1 - писатель больше не пишет в это кольцо
+};
+
+// Описание кадра; format - имя формата GStreamer (BGR, I420, NV12, ...)
+struct ShmFrameInfo {
+    uint64_t pts = kShmNoPts;          // нс, PTS буфера
+    uint32_t width = 0;
+    uint32_t height = 0;
+    char format[16] = {};
+    uint32_t planes = 0;
+    uint32_t size = 0;                 // байт данных кадра
+    uint32_t offsets[kShmMaxPlanes] = {};
+    uint32_t strides[kShmMaxPlanes] = {};
+};
+
+struct ShmSlotHeader {
+    std::atomic<uint64_t> sequence;
+    ShmFrameInfo info;
+};
+
+static const size_t kShmSlotDataOffset = (sizeof(ShmSlotHeader) + 63) & ~(size_t)63;
+
+// Имя объекта кольца для потока: "/vidstream.<поток>", '/' заменяется на '_'
+std::string shm_ring_name(const std::string &stream);
+
+// Писатель кольца; один на кольцо, вызывается из одного потока
+class ShmRingWriter {
+public:
+    ShmRingWriter();
+    ~ShmRingWriter();
+
+    ShmRingWriter(const ShmRingWriter &) = delete;
+    ShmRingWriter &operator=(const ShmRingWriter &) = delete;
+
+    // Создаёт кольцо из slot_count слотов под кадры до frame_capacity байт.
+    // Кольцо с тем же именем, оставшееся от прошлого писателя, закрывается
+    // для его читателей и заменяется.
+    bool create(const std::string &name, uint32_t slot_count, size_t frame_capacity, std::string &error);
+
+    // Помечает кольцо закрытым и удаляет имя; отображение у читателей остаётся
+    void close();
+
+    bool is_open() const { return header_ != nullptr; }
+    size_t frame_capacity() const { return frame_capacity_; }
+    uint64_t published() const { return published_; }
+
+    // Запись кадра прямо в слот: begin возвращает место под info.size байт
+    // (nullptr, если кадр больше frame_capacity), commit публикует кадр
+    uint8_t *begin(const ShmFrameInfo &info);
+    void commit();
+
+    // Копирует кадр целиком; false - кадр не помещается в слот
+    bool write(const ShmFrameInfo &info, const uint8_t *data);
+
+private:
+    ShmSlotHeader *slot(uint64_t frame) const;
+
+    std::string name_;
+    uint8_t *base_;
+    size_t mapped_size_;
+    ShmRingHeader *header_;
+    size_t frame_capacity_;
+    uint64_t published_;
+    bool writing_;
+};
+
+// Кадр в кольце; data указывает в разделяемую память и действителен, пока
+// ShmRingReader::valid(frame) возвращает true
+struct ShmFrame {
+    uint64_t number = 0;               // номер кадра с создания кольца
+    ShmFrameInfo info;
+    const uint8_t *data = nullptr;
+};
+
+// Читатель кольца; читателей может быть сколько угодно, в разных процессах
+class ShmRingReader {
+public:
+    ShmRingReader();
+    ~ShmRingReader();
+
+    ShmRingReader(const ShmRingReader &) = delete;
+    ShmRingReader &operator=(const ShmRingReader &) = delete;
+
+    // Подключается к кольцу; читаются кадры, записанные после подключения
+    bool open(const std::string &name, std::string &error);
+    void close();
+
+    bool is_open() const { return header_ != nullptr; }
+
+    // Писатель закрыл кольцо: новых кадров не будет, нужно открыть заново
+    bool writer_closed() const;
+
+    // Следующий непрочитанный кадр; перезаписанные до чтения кадры
+    // пропускаются и учитываются в lost(). false - новых кадров нет.
+    bool next(ShmFrame &frame);
+
+    // Самый новый кадр; более старые непрочитанные пропускаются без учёта в lost()
+    bool latest(ShmFrame &frame);
+
+    // Кадр ещё не перезаписан: проверяется после использования frame.data
+    bool valid(const ShmFrame &frame) const;
+
+    uint64_t lost() const { return lost_; }
+
+private:
+    bool read(uint64_t number, ShmFrame &frame) const;
+    const ShmSlotHeader *slot(uint64_t frame) const;
+
+    uint8_t *base_;
+    size_t mapped_size_;
+    const ShmRingHeader *header_;
+    uint64_t next_;
+    uint64_t lost_;
+};
+
+#endif // VIDSTREAM_SHM_RING_HPP
@@ -0,0 +1,362 @@
+#include "stage_graph.hpp"
+#include "gst_convert.hpp"
+#include "instrumentation.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <cstdlib>
+
+using namespace cv;
+
+static const char *const kStageNames[] = { "blur", "edges", "threshold", "contours", "draw", "stamp" };
+
+const char *standard_stages() {
+    return "blur,edges,contours,draw,stamp";
+}
+
+bool parse_stages(const std::string &text, std::vector<StageSpec> &stages, std::string &error) {
+    stages.clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string item = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        start = comma == std::string::npos ? text.size() + 1 : comma + 1;
+
+        std::string name = item;
+        std::string value;
+        size_t colon = item.find(':');
+        if (colon != std::string::npos) {
+            name = item.substr(0, colon);
+            value = item.substr(colon + 1);
+        }
+
+        StageSpec stage;
+        bool known = false;
+        for (size_t i = 0; i < sizeof(kStageNames) / sizeof(kStageNames[0]); ++i) {
+            if (name == kStageNames[i]) {
+                stage.kind = (StageKind)i;
+                known = true;
+            }
+        }
+        if (!known) {
+            error = "неизвестная стадия " + (item.empty() ? std::string("(пусто)") : item);
+            return false;
+        }
+        if (!value.empty() || colon != std::string::npos) {
+            char *end = nullptr;
+            long threshold = std::strtol(value.c_str(), &end, 10);
+            if (stage.kind != StageKind::Threshold || value.empty() || *end != '\0' || threshold < 0 ||
+                threshold > 255) {
+                error = "неверный параметр стадии " + item;
+                return false;
+            }
+            stage.threshold = (int)threshold;
+        }
+        stages.push_back(stage);
+    }
+    return true;
+}
+
+std::string stages_to_string(const std::vector<StageSpec> &stages) {
+    std::string text;
+    for (const StageSpec &stage : stages) {
+        if (!text.empty()) {
+            text += ",";
+        }
+        text += kStageNames[(int)stage.kind];
+        if (stage.kind == StageKind::Threshold) {
+            text += ":" + std::to_string(stage.threshold);
+        }
+    }
+    return text;
+}
+
+// Время шагов в сводке и трассе; место измерения - у ядра, а не у графа,
+// поэтому одинаковые шаги разных потоков складываются
+static TraceSite blur_edges_site("stage.blur+edges");
+static TraceSite edges_site("stage.edges");
+static TraceSite blur_site("stage.blur");
+static TraceSite threshold_site("stage.threshold");
+static TraceSite contours_site("stage.contours");
+static TraceSite draw_stamp_site("stage.draw+stamp");
+static TraceSite draw_site("stage.draw");
+static TraceSite stamp_site("stage.stamp");
+
+// Ядра шагов. Карта краёв и контуры - в контексте потока, как у process_frame
+
+// Размытие, яркость, Собель и гистерезис одним проходом; размытие - в image
+static void blur_edges_kernel(StageFrame &frame, const StageStep &, const EdgeParams &params) {
+    detect_edges(*frame.src, *frame.image, frame_context().edges, params);
+}
+
+static void edges_kernel(StageFrame &frame, const StageStep &, const EdgeParams &params) {
+    detect_edges_sharp(*frame.src, frame_context().edges, params);
+}
+
+// Размытие как у detect_edges
+static void blur_kernel(StageFrame &frame, const StageStep &, const EdgeParams &) {
+    GaussianBlur(*frame.src, *frame.image, Size(5, 5), 1.5);
+}
+
+static void threshold_kernel(StageFrame &frame, const StageStep &step, const EdgeParams &) {
+    threshold_luma(*frame.src, frame_context().edges, step.threshold);
+}
+
+static void contours_kernel(StageFrame &, const StageStep &, const EdgeParams &) {
+    FrameContext &context = frame_context();
+    find_external_contours(context.edges, context.labels, context.contours);
+}
+
+// Вариант наложения выбирается при сборке графа
+template <bool Contours, bool Stamp>
+static void overlay_kernel(StageFrame &frame, const StageStep &, const EdgeParams &) {
+    if (frame.yuv) {
+        draw_overlay(*frame.yuv, *frame.contours, Contours, Stamp);
+    } else {
+        draw_overlay(*frame.image, *frame.contours, Contours, Stamp);
+    }
+}
+
+static StageStep make_step(void (*kernel)(StageFrame &, const StageStep &, const EdgeParams &), TraceSite &site,
+                           int threshold = 0) {
+    StageStep step;
+    step.kernel = kernel;
+    step.site = &site;
+    step.name = site.name() + 6;  // без "stage."
+    step.threshold = threshold;
+    return step;
+}
+
+StageGraph::StageGraph() : standard_(false), contours_(false), first_writes_frame_(false) {
+    std::string error;
+    compile(standard_stages(), error);
+}
+
+bool StageGraph::compile(const std::string &text, std::string &error) {
+    std::vector<StageSpec> stages;
+    return parse_stages(text, stages, error) && compile(stages, error);
+}
+
+bool StageGraph::compile(const std::vector<StageSpec> &stages, std::string &error) {
+    if (stages.empty()) {
+        error = "пустой список стадий";
+        return false;
+    }
+
+    std::vector<StageStep> steps;
+    std::vector<StageStep> redraw_steps;
+    bool have_map = false;
+    bool have_contours = false;
+    bool drawn = false;
+    bool stamped = false;
+
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const StageKind kind = stages[i].kind;
+        const bool next_edges = i + 1 < stages.size() && stages[i + 1].kind == StageKind::Edges;
+        const bool next_stamp = i + 1 < stages.size() && stages[i + 1].kind == StageKind::Stamp;
+
+        switch (kind) {
+            case StageKind::Blur:
+                redraw_steps.push_back(make_step(blur_kernel, blur_site));
+                if (next_edges && !have_map) {
+                    steps.push_back(make_step(blur_edges_kernel, blur_edges_site));
+                    have_map = true;
+                    ++i;
+                } else {
+                    steps.push_back(make_step(blur_kernel, blur_site));
+                }
+                break;
+            case StageKind::Edges:
+            case StageKind::Threshold:
+                if (have_map) {
+                    error = "карта краёв строится один раз: edges или threshold";
+                    return false;
+                }
+                steps.push_back(kind == StageKind::Edges ? make_step(edges_kernel, edges_site)
+                                                         : make_step(threshold_kernel, threshold_site, stages[i].threshold));
+                have_map = true;
+                break;
+            case StageKind::Contours:
+                if (!have_map || have_contours) {
+                    error = have_contours ? "контуры ищутся один раз" : "контурам нужна карта краёв: edges или threshold";
+                    return false;
+                }
+                steps.push_back(make_step(contours_kernel, contours_site));
+                have_contours = true;
+                break;
+            case StageKind::Draw:
+            case StageKind::Stamp: {
+                bool draw = kind == StageKind::Draw;
+                bool stamp = kind == StageKind::Stamp || next_stamp;
+                if (!have_contours || (draw && drawn) || (stamp && stamped)) {
+                    error = !have_contours ? "наложению нужны контуры" : "наложение повторяется";
+                    return false;
+                }
+                StageStep step;
+                if (draw && stamp) {
+                    step = make_step(overlay_kernel<true, true>, draw_stamp_site);
+                } else if (draw) {
+                    step = make_step(overlay_kernel<true, false>, draw_site);
+                } else {
+                    step = make_step(overlay_kernel<false, true>, stamp_site);
+                }
+                steps.push_back(step);
+                redraw_steps.push_back(step);
+                drawn = drawn || draw;
+                stamped = stamped || stamp;
+                if (draw && stamp) {
+                    ++i;
+                }
+                break;
+            }
+        }
+    }
+
+    stages_ = stages;
+    steps_.swap(steps);
+    redraw_steps_.swap(redraw_steps);
+    standard_ = stages_to_string(stages) == standard_stages();
+    contours_ = have_contours;
+    first_writes_frame_ = steps_[0].kernel == blur_kernel || steps_[0].kernel == blur_edges_kernel;
+    return true;
+}
+
+std::string StageGraph::plan() const {
+    std::string text;
+    for (const StageStep &step : steps_) {
+        text += (text.empty() ? "" : " > ") + std::string(step.name);
+    }
+    return text;
+}
+
+void StageGraph::execute(const std::vector<StageStep> &steps, StageFrame &frame, const EdgeParams &params) {
+    for (const StageStep &step : steps) {
+        ScopedSpan span(*step.site);
+        step.kernel(frame, step, params);
+        // Следующие шаги читают результат
+        frame.src = frame.image;
+    }
+}
+
+// Контуры кадра переходят в overlay, как у process_frame
+void StageGraph::run_steps(StageFrame &frame, ContourOverlay *overlay, const EdgeParams &params) const {
+    FrameContext &context = frame_context();
+    frame.contours = &context.contours;
+    if (!contours_) {
+        context.contours.clear();
+    }
+    execute(steps_, frame, params);
+    if (overlay) {
+        overlay->contours.swap(context.contours);
+        overlay->level = 0;
+    }
+}
+
+void StageGraph::run(Mat &frame, ContourOverlay *overlay, const EdgeParams &params) const {
+    if (standard_) {
+        process_frame_in_place(frame, overlay, 0, params);
+        return;
+    }
+    TRACE_SPAN("stage_graph.run");
+    if (frame.empty()) {
+        return;
+    }
+    StageFrame stage;
+    stage.src = &frame;
+    stage.image = &frame;
+    run_steps(stage, overlay, params);
+}
+
+void StageGraph::run(YuvFrame &frame, ContourOverlay *overlay, const EdgeParams &params) const {
+    if (standard_) {
+        process_yuv_frame_in_place(frame, overlay, 0, params);
+        return;
+    }
+    TRACE_SPAN("stage_graph.run_yuv");
+    if (frame.y.empty() || frame.u.empty()) {
+        return;
+    }
+    StageFrame stage;
+    stage.src = &frame.y;
+    stage.image = &frame.y;
+    stage.yuv = &frame;
+    run_steps(stage, overlay, params);
+}
+
+Mat StageGraph::process(const Mat &input, ContourOverlay *overlay, const EdgeParams &params) const {
+    if (standard_) {
+        return process_frame(input, overlay, params);
+    }
+    TRACE_SPAN("stage_graph.process");
+    if (input.empty()) {
+        return Mat();
+    }
+
+    Mat output = egress_frame_pool().acquire(input.rows, input.cols, input.type());
+    StageFrame stage;
+    stage.image = &output;
+    if (first_writes_frame_) {
+        stage.src = &input;
+    } else {
+        input.copyTo(output);
+        stage.src = &output;
+    }
+    run_steps(stage, overlay, params);
+    return output;
+}
+
+void StageGraph::redraw(Mat &frame, const ContourOverlay &overlay) const {
+    if (standard_) {
+        redraw_frame_in_place(frame, overlay);
+        return;
+    }
+    TRACE_SPAN("stage_graph.redraw");
+    if (frame.empty()) {
+        return;
+    }
+    StageFrame stage;
+    stage.src = &frame;
+    stage.image = &frame;
+    stage.contours = &overlay.contours;
+    execute(redraw_steps_, stage, EdgeParams());
+}
+
+void StageGraph::redraw(YuvFrame &frame, const ContourOverlay &overlay) const {
+    if (standard_) {
+        redraw_yuv_frame_in_place(frame, overlay);
+        return;
+    }
+    TRACE_SPAN("stage_graph.redraw_yuv");
+    if (frame.y.empty() || frame.u.empty()) {
+        return;
+    }
+    StageFrame stage;
+    stage.src = &frame.y;
+    stage.image = &frame.y;
+    stage.yuv = &frame;
+    stage.contours = &overlay.contours;
+    execute(redraw_steps_, stage, EdgeParams());
+}
+
+Mat StageGraph::redraw_copy(const Mat &input, const ContourOverlay &overlay) const {
+    if (standard_) {
+        return redraw_frame(input, overlay);
+    }
+    TRACE_SPAN("stage_graph.redraw_copy");
+    if (input.empty()) {
+        return Mat();
+    }
+
+    Mat output = egress_frame_pool().acquire(input.rows, input.cols, input.type());
+    StageFrame stage;
+    stage.image = &output;
+    stage.contours = &overlay.contours;
+    if (!redraw_steps_.empty() && redraw_steps_[0].kernel == blur_kernel) {
+        stage.src = &input;
+    } else {
+        input.copyTo(output);
+        stage.src = &output;
+    }
+    execute(redraw_steps_, stage, EdgeParams());
+    return output;
+}
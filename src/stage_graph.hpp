@@ -0,0 +1,115 @@
+#ifndef VIDSTREAM_STAGE_GRAPH_HPP
+#define VIDSTREAM_STAGE_GRAPH_HPP
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+#include "edge_engine.hpp"
+#include "processing.hpp"
+
+class TraceSite;
+
+// Стадия обработки кадра
+enum class StageKind {
+    Blur,       // размытие Гаусса 5x5 (sigma 1.5) кадра на месте
+    Edges,      // карта краёв: Собель по яркости, подавление немаксимумов, гистерезис
+    Threshold,  // карта краёв: яркость выше порога
+    Contours,   // внешние контуры карты краёв
+    Draw,       // контуры на кадре
+    Stamp       // подпись с числом контуров
+};
+
+struct StageSpec {
+    StageKind kind = StageKind::Blur;
+    int threshold = 128;  // порог яркости стадии Threshold
+};
+
+// Список стадий через запятую: "blur,edges,contours,draw,stamp"; порог
+// задаётся после двоеточия: "threshold:96"
+bool parse_stages(const std::string &text, std::vector<StageSpec> &stages, std::string &error);
+std::string stages_to_string(const std::vector<StageSpec> &stages);
+
+// Стандартная цепочка process_frame
+const char *standard_stages();
+
+// Кадр шага графа: src - откуда читать, image - куда писать (BGR-кадр или
+// план яркости); для YUV наложение рисуется в планы yuv. contours -
+// контуры для наложения: найденные графом или готовые при перерисовке
+struct StageFrame {
+    const cv::Mat *src = nullptr;
+    cv::Mat *image = nullptr;
+    YuvFrame *yuv = nullptr;
+    const FlatContours *contours = nullptr;
+};
+
+// Шаг плана графа: одна или несколько слитых стадий
+struct StageStep {
+    void (*kernel)(StageFrame &frame, const StageStep &step, const EdgeParams &params);
+    TraceSite *site;
+    const char *name;
+    int threshold;
+};
+
+// Граф обработки кадра, собранный из списка стадий. compile() раскладывает
+// стадии на шаги плана: соседние стадии, для которых есть слитое ядро,
+// выполняются одним шагом без промежуточного кадра -
+//
+//   blur,edges   - detect_edges: размытие, яркость, Собель и гистерезис
+//                  одним проходом по полосам, размытие пишется в кадр;
+//   edges        - тот же проход без размытия (detect_edges_sharp);
+//   threshold    - яркость и порог одним проходом (threshold_luma);
+//   draw,stamp   - наложение с подписью, вариант ядра выбран шаблоном.
+//
+// Шаг - указатель на функцию, выбранный при сборке; внутри шага нет
+// виртуальных вызовов и ветвлений по списку стадий. Список, совпадающий со
+// стандартным, выполняется готовыми путями process_frame*, включая
+// инкрементальную обработку и уровни анализа: standard() сообщает об этом
+// вызывающему. Время каждого шага пишется в спан "stage.<шаг>" (сводка
+// --stats-file, трасса --trace).
+//
+// Граф не меняется после сборки и выполняется из любого числа потоков;
+// рабочие буферы - в контексте потока (frame_context()).
+class StageGraph {
+public:
+    // Стандартная цепочка
+    StageGraph();
+
+    // false - стадии не складываются в граф (контуры без карты краёв и т.п.)
+    bool compile(const std::vector<StageSpec> &stages, std::string &error);
+    bool compile(const std::string &text, std::string &error);
+
+    bool standard() const { return standard_; }
+
+    const std::vector<StageSpec> &stages() const { return stages_; }
+    // Шаги плана: "blur+edges > contours > draw+stamp"
+    std::string plan() const;
+
+    // Обработка кадра на месте; overlay получает найденные контуры.
+    // Стандартный граф - process_frame_in_place с уровнем 0
+    void run(cv::Mat &frame, ContourOverlay *overlay, const EdgeParams &params = EdgeParams()) const;
+    void run(YuvFrame &frame, ContourOverlay *overlay, const EdgeParams &params = EdgeParams()) const;
+
+    // Результат в кадре из пула вывода, как process_frame; если первый шаг
+    // размывает кадр, размытие пишется сразу в него, без копии входа
+    cv::Mat process(const cv::Mat &input, ContourOverlay *overlay, const EdgeParams &params = EdgeParams()) const;
+
+    // Кадр без обработки: размытие и наложение готовых контуров, как у графа
+    void redraw(cv::Mat &frame, const ContourOverlay &overlay) const;
+    void redraw(YuvFrame &frame, const ContourOverlay &overlay) const;
+    cv::Mat redraw_copy(const cv::Mat &input, const ContourOverlay &overlay) const;
+
+private:
+    static void execute(const std::vector<StageStep> &steps, StageFrame &frame, const EdgeParams &params);
+    void run_steps(StageFrame &frame, ContourOverlay *overlay, const EdgeParams &params) const;
+
+    std::vector<StageSpec> stages_;
+    std::vector<StageStep> steps_;
+    std::vector<StageStep> redraw_steps_;  // размытие и наложение без анализа
+    bool standard_;
+    bool contours_;  // граф ищет контуры; иначе у кадра их нет
+    bool first_writes_frame_;  // первый шаг пишет весь кадр из src
+};
+
+#endif // VIDSTREAM_STAGE_GRAPH_HPP
@@ -0,0 +1,144 @@
+#include "stream_config.hpp"
+
+#include <glib.h>
+
+#include <cstdlib>
+
+bool parse_receiver(const std::string &text, Receiver &receiver) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == text.size()) {
+        return false;
+    }
+    char *end = nullptr;
+    long port = std::strtol(text.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || port <= 0 || port > 65535) {
+        return false;
+    }
+    receiver.host = text.substr(0, colon);
+    receiver.port = (int)port;
+    return true;
+}
+
+std::string receiver_to_string(const Receiver &receiver) {
+    return receiver.host + ":" + std::to_string(receiver.port);
+}
+
+std::vector<Receiver> StreamConfig::all_receivers() const {
+    Receiver primary;
+    primary.host = host;
+    primary.port = port;
+
+    std::vector<Receiver> result(1, primary);
+    for (const Receiver &receiver : receivers) {
+        if (!(receiver == primary)) {
+            result.push_back(receiver);
+        }
+    }
+    return result;
+}
+
+static std::string key_string(GKeyFile *file, const gchar *group, const gchar *key, const std::string &fallback) {
+    gchar *value = g_key_file_get_string(file, group, key, NULL);
+    if (!value) {
+        return fallback;
+    }
+    std::string result = value;
+    g_free(value);
+    return result;
+}
+
+static int key_int(GKeyFile *file, const gchar *group, const gchar *key, int fallback) {
+    GError *error = NULL;
+    int value = g_key_file_get_integer(file, group, key, &error);
+    if (error) {
+        g_error_free(error);
+        return fallback;
+    }
+    return value;
+}
+
+// Список адресов "host:port;host:port"; отсутствующий ключ - пустой список
+static bool key_receivers(GKeyFile *file, const gchar *group, const gchar *key,
+                          std::vector<Receiver> &result, std::string &error) {
+    gsize count = 0;
+    gchar **values = g_key_file_get_string_list(file, group, key, &count, NULL);
+    for (gsize i = 0; i < count; ++i) {
+        Receiver receiver;
+        if (!parse_receiver(values[i], receiver)) {
+            error = std::string("неверный получатель ") + values[i] + " в группе " + group;
+            g_strfreev(values);
+            return false;
+        }
+        result.push_back(receiver);
+    }
+    g_strfreev(values);
+    return true;
+}
+
+bool load_stream_configs(const std::string &path, std::vector<StreamConfig> &streams, std::string &error) {
+    GKeyFile *file = g_key_file_new();
+    GError *gerror = NULL;
+
+    if (!g_key_file_load_from_file(file, path.c_str(), G_KEY_FILE_NONE, &gerror)) {
+        error = gerror->message;
+        g_error_free(gerror);
+        g_key_file_free(file);
+        return false;
+    }
+
+    gsize count = 0;
+    gchar **groups = g_key_file_get_groups(file, &count);
+
+    streams.clear();
+    for (gsize i = 0; i < count; ++i) {
+        StreamConfig defaults;
+        StreamConfig stream;
+        stream.name = groups[i];
+        stream.device = key_string(file, groups[i], "device", defaults.device);
+        stream.width = key_int(file, groups[i], "width", defaults.width);
+        stream.height = key_int(file, groups[i], "height", defaults.height);
+        stream.host = key_string(file, groups[i], "host", defaults.host);
+        stream.port = key_int(file, groups[i], "port", defaults.port + (int)i);
+        stream.priority = key_int(file, groups[i], "priority", defaults.priority);
+        stream.multicast_ttl = key_int(file, groups[i], "multicast-ttl", defaults.multicast_ttl);
+        stream.multicast_iface = key_string(file, groups[i], "multicast-iface", defaults.multicast_iface);
+        stream.bitrate = key_int(file, groups[i], "bitrate", defaults.bitrate);
+        stream.speed_preset = key_string(file, groups[i], "speed-preset", defaults.speed_preset);
+        stream.tune = key_string(file, groups[i], "tune", defaults.tune);
+        stream.low_threshold = key_int(file, groups[i], "low-threshold", defaults.low_threshold);
+        stream.high_threshold = key_int(file, groups[i], "high-threshold", defaults.high_threshold);
+        stream.stages = key_string(file, groups[i], "stages", defaults.stages);
+
+        if (stream.width <= 0 || stream.height <= 0) {
+            error = std::string("неверный размер кадра в группе ") + groups[i];
+            g_strfreev(groups);
+            g_key_file_free(file);
+            return false;
+        }
+
+        if (stream.bitrate < 0 || stream.low_threshold < -1 || stream.high_threshold < -1) {
+            error = std::string("неверный битрейт или порог краёв в группе ") + groups[i];
+            g_strfreev(groups);
+            g_key_file_free(file);
+            return false;
+        }
+
+        if (!key_receivers(file, groups[i], "receivers", stream.receivers, error) ||
+            !key_receivers(file, groups[i], "metadata-receivers", stream.metadata_receivers, error)) {
+            g_strfreev(groups);
+            g_key_file_free(file);
+            return false;
+        }
+
+        streams.push_back(stream);
+    }
+
+    g_strfreev(groups);
+    g_key_file_free(file);
+
+    if (streams.empty()) {
+        error = "в файле нет ни одного потока";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef VIDSTREAM_STREAM_CONFIG_HPP
+#define VIDSTREAM_STREAM_CONFIG_HPP
+
+#include <string>
+#include <vector>
+
+// Адрес получателя RTP-потока; адрес группы multicast тоже допустим
+struct Receiver {
+    std::string host;
+    int port = 0;
+
+    bool operator==(const Receiver &other) const { return host == other.host && port == other.port; }
+};
+
+// Разбирает "host:port"; false - строка не является адресом
+bool parse_receiver(const std::string &text, Receiver &receiver);
+std::string receiver_to_string(const Receiver &receiver);
+
+// Пара "камера -> UDP-получатели", обрабатываемая в общем процессе
+struct StreamConfig {
+    std::string name = "camera0";
+    std::string device = "/dev/video0";
+    int width = 640;  // размер кадров после захвата и масштабирования
+    int height = 480;
+    std::string host = "127.0.0.1";
+    int port = 5000;
+    std::vector<Receiver> receivers;  // дополнительные получатели того же потока
+    int priority = 1;  // доля общего пула обработки
+    int multicast_ttl = 1;
+    std::string multicast_iface;  // пусто - интерфейс по умолчанию
+    std::vector<Receiver> metadata_receivers;  // получатели контуров без видео
+    // Кодер и обработка; 0, пустая строка и -1 - значение из командной строки
+    // или по умолчанию
+    int bitrate = 0;  // кбит/с
+    std::string speed_preset;
+    std::string tune;
+    int low_threshold = -1;  // пороги поиска краёв
+    int high_threshold = -1;
+    std::string stages;  // стадии обработки, см. StageGraph
+
+    // Основной получатель и дополнительные
+    std::vector<Receiver> all_receivers() const;
+};
+
+// Читает список потоков из INI-файла (формат GKeyFile), по группе на поток:
+//
+//   [camera0]
+//   device=/dev/video0
+//   width=1920
+//   height=1080
+//   host=127.0.0.1
+//   port=5000
+//   receivers=10.0.0.5:5000;239.0.0.1:5004
+//   multicast-ttl=4
+//   metadata-receivers=10.0.0.5:6000
+//   priority=2
+//   bitrate=2000
+//   speed-preset=veryfast
+//   tune=zerolatency
+//   low-threshold=50
+//   high-threshold=150
+//   stages=blur,edges,contours,draw
+//
+// Отсутствующие ключи берутся по умолчанию, порт по умолчанию - 5000 + номер группы.
+// Ключи кодера, порогов и стадий перекрываются явными опциями командной строки.
+bool load_stream_configs(const std::string &path, std::vector<StreamConfig> &streams, std::string &error);
+
+#endif // VIDSTREAM_STREAM_CONFIG_HPP
@@ -0,0 +1,418 @@
+#include "stream_tuner.hpp"
+#include "cv_filter.hpp"
+#include "edge_engine.hpp"
+#include "frame_executor.hpp"
+#include "stage_graph.hpp"
+
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+
+// Значение свойства по его текстовой записи, с проверкой по типу свойства
+static bool set_property_string(GstElement *element, const char *property, const std::string &text,
+                                std::string &error) {
+    GParamSpec *spec = g_object_class_find_property(G_OBJECT_GET_CLASS(element), property);
+    if (!spec) {
+        error = std::string("у ") + GST_ELEMENT_NAME(element) + " нет свойства " + property;
+        return false;
+    }
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(spec));
+    if (!gst_value_deserialize(&value, text.c_str())) {
+        error = std::string("неверное значение ") + property + ": " + text;
+        g_value_unset(&value);
+        return false;
+    }
+    g_object_set_property(G_OBJECT(element), property, &value);
+    g_value_unset(&value);
+    return true;
+}
+
+bool configure_encoder(GstElement *encoder, const EncoderSettings &settings, std::string &error) {
+    if (!set_property_string(encoder, "tune", settings.tune, error) ||
+        !set_property_string(encoder, "speed-preset", settings.speed_preset, error)) {
+        return false;
+    }
+    g_object_set(G_OBJECT(encoder), "bitrate", (guint)settings.bitrate, NULL);  // kbps
+    return true;
+}
+
+// Замена кодера: создаётся в потоке канала управления, встаёт на место
+// старого в потоке конвейера. Проба держит свою копию, если ожидание
+// истекло раньше замены; отменённую замену проба уже не начинает
+struct StreamTuner::Swap {
+    StreamTuner *tuner = nullptr;
+    GstElement *encoder = nullptr;  // новый кодер, наша ссылка до вставки в конвейер
+    EncoderSettings settings;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool started = false;
+    bool cancelled = false;
+    bool done = false;
+    bool linked = false;
+
+    ~Swap() {
+        if (encoder) {
+            gst_object_unref(encoder);
+        }
+    }
+};
+
+StreamTuner::StreamTuner(const std::string &name, const EncoderSettings &settings, bool adaptive)
+    : name_(name),
+      adaptive_(adaptive),
+      pipeline_(nullptr),
+      upstream_(nullptr),
+      downstream_(nullptr),
+      filter_(nullptr),
+      executor_(nullptr),
+      capsfilter_(nullptr),
+      appsink_(nullptr),
+      appsrc_(nullptr),
+      encoder_(nullptr),
+      settings_(settings) {}
+
+StreamTuner::~StreamTuner() {
+    if (encoder_) {
+        gst_object_unref(encoder_);
+    }
+}
+
+void StreamTuner::attach_encoder(GstElement *pipeline, GstElement *upstream, GstElement *encoder,
+                                 GstElement *downstream) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pipeline_ = pipeline;
+    upstream_ = upstream;
+    downstream_ = downstream;
+    encoder_ = GST_ELEMENT(gst_object_ref(encoder));
+}
+
+void StreamTuner::set_encoder_callback(EncoderCallback callback) {
+    encoder_callback_ = callback;
+}
+
+void StreamTuner::attach_filter(GstElement *filter) {
+    filter_ = filter;
+}
+
+void StreamTuner::attach_executor(FrameExecutor *executor) {
+    executor_ = executor;
+}
+
+void StreamTuner::attach_capsfilter(GstElement *capsfilter) {
+    capsfilter_ = capsfilter;
+}
+
+void StreamTuner::attach_bridge(GstElement *appsink, GstElement *appsrc) {
+    appsink_ = appsink;
+    appsrc_ = appsrc;
+}
+
+GstElement *StreamTuner::encoder() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return encoder_ ? GST_ELEMENT(gst_object_ref(encoder_)) : nullptr;
+}
+
+bool StreamTuner::set_bitrate(int bitrate, std::string &error) {
+    if (adaptive_) {
+        error = "битрейтом управляет режим --adaptive";
+        return false;
+    }
+    if (bitrate <= 0) {
+        error = "неверный битрейт " + std::to_string(bitrate);
+        return false;
+    }
+    GstElement *current = encoder();
+    if (!current) {
+        error = "поток без кодера";
+        return false;
+    }
+    // x264enc перенастраивает битрейт на ходу, со следующего кадра
+    g_object_set(G_OBJECT(current), "bitrate", (guint)bitrate, NULL);
+    gst_object_unref(current);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    settings_.bitrate = bitrate;
+    return true;
+}
+
+bool StreamTuner::set_speed_preset(const std::string &preset, std::string &error) {
+    std::lock_guard<std::mutex> swap_lock(swap_mutex_);
+    EncoderSettings settings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        settings = settings_;
+    }
+    settings.speed_preset = preset;
+    return replace_encoder(settings, error);
+}
+
+bool StreamTuner::set_tune(const std::string &tune, std::string &error) {
+    std::lock_guard<std::mutex> swap_lock(swap_mutex_);
+    EncoderSettings settings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        settings = settings_;
+    }
+    settings.tune = tune;
+    return replace_encoder(settings, error);
+}
+
+// Под swap_mutex_
+bool StreamTuner::replace_encoder(const EncoderSettings &settings, std::string &error) {
+    if (adaptive_) {
+        error = "кодер потока занят режимом --adaptive";
+        return false;
+    }
+    GstElement *current = encoder();
+    if (!current) {
+        error = "поток без кодера";
+        return false;
+    }
+
+    // Новый кодер с тем же именем настраивается заранее: неверное значение
+    // отклоняется, не трогая конвейер
+    std::shared_ptr<Swap> swap = std::make_shared<Swap>();
+    swap->tuner = this;
+    swap->settings = settings;
+    swap->encoder = gst_element_factory_make("x264enc", GST_ELEMENT_NAME(current));
+    gst_object_unref(current);
+    if (!swap->encoder) {
+        error = "не удалось создать x264enc";
+        return false;
+    }
+    gst_object_ref_sink(swap->encoder);
+    if (!configure_encoder(swap->encoder, settings, error)) {
+        return false;
+    }
+
+    GstPad *pad = gst_element_get_static_pad(upstream_, "src");
+    gulong probe = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_IDLE, on_idle, new std::shared_ptr<Swap>(swap),
+                                     [](gpointer data) { delete static_cast<std::shared_ptr<Swap> *>(data); });
+
+    // Пауза между буферами бывает каждый кадр; дольше ждать незачем. Если
+    // паузы не было, проба снимается, иначе она заменила бы кодер позже,
+    // уже после ответа об ошибке; начатая замена дожидается конца
+    std::unique_lock<std::mutex> lock(swap->mutex);
+    if (!swap->finished.wait_for(lock, std::chrono::seconds(2), [&swap]() { return swap->done; })) {
+        if (!swap->started) {
+            swap->cancelled = true;
+            lock.unlock();
+            if (probe) {
+                gst_pad_remove_probe(pad, probe);
+            }
+            gst_object_unref(pad);
+            error = "конвейер не освободил кодер, замена отменена";
+            return false;
+        }
+        swap->finished.wait(lock, [&swap]() { return swap->done; });
+    }
+    gst_object_unref(pad);
+    if (!swap->linked) {
+        error = "новый кодер не удалось связать с конвейером";
+        return false;
+    }
+    return true;
+}
+
+GstPadProbeReturn StreamTuner::on_idle(GstPad *, GstPadProbeInfo *, gpointer data) {
+    std::shared_ptr<Swap> swap = *static_cast<std::shared_ptr<Swap> *>(data);
+    {
+        std::lock_guard<std::mutex> lock(swap->mutex);
+        if (swap->cancelled || swap->started) {
+            return GST_PAD_PROBE_REMOVE;
+        }
+        swap->started = true;
+    }
+    swap->tuner->swap_encoder(*swap);
+    {
+        std::lock_guard<std::mutex> lock(swap->mutex);
+        swap->done = true;
+    }
+    swap->finished.notify_all();
+    return GST_PAD_PROBE_REMOVE;
+}
+
+GstPadProbeReturn StreamTuner::on_drain_event(GstPad *, GstPadProbeInfo *info, gpointer) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+    return GST_EVENT_TYPE(event) == GST_EVENT_EOS ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+}
+
+// В потоке конвейера, пока через upstream_ не идут данные
+void StreamTuner::swap_encoder(Swap &swap) {
+    GstElement *old;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        old = encoder_;
+    }
+
+    // Старый кодер отключается от входа и выталкивает задержанные кадры
+    // по EOS; сам EOS дальше его выхода не идёт
+    gst_element_unlink(upstream_, old);
+    GstPad *old_sink = gst_element_get_static_pad(old, "sink");
+    GstPad *old_src = gst_element_get_static_pad(old, "src");
+    gulong drain = gst_pad_add_probe(old_src, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, on_drain_event, NULL, NULL);
+    gst_pad_send_event(old_sink, gst_event_new_eos());
+    gst_pad_remove_probe(old_src, drain);
+    gst_object_unref(old_src);
+    gst_object_unref(old_sink);
+
+    gst_element_unlink(old, downstream_);
+    gst_element_set_state(old, GST_STATE_NULL);
+    gst_bin_remove(GST_BIN(pipeline_), old);
+
+    // Пробы переносятся до запуска, чтобы не пропустить первый кадр
+    GstElement *fresh = swap.encoder;
+    gst_bin_add(GST_BIN(pipeline_), fresh);
+    if (encoder_callback_) {
+        encoder_callback_(fresh);
+    }
+    swap.linked = gst_element_link_many(upstream_, fresh, downstream_, NULL);
+    gst_element_sync_state_with_parent(fresh);
+    if (!swap.linked) {
+        std::cerr << name_ << ": новый кодер не связан с конвейером" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    gst_object_unref(encoder_);
+    encoder_ = fresh;
+    swap.encoder = nullptr;  // ссылка перешла к encoder_
+    settings_ = swap.settings;
+}
+
+bool StreamTuner::set_edge_thresholds(int low, int high, std::string &error) {
+    if (low < 0 || high < low || high > kMaxEdgeThreshold) {
+        error = "ожидается 0 <= LOW <= HIGH <= " + std::to_string(kMaxEdgeThreshold);
+        return false;
+    }
+    if (filter_) {
+        cv_filter_set_edge_thresholds(filter_, low, high);
+    } else if (executor_) {
+        executor_->set_edge_params(low, high);
+    } else {
+        error = "поток без обработки";
+        return false;
+    }
+    return true;
+}
+
+bool StreamTuner::set_stages(const std::string &stages, std::string &error) {
+    std::shared_ptr<StageGraph> graph = std::make_shared<StageGraph>();
+    if (!graph->compile(stages, error)) {
+        return false;
+    }
+    if (filter_) {
+        g_object_set(G_OBJECT(filter_), "stages", stages_to_string(graph->stages()).c_str(), NULL);
+    } else if (executor_) {
+        executor_->set_stage_graph(graph);
+    } else {
+        error = "поток без обработки";
+        return false;
+    }
+    return true;
+}
+
+// Caps с новым размером кадра; остальные поля прежние
+static GstCaps *resize_caps(const GstCaps *caps, int width, int height) {
+    GstCaps *resized = gst_caps_copy(caps);
+    gst_caps_set_simple(resized, "width", G_TYPE_INT, width, "height", G_TYPE_INT, height, NULL);
+    return resized;
+}
+
+bool StreamTuner::set_resolution(int width, int height, std::string &error) {
+    if (capsfilter_) {
+        // capsfilter сам просит пересогласования у videoscale
+        GstCaps *caps = NULL;
+        g_object_get(G_OBJECT(capsfilter_), "caps", &caps, NULL);
+        GstCaps *resized = resize_caps(caps, width, height);
+        g_object_set(G_OBJECT(capsfilter_), "caps", resized, NULL);
+        gst_caps_unref(resized);
+        gst_caps_unref(caps);
+        return true;
+    }
+    if (appsink_ && appsrc_) {
+        GstCaps *caps = gst_app_sink_get_caps(GST_APP_SINK(appsink_));
+        GstStructure *structure = gst_caps_get_structure(caps, 0);
+        int old_width = 0, old_height = 0;
+        gst_structure_get_int(structure, "width", &old_width);
+        gst_structure_get_int(structure, "height", &old_height);
+
+        GstCaps *resized = resize_caps(caps, width, height);
+        gst_app_sink_set_caps(GST_APP_SINK(appsink_), resized);
+        gst_caps_unref(resized);
+        gst_caps_unref(caps);
+
+        // Очередь appsrc держит столько же кадров нового размера; caps
+        // appsrc меняются с первым кадром нового размера
+        if (old_width > 0 && old_height > 0) {
+            guint64 max_bytes = gst_app_src_get_max_bytes(GST_APP_SRC(appsrc_));
+            gst_app_src_set_max_bytes(GST_APP_SRC(appsrc_),
+                                      max_bytes / ((guint64)old_width * old_height) * width * height);
+        }
+
+        GstPad *pad = gst_element_get_static_pad(appsink_, "sink");
+        gst_pad_push_event(pad, gst_event_new_reconfigure());
+        gst_object_unref(pad);
+        return true;
+    }
+    error = "размер кадров потока не задаётся";
+    return false;
+}
+
+std::string StreamTuner::describe() const {
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (encoder_) {
+            int bitrate = settings_.bitrate;
+            if (adaptive_) {
+                guint current = 0;
+                g_object_get(G_OBJECT(encoder_), "bitrate", &current, NULL);
+                bitrate = (int)current;
+            }
+            text += "bitrate=" + std::to_string(bitrate) + " speed-preset=" + settings_.speed_preset +
+                    " tune=" + settings_.tune;
+        }
+    }
+
+    int low = 0, high = 0;
+    std::string stages;
+    if (filter_) {
+        gchar *filter_stages = NULL;
+        cv_filter_get_edge_thresholds(filter_, low, high);
+        g_object_get(G_OBJECT(filter_), "stages", &filter_stages, NULL);
+        stages = filter_stages ? filter_stages : "";
+        g_free(filter_stages);
+    } else if (executor_) {
+        EdgeParams edges = executor_->edge_params();
+        low = edges.low_threshold;
+        high = edges.high_threshold;
+        stages = stages_to_string(executor_->stage_graph()->stages());
+    }
+    if (filter_ || executor_) {
+        text += (text.empty() ? "" : " ") + std::string("edges=") + std::to_string(low) + ":" + std::to_string(high) +
+                " stages=" + stages;
+    }
+
+    GstCaps *caps = NULL;
+    if (capsfilter_) {
+        g_object_get(G_OBJECT(capsfilter_), "caps", &caps, NULL);
+    } else if (appsink_) {
+        caps = gst_app_sink_get_caps(GST_APP_SINK(appsink_));
+    }
+    if (caps) {
+        int width = 0, height = 0;
+        GstStructure *structure = gst_caps_get_structure(caps, 0);
+        if (gst_structure_get_int(structure, "width", &width) && gst_structure_get_int(structure, "height", &height)) {
+            text += (text.empty() ? "" : " ") + std::string("resolution=") + std::to_string(width) + "x" +
+                    std::to_string(height);
+        }
+        gst_caps_unref(caps);
+    }
+    return text;
+}
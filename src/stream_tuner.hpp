@@ -0,0 +1,107 @@
+#ifndef VIDSTREAM_STREAM_TUNER_HPP
+#define VIDSTREAM_STREAM_TUNER_HPP
+
+#include <gst/gst.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+
+class FrameExecutor;
+
+// Настройки кодера H.264 потока
+struct EncoderSettings {
+    int bitrate = 500;  // кбит/с
+    std::string speed_preset = "ultrafast";
+    std::string tune = "zerolatency";
+};
+
+// Настраивает x264enc; preset и tune - имена значений свойств x264enc
+// ("veryfast", "zerolatency+fastdecode"); false - значение неизвестно
+bool configure_encoder(GstElement *encoder, const EncoderSettings &settings, std::string &error);
+
+// Изменение настроек работающего потока без остановки конвейера:
+//
+//   битрейт       - свойство x264enc, меняется в PLAYING;
+//   preset, tune  - x264enc применяет их только при запуске, поэтому кодер
+//                   заменяется новым: проба IDLE на выходе элемента перед
+//                   кодером ждёт паузы между буферами, старый кодер
+//                   дописывает задержанные кадры (EOS до rtph264pay не
+//                   доходит), новый встаёт на его место и начинает с
+//                   ключевого кадра. Получатели видят смену SPS/PPS без
+//                   разрыва потока;
+//   пороги краёв  - свойства cvfilter или FrameExecutor, со следующего кадра;
+//   стадии        - новый граф StageGraph, так же со следующего кадра;
+//   размер кадров - новые caps capsfilter (appsink в режиме --bridge),
+//                   videoscale и всё после него пересогласуются на ходу.
+//
+// Методы вызываются из канала управления; false - изменение не применено.
+class StreamTuner {
+public:
+    // Вызывается с новым кодером до его запуска, чтобы перенести на него пробы
+    typedef std::function<void(GstElement *encoder)> EncoderCallback;
+
+    // adaptive - битрейтом управляет регулятор, кодер заменять нельзя
+    StreamTuner(const std::string &name, const EncoderSettings &settings, bool adaptive);
+    ~StreamTuner();
+
+    StreamTuner(const StreamTuner &) = delete;
+    StreamTuner &operator=(const StreamTuner &) = delete;
+
+    // Кодер между upstream и downstream; без вызова настройки кодера недоступны
+    void attach_encoder(GstElement *pipeline, GstElement *upstream, GstElement *encoder, GstElement *downstream);
+    void set_encoder_callback(EncoderCallback callback);
+
+    // Обработка: cvfilter или исполнитель режима --bridge
+    void attach_filter(GstElement *filter);
+    void attach_executor(FrameExecutor *executor);
+
+    // Размер кадров: capsfilter либо appsink с appsrc режима --bridge
+    void attach_capsfilter(GstElement *capsfilter);
+    void attach_bridge(GstElement *appsink, GstElement *appsrc);
+
+    bool set_bitrate(int bitrate, std::string &error);
+    bool set_speed_preset(const std::string &preset, std::string &error);
+    bool set_tune(const std::string &tune, std::string &error);
+    bool set_edge_thresholds(int low, int high, std::string &error);
+    bool set_resolution(int width, int height, std::string &error);
+    bool set_stages(const std::string &stages, std::string &error);
+
+    // "bitrate=500 speed-preset=ultrafast tune=zerolatency edges=100:200
+    // stages=blur,edges,contours,draw,stamp resolution=640x480"
+    std::string describe() const;
+
+    const std::string &name() const { return name_; }
+
+private:
+    struct Swap;
+
+    static GstPadProbeReturn on_idle(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn on_drain_event(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    bool replace_encoder(const EncoderSettings &settings, std::string &error);
+    void swap_encoder(Swap &swap);
+    GstElement *encoder() const;  // новая ссылка или NULL
+
+    std::string name_;
+    bool adaptive_;
+
+    GstElement *pipeline_;
+    GstElement *upstream_;
+    GstElement *downstream_;
+    GstElement *filter_;
+    FrameExecutor *executor_;
+    GstElement *capsfilter_;
+    GstElement *appsink_;
+    GstElement *appsrc_;
+    EncoderCallback encoder_callback_;
+
+    // Замены кодера идут по одной
+    std::mutex swap_mutex_;
+
+    // Кодер меняется в потоке конвейера
+    mutable std::mutex mutex_;
+    GstElement *encoder_;
+    EncoderSettings settings_;
+};
+
+#endif // VIDSTREAM_STREAM_TUNER_HPP
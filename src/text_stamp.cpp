@@ -0,0 +1,69 @@
+#include "text_stamp.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <string>
+
+using namespace cv;
+
+TextStamp::TextStamp(int font_face, double font_scale, int thickness) {
+    for (int i = 0; i < kCount; ++i) {
+        const char c = (char)(kFirst + i);
+        Glyph &glyph = glyphs_[i];
+
+        // Ширина строки из 8 одинаковых символов даёт шаг пера с точностью 1/8 пикселя
+        int baseline = 0;
+        Size size = getTextSize(std::string(8, c), font_face, font_scale, thickness, &baseline);
+        glyph.advance = (size.width - thickness) / 8.0;
+
+        // Холст с запасом: штрихи толщиной thickness выходят за габарит getTextSize
+        const int margin = 2 * thickness + 4;
+        Size single = getTextSize(std::string(1, c), font_face, font_scale, thickness, &baseline);
+        Mat canvas = Mat::zeros(single.height + baseline + 2 * margin, single.width + 2 * margin, CV_8UC1);
+        Point pen(margin, margin + single.height);
+        putText(canvas, std::string(1, c), pen, font_face, font_scale, Scalar(255), thickness);
+
+        Rect box = boundingRect(canvas);
+        if (box.area() > 0) {
+            glyph.mask = canvas(box).clone();
+            glyph.offset = box.tl() - pen;
+        }
+    }
+}
+
+void TextStamp::draw(Mat &image, const char *text, Point origin, const Scalar &color) const {
+    CV_Assert(image.depth() == CV_8U && image.channels() <= 4);
+
+    const int channels = image.channels();
+    uchar value[4];
+    for (int k = 0; k < channels; ++k) {
+        value[k] = saturate_cast<uchar>(color[k]);
+    }
+
+    const Rect bounds(0, 0, image.cols, image.rows);
+    double pen_x = origin.x;
+    for (const char *c = text; *c; ++c) {
+        int index = (uchar)*c - kFirst;
+        if (index < 0 || index >= kCount) {
+            index = '?' - kFirst;
+        }
+        const Glyph &glyph = glyphs_[index];
+
+        if (!glyph.mask.empty()) {
+            Point tl(cvRound(pen_x) + glyph.offset.x, origin.y + glyph.offset.y);
+            Rect area = Rect(tl, glyph.mask.size()) & bounds;
+            for (int y = area.y; y < area.y + area.height; ++y) {
+                const uchar *mask = glyph.mask.ptr<uchar>(y - tl.y) + (area.x - tl.x);
+                uchar *dst = image.ptr<uchar>(y) + (size_t)area.x * channels;
+                for (int x = 0; x < area.width; ++x, dst += channels) {
+                    if (mask[x]) {
+                        for (int k = 0; k < channels; ++k) {
+                            dst[k] = value[k];
+                        }
+                    }
+                }
+            }
+        }
+        pen_x += glyph.advance;
+    }
+}
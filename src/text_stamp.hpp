@@ -0,0 +1,31 @@
+#ifndef VIDSTREAM_TEXT_STAMP_HPP
+#define VIDSTREAM_TEXT_STAMP_HPP
+
+#include <opencv2/core.hpp>
+
+// Надпись шрифтом Hershey без выделения памяти на кадр. putText на каждый
+// вызов заводит буфер точек, поэтому глифы печатных символов ASCII рисуются
+// им один раз при создании, а при выводе только переносятся в кадр по маске.
+// Отличие от putText - в пределах пикселя: глифы стоят на целых позициях.
+class TextStamp {
+public:
+    TextStamp(int font_face, double font_scale, int thickness);
+
+    // image - CV_8U с 1..4 каналами, origin - левый нижний угол строки, как в putText;
+    // символы вне печатного ASCII выводятся как '?'
+    void draw(cv::Mat &image, const char *text, cv::Point origin, const cv::Scalar &color) const;
+
+private:
+    static const int kFirst = ' ';
+    static const int kCount = '~' - ' ' + 1;
+
+    struct Glyph {
+        cv::Mat mask;      // CV_8UC1, ненулевые пиксели - символ
+        cv::Point offset;  // левый верхний угол маски относительно позиции пера
+        double advance = 0;
+    };
+
+    Glyph glyphs_[kCount];
+};
+
+#endif // VIDSTREAM_TEXT_STAMP_HPP
@@ -0,0 +1,96 @@
+#include "udp_fanout.hpp"
+
+#include <algorithm>
+
+// Около секунды RTP-пакетов 720p потока; больше держать нет смысла, это уже задержка
+static const guint kSendQueuePackets = 256;
+
+UdpFanout::UdpFanout() : queue_(nullptr), sink_(nullptr) {}
+
+UdpFanout::~UdpFanout() {
+    if (sink_) {
+        gst_object_unref(sink_);
+    }
+    if (queue_) {
+        gst_object_unref(queue_);
+    }
+}
+
+bool UdpFanout::create(GstBin *bin, const StreamConfig &stream) {
+    return create(bin, stream, stream.all_receivers(), "fanout");
+}
+
+bool UdpFanout::create(GstBin *bin, const StreamConfig &stream, const std::vector<Receiver> &receivers,
+                       const std::string &prefix) {
+    queue_ = gst_element_factory_make("queue", (prefix + "_queue").c_str());
+    sink_ = gst_element_factory_make("multiudpsink", (prefix + "_sink").c_str());
+    // Элементы будут принадлежать bin, свои ссылки нужны для управления получателями
+    if (queue_) {
+        gst_object_ref_sink(queue_);
+    }
+    if (sink_) {
+        gst_object_ref_sink(sink_);
+    }
+    if (!queue_ || !sink_) {
+        return false;
+    }
+
+    g_object_set(G_OBJECT(queue_),
+                 "max-size-buffers", kSendQueuePackets,
+                 "max-size-bytes", 0,
+                 "max-size-time", (guint64)0,
+                 "leaky", 2,  // downstream: выбрасываются самые старые пакеты
+                 NULL);
+
+    // Повторное добавление того же адреса не должно удваивать трафик.
+    // Пакеты уходят сразу: кадр уже ждал своего времени до кодера, а
+    // ожидание по часам здесь шло бы после метки отправки задержки
+    g_object_set(G_OBJECT(sink_),
+                 "sync", FALSE,
+                 "send-duplicates", FALSE,
+                 "auto-multicast", TRUE,
+                 "ttl-mc", stream.multicast_ttl,
+                 NULL);
+    if (!stream.multicast_iface.empty()) {
+        g_object_set(G_OBJECT(sink_), "multicast-iface", stream.multicast_iface.c_str(), NULL);
+    }
+
+    gst_bin_add_many(bin, queue_, sink_, NULL);
+    if (!gst_element_link(queue_, sink_)) {
+        return false;
+    }
+
+    for (const Receiver &receiver : receivers) {
+        std::string error;
+        add(receiver, error);
+    }
+    return true;
+}
+
+bool UdpFanout::add(const Receiver &receiver, std::string &error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (std::find(receivers_.begin(), receivers_.end(), receiver) != receivers_.end()) {
+        error = "получатель " + receiver_to_string(receiver) + " уже добавлен";
+        return false;
+    }
+    g_signal_emit_by_name(sink_, "add", receiver.host.c_str(), receiver.port, NULL);
+    receivers_.push_back(receiver);
+    return true;
+}
+
+bool UdpFanout::remove(const Receiver &receiver, std::string &error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(receivers_.begin(), receivers_.end(), receiver);
+    if (it == receivers_.end()) {
+        error = "получатель " + receiver_to_string(receiver) + " не найден";
+        return false;
+    }
+    g_signal_emit_by_name(sink_, "remove", receiver.host.c_str(), receiver.port, NULL);
+    receivers_.erase(it);
+    return true;
+}
+
+std::vector<Receiver> UdpFanout::receivers() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return receivers_;
+}
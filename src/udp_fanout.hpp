@@ -0,0 +1,52 @@
+#ifndef VIDSTREAM_UDP_FANOUT_HPP
+#define VIDSTREAM_UDP_FANOUT_HPP
+
+#include <gst/gst.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "stream_config.hpp"
+
+// Раздача одного закодированного RTP-потока любому числу получателей:
+// кадр кодируется один раз, а multiudpsink отправляет каждый пакет всем
+// адресам из списка, поэтому стоимость кодирования не зависит от числа
+// зрителей. Получателей можно добавлять и удалять на ходу из любого потока.
+//
+// Перед multiudpsink стоит короткая очередь, выбрасывающая старые пакеты:
+// если отправка задерживается, теряются пакеты, а кодер и остальная часть
+// конвейера не ждут. UDP не подтверждает доставку, так что медленный или
+// исчезнувший получатель не задерживает отправку остальным.
+class UdpFanout {
+public:
+    UdpFanout();
+    ~UdpFanout();
+
+    UdpFanout(const UdpFanout &) = delete;
+    UdpFanout &operator=(const UdpFanout &) = delete;
+
+    // Создаёт "queue ! multiudpsink" в bin и добавляет получателей потока
+    bool create(GstBin *bin, const StreamConfig &stream);
+    // То же с заданными получателями; prefix - начало имён элементов,
+    // чтобы в одном bin помещалось несколько раздач
+    bool create(GstBin *bin, const StreamConfig &stream, const std::vector<Receiver> &receivers,
+                const std::string &prefix);
+
+    // Элемент, к которому подключается выход rtph264pay или другого источника пакетов
+    GstElement *input() const { return queue_; }
+    GstElement *sink() const { return sink_; }
+
+    bool add(const Receiver &receiver, std::string &error);
+    bool remove(const Receiver &receiver, std::string &error);
+    std::vector<Receiver> receivers() const;
+
+private:
+    GstElement *queue_;
+    GstElement *sink_;
+
+    mutable std::mutex mutex_;
+    std::vector<Receiver> receivers_;
+};
+
+#endif // VIDSTREAM_UDP_FANOUT_HPP
@@ -0,0 +1,242 @@
+#include "worker_scheduler.hpp"
+#include "instrumentation.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <iostream>
+
+// Ядра, на которых процессу разрешено работать
+static std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+static size_t resolve_workers(size_t workers) {
+    if (workers > 0) {
+        return workers;
+    }
+    size_t cpus = allowed_cpus().size();
+    if (cpus == 0) {
+        cpus = std::thread::hardware_concurrency();
+    }
+    return cpus > 0 ? cpus : 1;
+}
+
+WorkerScheduler::WorkerScheduler(const SchedulerConfig &config)
+    : workers_(resolve_workers(config.workers)),
+      pin_cpus_(config.pin_cpus),
+      streams_(new std::atomic<Stream *>[kMaxStreams]),
+      stream_count_(0),
+      running_(false) {
+    for (int i = 0; i < kMaxStreams; ++i) {
+        streams_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+WorkerScheduler::~WorkerScheduler() {
+    stop();
+    for (int i = 0; i < stream_count_.load(); ++i) {
+        delete streams_[i].load();
+    }
+}
+
+int WorkerScheduler::add_stream(const std::string &name, int priority, Poller poller) {
+    return add_stream(name, priority, poller, nullptr);
+}
+
+int WorkerScheduler::add_stream(const std::string &name, int priority, Poller poller,
+                                std::unique_ptr<BoundedQueue<SyncJob *>> jobs) {
+    std::lock_guard<std::mutex> lock(add_mutex_);
+
+    // Сначала слоты отключённых потоков, затем новый слот
+    int count = stream_count_.load(std::memory_order_relaxed);
+    int index = 0;
+    while (index < count && !streams_[index].load(std::memory_order_relaxed)->free) {
+        ++index;
+    }
+    if (index >= kMaxStreams) {
+        std::cerr << "Слишком много потоков в планировщике: " << name << std::endl;
+        return -1;
+    }
+
+    Stream *stream = index < count ? streams_[index].load(std::memory_order_relaxed) : new Stream();
+    stream->name = name;
+    stream->priority = priority > 0 ? priority : 1;
+    stream->poller = poller;
+    stream->jobs = std::move(jobs);
+    stream->free = false;
+
+    if (index == count) {
+        streams_[index].store(stream, std::memory_order_relaxed);
+        stream_count_.store(index + 1, std::memory_order_release);
+    }
+
+    // Рабочие трогают поля потока только после того, как увидят active
+    stream->active.store(true, std::memory_order_release);
+    return index;
+}
+
+int WorkerScheduler::add_stream(const std::string &name, int priority) {
+    // Очередь только для синхронных заданий: в ней не больше одного
+    // задания на каждый ожидающий поток-отправитель
+    std::unique_ptr<BoundedQueue<SyncJob *>> jobs(new BoundedQueue<SyncJob *>(16));
+    BoundedQueue<SyncJob *> *queue = jobs.get();
+
+    return add_stream(name, priority, [queue]() {
+        SyncJob *job;
+        if (!queue->try_pop(job)) {
+            return false;
+        }
+        job->job();
+
+        // Уведомление под блокировкой: после выхода из wait() отправитель
+        // сразу уничтожает SyncJob
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        job->cv.notify_one();
+        return true;
+    }, std::move(jobs));
+}
+
+void WorkerScheduler::run(int stream_index, Job job) {
+    Stream *stream = stream_index >= 0 && stream_index < stream_count_.load(std::memory_order_acquire)
+                         ? streams_[stream_index].load(std::memory_order_relaxed)
+                         : nullptr;
+
+    if (!running_ || !stream || !stream->jobs || !stream->active) {
+        job();
+        return;
+    }
+
+    SyncJob sync;
+    sync.job = job;
+
+    unsigned spins = 0;
+    while (!stream->jobs->try_push(&sync)) {
+        backoff(spins);
+    }
+
+    std::unique_lock<std::mutex> lock(sync.mutex);
+    sync.cv.wait(lock, [&sync]() { return sync.done; });
+}
+
+void WorkerScheduler::remove_stream(int stream_index) {
+    if (stream_index < 0 || stream_index >= stream_count_.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    Stream *stream = streams_[stream_index].load(std::memory_order_relaxed);
+    if (!stream->active) {
+        return;
+    }
+    stream->active = false;
+
+    // Синхронные задания, не взятые рабочими, выполняются здесь,
+    // чтобы их отправители не ждали вечно
+    if (stream->jobs) {
+        while (stream->poller()) {
+        }
+    }
+
+    unsigned spins = 0;
+    while (stream->running.load() > 0) {
+        backoff(spins);
+    }
+
+    std::lock_guard<std::mutex> lock(add_mutex_);
+    stream->free = true;
+}
+
+void WorkerScheduler::start() {
+    if (running_) {
+        return;
+    }
+    running_ = true;
+
+    for (size_t i = 0; i < workers_; ++i) {
+        threads_.emplace_back(&WorkerScheduler::worker_loop, this, i);
+    }
+}
+
+void WorkerScheduler::stop() {
+    if (!running_) {
+        return;
+    }
+    running_ = false;
+
+    for (std::thread &thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+}
+
+void WorkerScheduler::worker_loop(size_t index) {
+    if (pin_cpus_) {
+        std::vector<int> cpus = allowed_cpus();
+        if (!cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[index % cpus.size()], &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+    }
+
+    trace_set_thread_name("worker");
+
+    unsigned spins = 0;
+    size_t home_cursor = index;
+    size_t steal_cursor = index;
+
+    while (running_) {
+        // Свои потоки в первую очередь, чужие - только если своих заданий нет
+        if (serve(index, true, home_cursor) || serve(index, false, steal_cursor)) {
+            spins = 0;
+        } else {
+            backoff(spins);
+        }
+    }
+}
+
+bool WorkerScheduler::serve(size_t index, bool home, size_t &cursor) {
+    int count = stream_count_.load(std::memory_order_acquire);
+    if (count == 0) {
+        return false;
+    }
+
+    bool worked = false;
+    size_t start = cursor++;
+
+    for (int k = 0; k < count; ++k) {
+        int s = (int)((start + k) % count);
+        if (((size_t)s % workers_ == index) != home) {
+            continue;
+        }
+
+        Stream *stream = streams_[s].load(std::memory_order_relaxed);
+
+        // running поднимается до повторной проверки active: remove_stream
+        // либо увидит этого рабочего, либо рабочий увидит отключение
+        stream->running.fetch_add(1);
+        if (stream->active) {
+            for (int j = 0; j < stream->priority; ++j) {
+                if (!stream->poller()) {
+                    break;
+                }
+                worked = true;
+            }
+        }
+        stream->running.fetch_sub(1);
+    }
+
+    return worked;
+}
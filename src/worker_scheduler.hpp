@@ -0,0 +1,108 @@
+#ifndef VIDSTREAM_WORKER_SCHEDULER_HPP
+#define VIDSTREAM_WORKER_SCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_queue.hpp"
+
+struct SchedulerConfig {
+    size_t workers = 0;     // 0 - по числу доступных ядер
+    bool pin_cpus = false;  // привязать рабочий поток i к i-му доступному ядру
+};
+
+// Общий пул рабочих потоков для всех потоков кадров процесса. Вместо
+// отдельного пула на каждую камеру задания всех камер выполняет один пул
+// по числу ядер, поэтому суммарная пропускная способность растёт с числом
+// ядер, а не падает от переподписки.
+//
+// Каждый поток кадров закреплён за "домашним" рабочим (stream % workers):
+// рабочий сначала обслуживает свои потоки и только без работы забирает
+// задания чужих. За один обход рабочий выполняет у потока не больше
+// priority заданий подряд, а начало обхода сдвигается, так что потоки
+// получают процессор пропорционально приоритету и ни один не голодает.
+class WorkerScheduler {
+public:
+    // Выполняет одно задание потока; false - заданий нет. Может вызываться
+    // одновременно из нескольких рабочих потоков.
+    typedef std::function<bool()> Poller;
+    typedef std::function<void()> Job;
+
+    explicit WorkerScheduler(const SchedulerConfig &config);
+    ~WorkerScheduler();
+
+    WorkerScheduler(const WorkerScheduler &) = delete;
+    WorkerScheduler &operator=(const WorkerScheduler &) = delete;
+
+    // Поток с собственным источником заданий (например, очередью исполнителя).
+    // Слот отключённого потока переиспользуется; -1 - заняты все kMaxStreams
+    // слотов.
+    int add_stream(const std::string &name, int priority, Poller poller);
+
+    // Поток, задания которого передаются через run()
+    int add_stream(const std::string &name, int priority);
+
+    // Выполняет задание на рабочем потоке и ждёт завершения. Если
+    // планировщик не запущен или поток отключён, задание выполняется на месте.
+    void run(int stream, Job job);
+
+    // Отключает поток, ждёт, пока рабочие выйдут из его заданий, и
+    // освобождает слот. Вызывается после остановки всех, кто передаёт
+    // задания потока; номер потока после этого недействителен.
+    void remove_stream(int stream);
+
+    size_t workers() const { return workers_; }
+
+    void start();
+    void stop();
+
+private:
+    static const int kMaxStreams = 64;
+
+    struct SyncJob {
+        Job job;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+    };
+
+    struct Stream {
+        std::string name;
+        int priority = 1;
+        Poller poller;
+        std::unique_ptr<BoundedQueue<SyncJob *>> jobs;
+        std::atomic<bool> active;
+        std::atomic<int> running;
+        bool free = false;  // слот отключён и может быть занят заново; под add_mutex_
+
+        Stream() : active(false), running(0) {}
+    };
+
+    int add_stream(const std::string &name, int priority, Poller poller,
+                   std::unique_ptr<BoundedQueue<SyncJob *>> jobs);
+
+    void worker_loop(size_t index);
+    bool serve(size_t index, bool home, size_t &cursor);
+
+    size_t workers_;
+    bool pin_cpus_;
+
+    // Слоты только добавляются, рабочие читают массив без блокировок.
+    // Stream освобождённого слота не удаляется до деструктора: рабочий может
+    // ещё смотреть на его active, поэтому новый поток занимает тот же Stream,
+    // пока он отключён, и включается последним.
+    std::unique_ptr<std::atomic<Stream *>[]> streams_;
+    std::atomic<int> stream_count_;
+    std::mutex add_mutex_;
+
+    std::atomic<bool> running_;
+    std::vector<std::thread> threads_;
+};
+
+#endif // VIDSTREAM_WORKER_SCHEDULER_HPP
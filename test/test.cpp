@@ -4,13 +4,32 @@
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
 #include <gst/app/gstappsrc.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 
-// Предполагаем, что следующие функции и структуры определены в основном коде
-extern cv::Mat gst_sample_to_mat(GstSample* sample);
-extern GstSample* mat_to_gst_sample(const cv::Mat &frame, GstCaps *caps);
-extern cv::Mat process_frame(const cv::Mat &input_frame);
+#include "adaptive_controller.hpp"
+#include "alloc_counter.hpp"
+#include "contour_packet.hpp"
+#include "cv_filter.hpp"
+#include "edge_engine.hpp"
+#include "event_recorder.hpp"
+#include "frame_executor.hpp"
+#include "gst_convert.hpp"
+#include "instrumentation.hpp"
+#include "processing.hpp"
+#include "shm_ring.hpp"
+#include "stage_graph.hpp"
+#include "stream_tuner.hpp"
+
+#include <unistd.h>
+
+// Окна с результатами показываются только с флагом --show:
+// без него тесты не требуют дисплея
+static bool show_windows = false;
 
 // Тестовые функции
 bool test_gstreamer_initialization() {
@@ -35,6 +54,12 @@ bool test_gstreamer_initialization() {
 bool test_camera_connection() {
     std::cout << "Тест подключения камеры... ";
     
+    // Без устройства V4L2 (CI, контейнер) тест пропускается
+    if (!g_file_test("/dev/video0", G_FILE_TEST_EXISTS)) {
+        std::cout << "ПРОПУЩЕН (нет /dev/video0)\n";
+        return true;
+    }
+    
     // Создаем простой конвейер для проверки доступа к камере
     GstElement *pipeline = gst_parse_launch("v4l2src num-buffers=1 ! fakesink", NULL);
     if (!pipeline) {
@@ -77,7 +102,7 @@ bool test_opencv_processing() {
     }
     
     // Отображаем результат, если указан флаг визуализации
-    if (true) {
+    if (show_windows) {
         cv::imshow("Тестовое изображение", test_image);
         cv::imshow("Обработанное изображение", processed);
         cv::waitKey(2000); // Показываем на 2 секунды
@@ -88,6 +113,550 @@ bool test_opencv_processing() {
     return true;
 }
 
+bool test_allocation_free_processing() {
+    std::cout << "Тест обработки без выделения памяти... ";
+    
+    cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(100, 100, 100));
+    cv::rectangle(frame, cv::Rect(100, 100, 200, 200), cv::Scalar(255, 255, 255), -1);
+    cv::rectangle(frame, cv::Rect(150, 150, 50, 50), cv::Scalar(0, 0, 0), -1);
+    cv::circle(frame, cv::Point(450, 240), 80, cv::Scalar(200, 0, 0), -1);
+    
+    // Плоские контуры совпадают с cv::findContours, который отдаёт их в обратном порядке
+    cv::Mat blurred, edges, labels;
+    detect_edges(frame, blurred, edges);
+    std::vector<std::vector<cv::Point>> reference;
+    cv::findContours(edges, reference, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    FlatContours contours;
+    find_external_contours(edges, labels, contours);
+    
+    if (contours.size() != reference.size()) {
+        std::cout << "ОШИБКА: Найдено " << contours.size() << " контуров вместо " << reference.size() << "\n";
+        return false;
+    }
+    for (size_t i = 0; i < contours.size(); ++i) {
+        const std::vector<cv::Point> &expected = reference[reference.size() - 1 - i];
+        if ((size_t)contours.length(i) != expected.size() ||
+            !std::equal(expected.begin(), expected.end(), contours.contour(i))) {
+            std::cout << "ОШИБКА: Контур " << i << " отличается от findContours\n";
+            return false;
+        }
+    }
+    
+    // Пул потоков OpenCV заводит задание на каждый parallel_for_,
+    // поэтому выделения считаются при однопоточном OpenCV
+    int threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    
+    cv::Mat scratch = frame.clone();
+    ContourOverlay overlay;
+    const int warmup = 3;
+    const int frames = 20;
+    for (int i = 0; i < warmup; ++i) {
+        frame.copyTo(scratch);
+        process_frame_in_place(scratch, &overlay);
+    }
+    
+    // Контуры кадра передаются так же, как у исполнителя с обратным вызовом
+    // контуров: в пустом наборе задания и буфере, возвращённом стадией вывода
+    FlatContours spare = overlay.contours;
+    
+    AllocStats before = alloc_stats();
+    for (int i = 0; i < frames; ++i) {
+        frame.copyTo(scratch);
+        process_frame_in_place(scratch, &overlay);
+        
+        FlatContours task;
+        task = std::move(spare);
+        task = overlay.contours;
+        task.clear();
+        spare = std::move(task);
+    }
+    AllocStats after = alloc_stats();
+    cv::setNumThreads(threads);
+    
+    if (after.calls != before.calls) {
+        std::cout << "ОШИБКА: " << (double)(after.calls - before.calls) / frames
+                  << " выделений памяти на кадр\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+// Общая рамка всех контуров
+static cv::Rect contours_bounds(const FlatContours &contours) {
+    cv::Rect bounds;
+    for (size_t i = 0; i < contours.size(); ++i) {
+        bounds = i == 0 ? contours.bounding_rect(i) : bounds | contours.bounding_rect(i);
+    }
+    return bounds;
+}
+
+// Доля пикселей краёв reference, у которых в edges есть край не дальше
+// radius пикселей
+static double edge_coverage(const cv::Mat &reference, const cv::Mat &edges, int radius) {
+    cv::Mat near;
+    cv::dilate(edges, near, cv::Mat(), cv::Point(-1, -1), radius);
+    int total = cv::countNonZero(reference);
+    cv::Mat covered;
+    cv::bitwise_and(reference, near, covered);
+    return total > 0 ? (double)cv::countNonZero(covered) / total : 1.0;
+}
+
+bool test_detect_edges_vs_canny() {
+    std::cout << "Тест слитого детектора краёв против GaussianBlur и Canny... ";
+    
+    // Перепады яркости не меньше 80 уровней: белый квадрат, жёлтый круг и
+    // наклонная полоса на сером фоне
+    cv::Mat frame(360, 480, CV_8UC3, cv::Scalar(60, 60, 60));
+    cv::rectangle(frame, cv::Rect(40, 40, 160, 120), cv::Scalar(255, 255, 255), -1);
+    cv::circle(frame, cv::Point(330, 130), 70, cv::Scalar(50, 200, 220), -1);
+    cv::line(frame, cv::Point(60, 320), cv::Point(420, 230), cv::Scalar(230, 230, 230), 12);
+    
+    // Размытие совпадает с GaussianBlur(5x5, 1.5) с точностью до 1 уровня
+    cv::Mat blurred, edges, reference;
+    detect_edges(frame, blurred, edges);
+    cv::GaussianBlur(frame, reference, cv::Size(5, 5), 1.5);
+    if (cv::norm(blurred, reference, cv::NORM_INF) > 1) {
+        std::cout << "ОШИБКА: Размытие отличается от GaussianBlur больше чем на 1 уровень\n";
+        return false;
+    }
+    
+    // Цветной вход: не менее 90% краёв Canny имеют край не дальше 1 пикселя
+    cv::Mat canny;
+    cv::Canny(reference, canny, 100, 200);
+    if (edge_coverage(canny, edges, 1) < 0.9) {
+        std::cout << "ОШИБКА: Края цветного кадра расходятся с Canny\n";
+        return false;
+    }
+    
+    // Одноканальный вход: карта совпадает с Canny(blurred) с точностью до
+    // пикселей на пороге
+    cv::Mat gray, gray_blurred, gray_edges, gray_canny, diff;
+    cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+    detect_edges(gray, gray_blurred, gray_edges);
+    cv::Canny(gray_blurred, gray_canny, 100, 200);
+    cv::absdiff(gray_edges, gray_canny, diff);
+    int canny_pixels = cv::countNonZero(gray_canny);
+    if (canny_pixels == 0 || cv::countNonZero(diff) > canny_pixels / 50 ||
+        edge_coverage(gray_canny, gray_edges, 1) < 0.99 || edge_coverage(gray_edges, gray_canny, 1) < 0.99) {
+        std::cout << "ОШИБКА: Края одноканального кадра расходятся с Canny: " << cv::countNonZero(diff)
+                  << " из " << canny_pixels << " пикселей\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+// Рамки контуров двух наборов совпадают попарно с точностью tolerance
+// пикселей; порядок контуров не важен
+static bool same_contours(const FlatContours &a, const FlatContours &b, int tolerance) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    std::vector<cv::Rect> left, right;
+    for (size_t i = 0; i < a.size(); ++i) {
+        left.push_back(a.bounding_rect(i));
+        right.push_back(b.bounding_rect(i));
+    }
+    auto by_corner = [](const cv::Rect &x, const cv::Rect &y) {
+        return x.y != y.y ? x.y < y.y : x.x < y.x;
+    };
+    std::sort(left.begin(), left.end(), by_corner);
+    std::sort(right.begin(), right.end(), by_corner);
+    for (size_t i = 0; i < left.size(); ++i) {
+        if (std::abs(left[i].x - right[i].x) > tolerance || std::abs(left[i].y - right[i].y) > tolerance ||
+            std::abs(left[i].br().x - right[i].br().x) > tolerance ||
+            std::abs(left[i].br().y - right[i].br().y) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_incremental_processing() {
+    std::cout << "Тест инкрементальной обработки против полной... ";
+    
+    // Неподвижный квадрат и движущийся прямоугольник в малой доле кадра
+    cv::Mat scene(480, 640, CV_8UC3, cv::Scalar(80, 80, 80));
+    cv::rectangle(scene, cv::Rect(60, 60, 200, 150), cv::Scalar(255, 255, 255), -1);
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < 4; ++i) {
+        cv::Mat frame = scene.clone();
+        cv::rectangle(frame, cv::Rect(380 + 24 * i, 300, 60, 40), cv::Scalar(230, 230, 230), -1);
+        frames.push_back(frame);
+        if (i == 0) {
+            frames.push_back(frame.clone());  // повтор: кадр без изменений
+        }
+    }
+    
+    IncrementalState state;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        cv::Mat incremental = frames[i].clone();
+        process_frame_incremental(incremental, state);
+        
+        cv::Mat full = frames[i].clone();
+        ContourOverlay overlay;
+        process_frame_in_place(full, &overlay);
+        if (!same_contours(state.overlay.contours, overlay.contours, 2)) {
+            std::cout << "ОШИБКА: Контуры кадра " << i << " отличаются от полной обработки: "
+                      << state.overlay.contours.size() << " против " << overlay.contours.size() << "\n";
+            return false;
+        }
+    }
+    
+    // Первый кадр целиком, повтор без изменений, движение - частично
+    if (state.frames_full != 1 || state.frames_unchanged != 1 || state.frames_partial != 3) {
+        std::cout << "ОШИБКА: Счётчики: целиком " << state.frames_full << ", без изменений "
+                  << state.frames_unchanged << ", частично " << state.frames_partial << "\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+bool test_reduced_resolution_processing() {
+    std::cout << "Тест обработки в уменьшенном разрешении... ";
+    
+    cv::Mat frame(960, 1280, CV_8UC3, cv::Scalar(100, 100, 100));
+    cv::rectangle(frame, cv::Rect(200, 200, 400, 400), cv::Scalar(255, 255, 255), -1);
+    cv::circle(frame, cv::Point(900, 480), 160, cv::Scalar(200, 0, 0), -1);
+    // Слабая текстура без краёв: по ней видно, размыт ли кадр
+    cv::Rect texture(1000, 700, 200, 200);
+    cv::randu(frame(texture), cv::Scalar::all(90), cv::Scalar::all(110));
+    
+    // Уменьшение совпадает с INTER_AREA и переводом в яркость с точностью до округления
+    cv::Mat small, reference;
+    downsample_luma(frame, small, 1);
+    cv::resize(frame, reference, cv::Size(640, 480), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(reference, reference, cv::COLOR_BGR2GRAY);
+    if (small.size() != reference.size() || cv::norm(small, reference, cv::NORM_INF) > 1) {
+        std::cout << "ОШИБКА: Уменьшенная яркость отличается от INTER_AREA\n";
+        return false;
+    }
+    
+    // Контуры уровней 1 и 2 в координатах полного кадра очерчивают те же фигуры
+    cv::Mat full = frame.clone();
+    ContourOverlay full_overlay;
+    process_frame_in_place(full, &full_overlay);
+    cv::Rect expected = contours_bounds(full_overlay.contours);
+    
+    for (int level = 1; level <= 2; ++level) {
+        cv::Mat scaled = frame.clone();
+        ContourOverlay overlay;
+        process_frame_in_place(scaled, &overlay, level);
+        
+        cv::Rect bounds = contours_bounds(overlay.contours);
+        const int tolerance = 2 << level;
+        if (overlay.level != level || overlay.contours.size() != full_overlay.contours.size() ||
+            std::abs(bounds.x - expected.x) > tolerance || std::abs(bounds.y - expected.y) > tolerance ||
+            std::abs(bounds.br().x - expected.br().x) > tolerance ||
+            std::abs(bounds.br().y - expected.br().y) > tolerance) {
+            std::cout << "ОШИБКА: Контуры уровня " << level << " не совпадают с полным разрешением\n";
+            return false;
+        }
+        
+        // Вдали от контуров кадр не размывается, а с blur размыт так же, как на уровне 0
+        if (cv::norm(scaled(texture), frame(texture), cv::NORM_INF) != 0) {
+            std::cout << "ОШИБКА: Кадр уровня " << level << " размыт без blur\n";
+            return false;
+        }
+        cv::Mat blurred = frame.clone();
+        process_frame_in_place(blurred, nullptr, level, EdgeParams(), true);
+        if (cv::norm(blurred(texture), full(texture), cv::NORM_INF) > 1) {
+            std::cout << "ОШИБКА: Кадр уровня " << level << " с blur размыт иначе, чем на уровне 0\n";
+            return false;
+        }
+    }
+    
+    // Уровень 2 обрабатывает кадр быстрее уровня 0: сравниваются медианы
+    // по нескольким кадрам, первый кадр каждого уровня прогревает контекст
+    const int runs = 9;
+    uint64_t median[3] = {0, 0, 0};
+    for (int level = 0; level <= 2; level += 2) {
+        std::vector<uint64_t> times;
+        for (int i = 0; i <= runs; ++i) {
+            cv::Mat scratch = frame.clone();
+            uint64_t start = trace_now_ns();
+            process_frame_in_place(scratch, nullptr, level);
+            if (i > 0) times.push_back(trace_now_ns() - start);
+        }
+        std::nth_element(times.begin(), times.begin() + runs / 2, times.end());
+        median[level] = times[runs / 2];
+    }
+    if (median[2] >= median[0]) {
+        std::cout << "ОШИБКА: Уровень 2 не быстрее уровня 0: " << median[2] / 1000 << " мкс против "
+                  << median[0] / 1000 << " мкс\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+bool test_stage_graph() {
+    std::cout << "Тест графа стадий обработки... ";
+    
+    cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(100, 100, 100));
+    cv::rectangle(frame, cv::Rect(100, 100, 200, 200), cv::Scalar(255, 255, 255), -1);
+    cv::circle(frame, cv::Point(480, 240), 80, cv::Scalar(200, 0, 0), -1);
+    
+    // Списки, которые не складываются в граф
+    StageGraph graph;
+    std::string error;
+    if (graph.compile("contours,draw", error) || graph.compile("blur,edges,threshold", error) ||
+        graph.compile("edges,contours,draw,draw", error) || graph.compile("threshold:300", error) ||
+        graph.compile("blur,sharpen", error)) {
+        std::cout << "ОШИБКА: Принят неверный список стадий\n";
+        return false;
+    }
+    
+    // Стандартный список - тот же результат, что и process_frame_in_place
+    if (!graph.compile(standard_stages(), error) || !graph.standard() ||
+        graph.plan() != "blur+edges > contours > draw+stamp") {
+        std::cout << "ОШИБКА: Стандартный граф собран неверно: " << graph.plan() << "\n";
+        return false;
+    }
+    cv::Mat expected = frame.clone();
+    process_frame_in_place(expected, nullptr);
+    cv::Mat result = frame.clone();
+    graph.run(result, nullptr);
+    if (cv::norm(result, expected, cv::NORM_INF) != 0) {
+        std::cout << "ОШИБКА: Стандартный граф отличается от process_frame_in_place\n";
+        return false;
+    }
+    
+    // Порог яркости: синий круг темнее порога, остаётся только квадрат;
+    // кадр не размывается и без подписи не меняется вне контура
+    if (!graph.compile("threshold:150,contours,draw", error) || graph.standard() ||
+        graph.plan() != "threshold > contours > draw") {
+        std::cout << "ОШИБКА: Не собран граф с порогом: " << error << "\n";
+        return false;
+    }
+    result = frame.clone();
+    ContourOverlay overlay;
+    graph.run(result, &overlay);
+    cv::Rect bounds = contours_bounds(overlay.contours);
+    if (overlay.contours.size() != 1 || std::abs(bounds.x - 100) > 1 || std::abs(bounds.y - 100) > 1 ||
+        std::abs(bounds.width - 200) > 2 || std::abs(bounds.height - 200) > 2) {
+        std::cout << "ОШИБКА: Граф с порогом нашёл " << overlay.contours.size() << " контуров\n";
+        return false;
+    }
+    cv::Rect inside(150, 150, 100, 100);
+    cv::Rect outside(0, 0, 80, 80);
+    if (cv::norm(result(inside), frame(inside), cv::NORM_INF) != 0 ||
+        cv::norm(result(outside), frame(outside), cv::NORM_INF) != 0) {
+        std::cout << "ОШИБКА: Граф с порогом изменил кадр вне наложения\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+// Контур count точек от start с шагом step
+static void add_line_contour(FlatContours &contours, cv::Point start, cv::Point step, int count) {
+    for (int i = 0; i < count; ++i) {
+        contours.add_point(start + step * i);
+    }
+    contours.end_contour();
+}
+
+static bool same_points(const FlatContours &a, size_t i, const FlatContours &b, size_t j, int length) {
+    return a.length(i) >= length && b.length(j) >= length &&
+           std::equal(a.contour(i), a.contour(i) + length, b.contour(j));
+}
+
+bool test_contour_packets() {
+    std::cout << "Тест датаграмм контуров... ";
+    
+    const cv::Size size(1920, 1080);
+    ContourPacketParams params;
+    params.max_datagram = 1400;
+    ContourPacketWriter writer(params);
+    ContourPacket packet;
+    
+    // Кадр без контуров и без метки времени: одна датаграмма из заголовка
+    FlatContours empty;
+    writer.encode(empty, 7, kContourPacketNoPts, size);
+    if (writer.datagrams() != 1 || !decode_contour_packet(writer.datagram(0), writer.datagram_size(0), packet) ||
+        packet.sequence != 7 || packet.pts != kContourPacketNoPts || !packet.last || packet.index != 0 ||
+        packet.frame_size != size || !packet.contours.empty()) {
+        std::cout << "ОШИБКА: Пустой кадр без PTS разобран неверно\n";
+        return false;
+    }
+    // Отсутствие метки передаётся нулём, метка 0 - единицей
+    uint8_t no_pts = writer.datagram(0)[5];  // байт PTS + 1 после номера кадра
+    writer.encode(empty, 7, 0, size);
+    if (no_pts != 0 || writer.datagram(0)[5] != 1 ||
+        !decode_contour_packet(writer.datagram(0), writer.datagram_size(0), packet) || packet.pts != 0) {
+        std::cout << "ОШИБКА: PTS 0 и отсутствие PTS не различаются\n";
+        return false;
+    }
+    
+    // Первая точка - разность с первой точкой предыдущего контура: соседний
+    // контур стоит 3 байта (число точек и две короткие разности)
+    FlatContours one, two;
+    add_line_contour(one, cv::Point(10000, 10000), cv::Point(0, 0), 1);
+    add_line_contour(two, cv::Point(10000, 10000), cv::Point(0, 0), 1);
+    add_line_contour(two, cv::Point(10005, 9998), cv::Point(0, 0), 1);
+    writer.encode(one, 1, 0, size);
+    size_t one_size = writer.datagram_size(0);
+    writer.encode(two, 1, 0, size);
+    if (writer.datagram_size(0) != one_size + 3 ||
+        !decode_contour_packet(writer.datagram(0), writer.datagram_size(0), packet) || packet.contours.size() != 2 ||
+        packet.contours.contour(1)[0] != cv::Point(10005, 9998)) {
+        std::cout << "ОШИБКА: Первая точка контура закодирована не относительно предыдущего\n";
+        return false;
+    }
+    
+    // Много контуров: несколько датаграмм, каждая разбирается отдельно, в
+    // сумме - все контуры по порядку
+    FlatContours many;
+    for (int i = 0; i < 400; ++i) {
+        add_line_contour(many, cv::Point((i * 37) % 1900, (i * 53) % 1000), cv::Point(1, 2), 12);
+    }
+    writer.encode(many, 42, 123456789, size);
+    if (writer.datagrams() < 2) {
+        std::cout << "ОШИБКА: Кадр не разделён на датаграммы\n";
+        return false;
+    }
+    size_t next = 0;
+    for (size_t d = 0; d < writer.datagrams(); ++d) {
+        if (writer.datagram_size(d) > params.max_datagram ||
+            !decode_contour_packet(writer.datagram(d), writer.datagram_size(d), packet) || packet.sequence != 42 ||
+            packet.pts != 123456789 || packet.index != d || packet.last != (d + 1 == writer.datagrams()) ||
+            packet.contours.empty()) {
+            std::cout << "ОШИБКА: Датаграмма " << d << " кадра разобрана неверно\n";
+            return false;
+        }
+        for (size_t i = 0; i < packet.contours.size(); ++i, ++next) {
+            if (next >= many.size() || packet.contours.length(i) != many.length(next) ||
+                !same_points(packet.contours, i, many, next, many.length(next))) {
+                std::cout << "ОШИБКА: Контур " << next << " не совпадает после разбора\n";
+                return false;
+            }
+        }
+    }
+    if (next != many.size()) {
+        std::cout << "ОШИБКА: Разобрано " << next << " контуров из " << many.size() << "\n";
+        return false;
+    }
+    
+    // Контур больше предельной датаграммы уходит отдельной датаграммой и
+    // обрезается; соседние контуры не теряются
+    FlatContours huge;
+    add_line_contour(huge, cv::Point(0, 0), cv::Point(1, 1), 10);
+    add_line_contour(huge, cv::Point(5, 5), cv::Point(1, 0), 40000);
+    add_line_contour(huge, cv::Point(7, 7), cv::Point(0, 1), 10);
+    writer.encode(huge, 3, 0, size);
+    FlatContours decoded;
+    for (size_t d = 0; d < writer.datagrams(); ++d) {
+        if (writer.datagram_size(d) > kMaxContourDatagram ||
+            !decode_contour_packet(writer.datagram(d), writer.datagram_size(d), packet)) {
+            std::cout << "ОШИБКА: Датаграмма с длинным контуром не разобрана\n";
+            return false;
+        }
+        for (size_t i = 0; i < packet.contours.size(); ++i) {
+            decoded.append(packet.contours, i);
+        }
+    }
+    if (writer.datagrams() != 3 || decoded.size() != 3 || decoded.length(1) >= 40000 ||
+        decoded.length(1) < 30000 || !same_points(decoded, 1, huge, 1, decoded.length(1)) ||
+        !same_points(decoded, 0, huge, 0, 10) || !same_points(decoded, 2, huge, 2, 10)) {
+        std::cout << "ОШИБКА: Длинный контур передан неверно\n";
+        return false;
+    }
+    
+    // Повреждённые датаграммы отвергаются
+    writer.encode(two, 1, 0, size);
+    std::vector<uint8_t> datagram(writer.datagram(0), writer.datagram(0) + writer.datagram_size(0));
+    std::vector<uint8_t> bad = datagram;
+    bad[0] = 'X';
+    bool rejected = !decode_contour_packet(bad.data(), bad.size(), packet);
+    bad = datagram;
+    bad[2] = kContourPacketVersion + 1;
+    rejected = rejected && !decode_contour_packet(bad.data(), bad.size(), packet);
+    rejected = rejected && !decode_contour_packet(datagram.data(), 6, packet);  // обрезанный заголовок
+    rejected = rejected && !decode_contour_packet(datagram.data(), datagram.size() - 1, packet);  // обрезанная точка
+    bad.assign(writer.datagram(0), writer.datagram(0) + one_size);
+    bad.push_back(0);  // контур из нуля точек
+    rejected = rejected && !decode_contour_packet(bad.data(), bad.size(), packet);
+    bad.back() = 100;  // точек больше, чем байт до конца датаграммы
+    bad.push_back(2);
+    bad.push_back(2);
+    rejected = rejected && !decode_contour_packet(bad.data(), bad.size(), packet);
+    bad = datagram;
+    bad.back() = 0x80;  // незаконченный varint
+    rejected = rejected && !decode_contour_packet(bad.data(), bad.size(), packet);
+    if (!rejected) {
+        std::cout << "ОШИБКА: Принята повреждённая датаграмма\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+bool test_shm_ring() {
+    std::cout << "Тест кольца кадров в разделяемой памяти... ";
+    
+    const std::string name = shm_ring_name("test." + std::to_string(getpid()));
+    std::string error;
+    ShmRingWriter writer;
+    ShmRingReader reader;
+    if (!writer.create(name, 4, 640 * 480 * 3, error) || !reader.open(name, error)) {
+        std::cout << "ОШИБКА: " << error << "\n";
+        return false;
+    }
+    
+    cv::Mat frame(480, 640, CV_8UC3);
+    ShmFrameInfo info;
+    info.width = 640;
+    info.height = 480;
+    std::strcpy(info.format, "BGR");
+    info.planes = 1;
+    info.strides[0] = (uint32_t)frame.step;
+    info.size = (uint32_t)(frame.total() * frame.elemSize());
+    
+    // Читатель видит кадры по порядку, данные лежат прямо в кольце
+    ShmFrame read;
+    for (int i = 0; i < 3; ++i) {
+        frame.setTo(cv::Scalar(i, i, i));
+        info.pts = i;
+        writer.write(info, frame.data);
+        if (!reader.next(read) || read.info.pts != (uint64_t)i || read.data[1000] != i || !reader.valid(read)) {
+            std::cout << "ОШИБКА: Кадр " << i << " не прочитан\n";
+            return false;
+        }
+    }
+    
+    // Отставший читатель пропускает перезаписанные кадры и считает их потерянными
+    for (int i = 3; i < 10; ++i) {
+        info.pts = i;
+        writer.write(info, frame.data);
+    }
+    if (reader.valid(read) || !reader.next(read) || read.info.pts != 7 || reader.lost() != 4) {
+        std::cout << "ОШИБКА: Неверный пропуск перезаписанных кадров\n";
+        return false;
+    }
+    
+    // Кадр больше слота не пишется; после закрытия читатель знает, что кольцо устарело
+    info.size *= 2;
+    bool oversized = writer.write(info, frame.data);
+    writer.close();
+    if (oversized || !reader.writer_closed()) {
+        std::cout << "ОШИБКА: Неверное закрытие кольца\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
 bool test_gst_opencv_conversion() {
     std::cout << "Тест конвертации GStreamer <-> OpenCV... ";
     
@@ -127,8 +696,64 @@ bool test_gst_opencv_conversion() {
         return false;
     }
     
+    // Ширина, при которой строка BGR не кратна 4 байтам: шаг кадра
+    // передаётся через GstVideoMeta, и кадр читается обратно без сдвига строк
+    cv::Mat odd(30, 161, CV_8UC3);
+    cv::randu(odd, cv::Scalar::all(0), cv::Scalar::all(255));
+    GstCaps *odd_caps = gst_caps_new_simple("video/x-raw",
+                                          "format", G_TYPE_STRING, "BGR",
+                                          "width", G_TYPE_INT, odd.cols,
+                                          "height", G_TYPE_INT, odd.rows,
+                                          NULL);
+    GstSample *odd_sample = mat_to_gst_sample(odd, odd_caps);
+    gst_caps_unref(odd_caps);
+    GstVideoMeta *meta = odd_sample ? gst_buffer_get_video_meta(gst_sample_get_buffer(odd_sample)) : NULL;
+    bool stride_ok = meta && meta->stride[0] == (gint)(odd.cols * odd.elemSize());
+    // Память, обёрнутая из Mat, помечена READONLY: кадр только для чтения
+    bool odd_writable = true;
+    cv::Mat odd_back = odd_sample ? gst_sample_to_mat(odd_sample, &odd_writable) : cv::Mat();
+    bool odd_ok = stride_ok && !odd_writable && odd_back.size() == odd.size() &&
+                  cv::norm(odd, odd_back, cv::NORM_INF) == 0;
+    odd_back.release();
+    if (odd_sample) {
+        gst_sample_unref(odd_sample);
+    }
+    if (!odd_ok) {
+        std::cout << "ОШИБКА: Кадр с невыровненной строкой искажён после конвертации\n";
+        return false;
+    }
+    
+    // Буфер с единственной ссылкой отображается для записи, и запись в кадр
+    // попадает в буфер; пока буфер держит ещё кто-то, кадр только для чтения
+    GstCaps *gray_caps = gst_caps_new_simple("video/x-raw",
+                                           "format", G_TYPE_STRING, "GRAY8",
+                                           "width", G_TYPE_INT, 64,
+                                           "height", G_TYPE_INT, 8,
+                                           NULL);
+    GstBuffer *gray_buffer = gst_buffer_new_allocate(NULL, 64 * 8, NULL);
+    gst_buffer_memset(gray_buffer, 0, 0, 64 * 8);
+    GstSample *gray_sample = gst_sample_new(gray_buffer, gray_caps, NULL, NULL);
+    bool shared_writable = true;
+    cv::Mat shared = gst_sample_to_mat(gray_sample, &shared_writable);
+    shared.release();
+    gst_buffer_unref(gray_buffer);
+    bool gray_writable = false;
+    cv::Mat gray = gst_sample_to_mat(gray_sample, &gray_writable);
+    if (gray_writable) {
+        gray.setTo(cv::Scalar(7));
+    }
+    gray.release();
+    guint8 written = 0;
+    gst_buffer_extract(gst_sample_get_buffer(gray_sample), 0, &written, 1);
+    gst_sample_unref(gray_sample);
+    gst_caps_unref(gray_caps);
+    if (shared_writable || !gray_writable || written != 7) {
+        std::cout << "ОШИБКА: Кадр отображён для записи неверно\n";
+        return false;
+    }
+    
     // Отображаем результат для визуального сравнения
-    if (true) {
+    if (show_windows) {
         cv::imshow("Оригинал", original);
         cv::imshow("После конвертации", converted);
         cv::waitKey(2000);
@@ -139,6 +764,470 @@ bool test_gst_opencv_conversion() {
     return true;
 }
 
+// Прогон заранее поставленных в appsink кадров через FrameExecutor; pts -
+// метки отданных кадров в порядке выдачи
+static bool run_executor(DropPolicy policy, int frames, std::vector<GstClockTime> &pts, ExecutorStats &stats) {
+    GstElement *pipeline = gst_parse_launch(
+        "appsrc name=src format=time ! appsink name=sink sync=false", NULL);
+    if (!pipeline) {
+        return false;
+    }
+    GstElement *appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+    GstElement *appsink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+    GstCaps *caps = gst_caps_new_simple("video/x-raw",
+                                        "format", G_TYPE_STRING, "BGR",
+                                        "width", G_TYPE_INT, 160,
+                                        "height", G_TYPE_INT, 120,
+                                        "framerate", GST_TYPE_FRACTION, 30, 1,
+                                        NULL);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    
+    cv::Mat frame(120, 160, CV_8UC3, cv::Scalar(40, 40, 40));
+    cv::rectangle(frame, cv::Rect(40, 30, 60, 50), cv::Scalar(255, 255, 255), -1);
+    for (int i = 0; i < frames; ++i) {
+        GstSample *sample = mat_to_gst_sample(frame, caps, (GstClockTime)i * GST_MSECOND, GST_MSECOND);
+        gst_app_src_push_sample(GST_APP_SRC(appsrc), sample);
+        gst_sample_unref(sample);
+    }
+    gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
+    
+    // Очередь в один кадр и четыре рабочих: кадры обгоняют друг друга,
+    // а без блокировки очередь переполняется
+    ExecutorConfig config;
+    config.workers = 4;
+    config.queue_capacity = 1;
+    config.drop_policy = policy;
+    config.live = false;
+    FrameExecutor executor(appsink, NULL, config);
+    executor.set_contours_callback([&pts](const FlatContours &, GstClockTime frame_pts, cv::Size) {
+        pts.push_back(frame_pts);
+    });
+    executor.start();
+    for (int i = 0; i < 1000 && !executor.capture_eos(); ++i) {
+        g_usleep(10000);
+    }
+    bool eos = executor.capture_eos();
+    executor.stop();
+    stats = executor.stats();
+    
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_caps_unref(caps);
+    gst_object_unref(appsrc);
+    gst_object_unref(appsink);
+    gst_object_unref(pipeline);
+    return eos;
+}
+
+// Синтетический кадр H.264 для кольца записи: 10 кадров в секунду,
+// ключевой - каждый десятый (группа в секунду)
+static void push_encoded(EventRecorder &recorder, int frame, size_t size) {
+    GstBuffer *buffer = gst_buffer_new_allocate(NULL, size, NULL);
+    GST_BUFFER_PTS(buffer) = (GstClockTime)frame * 100 * GST_MSECOND;
+    GST_BUFFER_DTS(buffer) = GST_BUFFER_PTS(buffer);
+    if (frame % 10 != 0) {
+        GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    }
+    recorder.push(buffer);
+    gst_buffer_unref(buffer);
+}
+
+// Ждёт, пока поток записи обработает recordings записей (без caps каждая
+// запись завершается ошибкой сразу, не трогая диск)
+static bool wait_recordings(const EventRecorder &recorder, uint64_t recordings) {
+    for (int i = 0; i < 100 && recorder.recordings() + recorder.failed() < recordings; ++i) {
+        g_usleep(10000);
+    }
+    return recorder.recordings() + recorder.failed() >= recordings;
+}
+
+bool test_event_recorder() {
+    std::cout << "Тест кольца и послезаписи записи событий... ";
+    
+    // Вытеснение по preroll: остаются группы, которые покрывают 2 с до
+    // последнего кадра (с 2 с по 4.9 с)
+    RecorderConfig config;
+    config.preroll = 2;
+    config.postroll = 5;
+    config.budget_bytes = 1 << 20;
+    {
+        EventRecorder recorder("test", config);
+        for (int frame = 0; frame < 50; ++frame) {
+            push_encoded(recorder, frame, 1000);
+        }
+        if (recorder.buffered_bytes() != 30000) {
+            std::cout << "ОШИБКА: Кольцо по preroll держит " << recorder.buffered_bytes() << " байт\n";
+            return false;
+        }
+    }
+    
+    // Вытеснение по бюджету - целыми группами: остаётся только текущая
+    config.budget_bytes = 15000;
+    {
+        EventRecorder recorder("test", config);
+        for (int frame = 0; frame < 50; ++frame) {
+            push_encoded(recorder, frame, 1000);
+        }
+        if (recorder.buffered_bytes() != 10000) {
+            std::cout << "ОШИБКА: Кольцо по бюджету держит " << recorder.buffered_bytes() << " байт\n";
+            return false;
+        }
+    }
+    
+    // Группа больше бюджета: кольцо пустеет и ждёт следующего ключевого кадра
+    config.budget_bytes = 5000;
+    {
+        EventRecorder recorder("test", config);
+        bool emptied = true;
+        for (int frame = 0; frame < 10; ++frame) {
+            push_encoded(recorder, frame, 1000);
+            emptied = emptied && (frame < 5 || recorder.buffered_bytes() == 0);
+        }
+        push_encoded(recorder, 10, 1000);
+        if (!emptied || recorder.buffered_bytes() != 1000) {
+            std::cout << "ОШИБКА: Группа сверх бюджета не вытеснена целиком\n";
+            return false;
+        }
+    }
+    
+    // Повторное событие через 3 с продлевает послезапись до 3 + 5 с после первого
+    config.budget_bytes = 1 << 20;
+    {
+        EventRecorder recorder("test", config);
+        recorder.start();
+        for (int frame = 0; frame <= 20; ++frame) {
+            push_encoded(recorder, frame, 100);
+        }
+        bool first = recorder.trigger("first");
+        for (int frame = 21; frame <= 50; ++frame) {
+            push_encoded(recorder, frame, 100);
+        }
+        bool second = recorder.trigger("second");
+        // Без продления запись закончилась бы на кадре 70 (7 с)
+        for (int frame = 51; frame < 100; ++frame) {
+            push_encoded(recorder, frame, 100);
+        }
+        g_usleep(50000);
+        bool open = recorder.recordings() + recorder.failed() == 0;
+        push_encoded(recorder, 100, 100);
+        bool finished = wait_recordings(recorder, 1);
+        recorder.stop();
+        if (!first || !second || !open || !finished || recorder.recordings() + recorder.failed() != 1) {
+            std::cout << "ОШИБКА: Повторное событие не продлило запись одной записью\n";
+            return false;
+        }
+    }
+    
+    // События каждую секунду до 8 с: запись длится до 13 с, но делится на
+    // файлы не длиннее 4 с по ключевым кадрам 4, 8 и 12 с, а с пределом
+    // 2500 байт - по ключевым кадрам 3, 6, 9 и 12 с
+    config.max_pending = 8;
+    for (int cap = 0; cap < 2; ++cap) {
+        config.max_duration = cap == 0 ? 4 : 300;
+        config.max_bytes = cap == 0 ? (size_t)1 << 20 : 2500;
+        EventRecorder recorder("test", config);
+        recorder.start();
+        bool triggered = true;
+        for (int frame = 0; frame <= 130; ++frame) {
+            push_encoded(recorder, frame, 100);
+            if (frame >= 20 && frame <= 80 && frame % 10 == 0) {
+                triggered = recorder.trigger("split") && triggered;
+            }
+        }
+        const uint64_t expected = cap == 0 ? 4 : 5;
+        bool finished = wait_recordings(recorder, expected);
+        recorder.stop();
+        if (!triggered || !finished || recorder.recordings() + recorder.failed() != expected) {
+            std::cout << "ОШИБКА: Запись не поделена по пределу " << (cap == 0 ? "длительности" : "размера")
+                      << ": " << recorder.recordings() + recorder.failed() << " записей\n";
+            return false;
+        }
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+// Неверные пороги и стадии отклоняются с описанием ошибки и не меняют
+// настроек, верные читаются обратно через describe()
+static bool check_tuner(StreamTuner &tuner, const std::string &resolution) {
+    const std::string standard = std::string("edges=100:200 stages=") + standard_stages() + resolution;
+    if (tuner.describe() != standard) {
+        std::cout << "ОШИБКА: Исходные настройки: " << tuner.describe() << "\n";
+        return false;
+    }
+    
+    const int bad_thresholds[][2] = { {-1, 200}, {150, 100}, {0, kMaxEdgeThreshold + 1} };
+    for (const auto &bad : bad_thresholds) {
+        std::string error;
+        if (tuner.set_edge_thresholds(bad[0], bad[1], error) || error.empty()) {
+            std::cout << "ОШИБКА: Приняты пороги " << bad[0] << ":" << bad[1] << "\n";
+            return false;
+        }
+    }
+    const char *const bad_stages[] = { "", "blur,bogus", "threshold:300", "contours,draw", "edges,threshold:10" };
+    for (const char *bad : bad_stages) {
+        std::string error;
+        if (tuner.set_stages(bad, error) || error.empty()) {
+            std::cout << "ОШИБКА: Приняты стадии \"" << bad << "\"\n";
+            return false;
+        }
+    }
+    if (tuner.describe() != standard) {
+        std::cout << "ОШИБКА: Отклонённые настройки изменили поток: " << tuner.describe() << "\n";
+        return false;
+    }
+    
+    std::string error;
+    if (!tuner.set_edge_thresholds(30, kMaxEdgeThreshold, error) || !tuner.set_stages("threshold:40,contours,draw", error) ||
+        tuner.describe() != "edges=30:" + std::to_string(kMaxEdgeThreshold) + " stages=threshold:40,contours,draw" +
+                            resolution) {
+        std::cout << "ОШИБКА: Новые настройки (" << error << "): " << tuner.describe() << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool test_stream_tuner() {
+    std::cout << "Тест изменения настроек потока на ходу... ";
+    
+    // Без обработки менять нечего
+    StreamTuner idle("idle", EncoderSettings(), false);
+    std::string error;
+    if (idle.set_edge_thresholds(100, 200, error) || idle.set_stages(standard_stages(), error) ||
+        !idle.describe().empty()) {
+        std::cout << "ОШИБКА: Поток без обработки принял настройки\n";
+        return false;
+    }
+    
+    // Исполнитель режима --bridge и размер кадров capsfilter
+    ExecutorConfig config;
+    FrameExecutor executor(NULL, NULL, config);
+    GstElement *capsfilter = gst_element_factory_make("capsfilter", NULL);
+    GstCaps *caps = gst_caps_from_string("video/x-raw,format=BGR,width=640,height=480");
+    g_object_set(G_OBJECT(capsfilter), "caps", caps, NULL);
+    gst_caps_unref(caps);
+    gst_object_ref_sink(capsfilter);
+    
+    StreamTuner bridge("bridge", EncoderSettings(), false);
+    bridge.attach_executor(&executor);
+    bridge.attach_capsfilter(capsfilter);
+    bool ok = check_tuner(bridge, " resolution=640x480") && bridge.set_resolution(320, 240, error) &&
+              bridge.describe().find(" resolution=320x240") != std::string::npos;
+    gst_object_unref(capsfilter);
+    if (!ok) {
+        std::cout << "ОШИБКА: Исполнитель: " << bridge.describe() << "\n";
+        return false;
+    }
+    
+    // Свойства cvfilter
+    GstElement *filter = GST_ELEMENT(g_object_new(CV_TYPE_FILTER, NULL));
+    gst_object_ref_sink(filter);
+    StreamTuner filtered("filter", EncoderSettings(), false);
+    filtered.attach_filter(filter);
+    ok = check_tuner(filtered, "");
+    gst_object_unref(filter);
+    if (!ok) {
+        std::cout << "ОШИБКА: cvfilter\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+bool test_worker_scheduler_slots() {
+    std::cout << "Тест переиспользования слотов планировщика... ";
+    
+    SchedulerConfig config;
+    config.workers = 2;
+    WorkerScheduler scheduler(config);
+    scheduler.start();
+    
+    // Подключение и отключение потоков подряд, больше, чем слотов: слоты
+    // освобождаются, а задания доходят до нового владельца слота
+    for (int i = 0; i < 200; ++i) {
+        int id = scheduler.add_stream("file", 1);
+        bool done = false;
+        scheduler.run(id, [&done]() { done = true; });
+        scheduler.remove_stream(id);
+        if (id < 0 || !done) {
+            std::cout << "ОШИБКА: Поток " << i << " не получил слот\n";
+            return false;
+        }
+    }
+    
+    // Все слоты заняты: новый поток не регистрируется, а исполнитель не запускается
+    std::vector<int> ids;
+    for (int id = scheduler.add_stream("stream", 1); id >= 0; id = scheduler.add_stream("stream", 1)) {
+        ids.push_back(id);
+    }
+    ExecutorConfig executor_config;
+    executor_config.name = "overflow";
+    FrameExecutor executor(NULL, NULL, executor_config, &scheduler);
+    bool started = executor.start();
+    
+    // Освобождённый слот достаётся следующему потоку
+    int freed = ids.empty() ? -1 : ids[ids.size() / 2];
+    scheduler.remove_stream(freed);
+    int reused = scheduler.add_stream("stream", 1);
+    scheduler.stop();
+    if (ids.size() < 2 || started || reused != freed) {
+        std::cout << "ОШИБКА: Переполнение планировщика (" << ids.size() << " потоков, слот " << reused << ")\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+bool test_frame_executor_order() {
+    std::cout << "Тест порядка кадров и политик переполнения исполнителя... ";
+    
+    const int frames = 120;
+    const DropPolicy policies[] = { DropPolicy::Block, DropPolicy::DropOldest, DropPolicy::DropNewest };
+    for (DropPolicy policy : policies) {
+        std::vector<GstClockTime> pts;
+        ExecutorStats stats;
+        if (!run_executor(policy, frames, pts, stats)) {
+            std::cout << "ОШИБКА: Исполнитель (" << drop_policy_name(policy) << ") не дошёл до конца потока\n";
+            return false;
+        }
+        
+        // Кадры отданы в порядке захвата, выброшенные - пропущены
+        for (size_t i = 1; i < pts.size(); ++i) {
+            if (pts[i] <= pts[i - 1]) {
+                std::cout << "ОШИБКА: Нарушен порядок кадров (" << drop_policy_name(policy) << ")\n";
+                return false;
+            }
+        }
+        uint64_t dropped = stats.dropped_oldest + stats.dropped_newest;
+        if (stats.captured != (uint64_t)frames || pts.size() != stats.processed ||
+            stats.processed + dropped != stats.captured || stats.failed != 0) {
+            std::cout << "ОШИБКА: Счётчики исполнителя не сходятся (" << drop_policy_name(policy) << ")\n";
+            return false;
+        }
+        if (policy == DropPolicy::Block && (dropped != 0 || pts.size() != (size_t)frames)) {
+            std::cout << "ОШИБКА: Политика block выбросила кадры\n";
+            return false;
+        }
+        if ((policy == DropPolicy::DropOldest && stats.dropped_newest != 0) ||
+            (policy == DropPolicy::DropNewest && stats.dropped_oldest != 0)) {
+            std::cout << "ОШИБКА: Выброшены не те кадры (" << drop_policy_name(policy) << ")\n";
+            return false;
+        }
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
+// frames решений регулятора подряд: сколько кадров обработано и закодировано;
+// false - закодирован кадр без обработки
+static bool count_decisions(AdaptiveController &controller, int frames, int &processed, int &encoded) {
+    processed = encoded = 0;
+    for (int i = 0; i < frames; ++i) {
+        FrameDecision decision = controller.next_frame();
+        processed += decision.process;
+        encoded += decision.encode;
+        if (decision.encode && !decision.process) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_adaptive_controller() {
+    std::cout << "Тест уровней регулятора нагрузки... ";
+    
+    // Без кодера и потока регулятора: шаги update() по синтетическим
+    // счётчикам, нагрузка задаётся заполненностью очереди
+    AdaptiveConfig config;
+    config.bitrate = 1000;
+    config.min_bitrate = 200;
+    config.recover_intervals = 2;
+    AdaptiveController controller("test", config);
+    double fill = 0.9;
+    controller.set_fill_reader([&fill]() { return fill; });
+    
+    const int expected_bitrate[] = { 1000, 700, 500, 500, 300 };
+    const int expected_processed[] = { 12, 12, 6, 6, 4 };
+    const int expected_encoded[] = { 12, 12, 12, 6, 4 };
+    for (int level = 0; level <= 4; ++level) {
+        int processed = 0, encoded = 0;
+        if (controller.level() != level || controller.bitrate() != expected_bitrate[level] ||
+            !count_decisions(controller, 12, processed, encoded) || processed != expected_processed[level] ||
+            encoded != expected_encoded[level]) {
+            std::cout << "ОШИБКА: Уровень " << level << ": битрейт " << controller.bitrate() << ", обработано "
+                      << processed << ", закодировано " << encoded << " из 12\n";
+            return false;
+        }
+        
+        // Перегрузка: шаг вверх, затем период ожидания без изменений
+        controller.update(0.5);
+        if (controller.level() != std::min(level + 1, 4)) {
+            std::cout << "ОШИБКА: Перегрузка не подняла уровень " << level << "\n";
+            return false;
+        }
+        controller.update(0.5);
+        if (controller.level() != std::min(level + 1, 4)) {
+            std::cout << "ОШИБКА: Уровень изменился в период ожидания\n";
+            return false;
+        }
+    }
+    if (controller.transitions() != 4 || controller.skipped() != 6 + 6 + 8) {
+        std::cout << "ОШИБКА: Счётчики регулятора: переходов " << controller.transitions() << ", пропущено "
+                  << controller.skipped() << "\n";
+        return false;
+    }
+    
+    // Время обработки выше бюджета - тоже перегрузка, даже при пустой очереди
+    // (уровень 4 - предел, переход не считается)
+    fill = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (controller.next_frame().process) {
+            controller.record_processing((uint64_t)(config.frame_budget_ms * 4e6));
+        }
+    }
+    controller.update(0.5);
+    if (controller.level() != 4 || controller.transitions() != 4) {
+        std::cout << "ОШИБКА: Перегрузка на верхнем уровне изменила его\n";
+        return false;
+    }
+    
+    // Промежуточная заполненность сбрасывает счёт спокойных периодов;
+    // шаг вниз - после recover_intervals спокойных периодов подряд
+    controller.update(0.5);
+    fill = 0.3;
+    controller.update(0.5);
+    fill = 0;
+    controller.update(0.5);
+    if (controller.level() != 4) {
+        std::cout << "ОШИБКА: Уровень понижен без спокойных периодов подряд\n";
+        return false;
+    }
+    controller.update(0.5);
+    if (controller.level() != 3 || controller.bitrate() != 500) {
+        std::cout << "ОШИБКА: Спокойные периоды не понизили уровень\n";
+        return false;
+    }
+    for (int level = 2; level >= 0; --level) {
+        controller.update(0.5);  // период ожидания
+        controller.update(0.5);
+        controller.update(0.5);
+        if (controller.level() != level) {
+            std::cout << "ОШИБКА: Уровень " << controller.level() << " вместо " << level << "\n";
+            return false;
+        }
+    }
+    if (controller.bitrate() != 1000 || controller.transitions() != 8) {
+        std::cout << "ОШИБКА: Регулятор не вернулся к норме\n";
+        return false;
+    }
+    
+    std::cout << "ПРОЙДЕН\n";
+    return true;
+}
+
 bool test_udp_streaming() {
     std::cout << "Тест UDP потока... ";
     
@@ -173,15 +1262,33 @@ bool test_udp_streaming() {
 }
 
 int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--show") {
+            show_windows = true;
+        }
+    }
+
     std::cout << "=== Запуск тестов для системы обработки видео ===\n";
     
     int passed = 0;
-    int total = 5;
+    int total = 17;
     
     if (test_gstreamer_initialization()) passed++;
     if (test_camera_connection()) passed++;
     if (test_opencv_processing()) passed++;
+    if (test_allocation_free_processing()) passed++;
+    if (test_detect_edges_vs_canny()) passed++;
+    if (test_incremental_processing()) passed++;
+    if (test_reduced_resolution_processing()) passed++;
+    if (test_stage_graph()) passed++;
+    if (test_shm_ring()) passed++;
+    if (test_contour_packets()) passed++;
     if (test_gst_opencv_conversion()) passed++;
+    if (test_stream_tuner()) passed++;
+    if (test_event_recorder()) passed++;
+    if (test_worker_scheduler_slots()) passed++;
+    if (test_frame_executor_order()) passed++;
+    if (test_adaptive_controller()) passed++;
     if (test_udp_streaming()) passed++;
     
     std::cout << "\n=== Результаты тестов ===\n";